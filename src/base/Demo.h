@@ -102,6 +102,12 @@ public:
      */
     virtual void resizeViewport(int width, int height);
 
+    /**
+     * 是否正在播放动画
+     * 按需渲染模式下返回 true 时，窗口会在每帧结束后继续调度下一帧
+     */
+    virtual bool isAnimating() const { return false; }
+
     // ============================================
     // 访问器
     // ============================================
@@ -133,6 +139,8 @@ signals:
     // 状态变化信号
     void statusMessage(const QString &message);
     void parameterChanged();
+    // 请求重绘一帧（动画开始、异步加载完成、数据变化等）
+    void frameRequested();
 
 protected:
     // ============================================
@@ -41,6 +41,9 @@ CADDemo::CADDemo(QObject *parent)
         mode.followOrientation = true; // 法向量垂直于视线
         workPlane_->setFollowMode(mode);
     }
+
+    // 文档变化时请求重绘（按需渲染模式下不会有持续的帧循环）
+    connect(this, &CADDemo::documentChanged, this, &Demo::frameRequested);
 }
 
 CADDemo::~CADDemo()
@@ -59,6 +62,8 @@ void CADDemo::initialize()
         emit statusMessage("Failed to initialize renderer");
         return;
     }
+    // 大文档的全量上传交给后台线程；共享上下文不可用时保持同步上传
+    renderer_->setBackgroundUpload(true);
 
     addTestEntities();
     emit statusMessage("CAD Demo initialized");
@@ -83,16 +88,30 @@ void CADDemo::render()
         documentDirty_ = false;
     }
 
-    // 绘制网格
-    if (showGrid_)
+    // 上一次拾取的结果（GPU 已完成时才会返回）
+    PickResult pick;
+    if (renderer_->pollPick(pick))
+    {
+        applyPickResult(pick);
+    }
+
+    // 网格与文档实体画进缓存的文档层：视图与文档都没变时（光标移动、橡皮筋、悬停 / 选择）
+    // 只需一次全屏 blit
+    if (renderer_->beginStaticLayer(viewportState_, showGrid_ ? 1u : 0u))
     {
-        // 深色主题配色
-        std::uint32_t minorColor = 0x40404040; // RGBA: (64, 64, 64, 64) - 深灰色，25%透明
-        std::uint32_t majorColor = 0x80808080; // RGBA: (128, 128, 128, 128) - 灰色，50%透明
-        gridRenderer_->draw(*renderer_, viewportState_, minorColor, majorColor, 5);
+        if (showGrid_)
+        {
+            // 深色主题配色
+            std::uint32_t minorColor = 0x40404040; // RGBA: (64, 64, 64, 64) - 深灰色，25%透明
+            std::uint32_t majorColor = 0x80808080; // RGBA: (128, 128, 128, 128) - 灰色，50%透明
+            gridRenderer_->draw(*renderer_, viewportState_, minorColor, majorColor, 5);
+        }
+        renderer_->drawStatic(viewportState_);
+        renderer_->endStaticLayer();
     }
+    renderer_->compositeStaticLayer();
 
-    // 绘制坐标轴
+    // 叠加层：坐标轴、选中 / 高亮的实体、绘图预览
     if (showAxis_)
     {
         bool drawZ = !camera->is2D();
@@ -101,9 +120,14 @@ void CADDemo::render()
                             0x0000FFFF,                                     // Z - 蓝色
                             drawZ);
     }
+    renderer_->drawOverlay(viewportState_);
 
-    // 绘制文档实体
-    renderer_->draw(viewportState_);
+    // 拾取通道复用本帧已同步的缓冲，结果在后续帧读回
+    if (pickRequested_)
+    {
+        renderer_->requestPick(viewportState_, pickPoint_.x(), pickPoint_.y());
+        pickRequested_ = false;
+    }
 }
 
 void CADDemo::cleanup()
@@ -143,79 +167,48 @@ void CADDemo::processMousePress(QPoint point, glm::vec3 wpoint)
     switch (cad_mode_)
     {
     case DrawMode::SELECT:
+        pickPoint_ = point;
+        pickRequested_ = true;
+        emit frameRequested();
         break;
 
+    // 绘图工具：拖拽期间的几何只进渲染器的预览层，松开鼠标时才写入文档
     case DrawMode::LINE:
-    {
-        qDebug() << "=== LINE Mode - Mouse Press ===";
-        qDebug() << "World position:" << point.x() << point.y();
-        qDebug() << "Start point:" << wpoint.x << wpoint.y << wpoint.z;
-
-        cur_draw_ = document_->addLine(wpoint, wpoint,
-                                       Style::fromRGBA(0, 255, 0, 255));
-        qDebug() << "Created entity ID:" << cur_draw_;
-        // 验证实体是否成功创建
-        const Entity *entity = document_->get(cur_draw_);
-        if (entity)
-        {
-            qDebug() << "Entity created successfully!";
-            // qDebug() << "  Type:" << (int)entity->type;
-            qDebug() << "  Visible:" << entity->visible;
-
-            if (auto *line = std::get_if<Line>(&entity->geom))
-            {
-                qDebug() << "  Line p0:" << line->p0.x << line->p0.y << line->p0.z;
-                qDebug() << "  Line p1:" << line->p1.x << line->p1.y << line->p1.z;
-            }
-        }
-        else
-        {
-            qDebug() << "❌ Entity creation failed!";
-        }
-
-        emit documentChanged();
-        qDebug() << "=== End LINE Mode ===\n";
+        toolStart_ = toolCurrent_ = wpoint;
+        toolActive_ = true;
+        renderer_->setPreviewLine(toolStart_, toolCurrent_, kPreviewColor);
+        emit frameRequested();
         break;
-    }
 
     case DrawMode::CIRCLE:
-        emit statusMessage("Circle tool selected - Click to set center");
-        qDebug() << "Switched to: Circle";
+        toolStart_ = toolCurrent_ = wpoint;
+        toolActive_ = true;
+        emit statusMessage("Drag to set radius");
         break;
 
     case DrawMode::RECT:
-        emit statusMessage("Rectangle tool selected - Click to set first corner");
-        qDebug() << "Switched to: Rectangle";
+        toolStart_ = toolCurrent_ = wpoint;
+        toolActive_ = true;
+        emit statusMessage("Drag to set opposite corner");
         break;
+
     case DrawMode::BOX:
     {
-
         if (camera->is2D())
         {
             break;
         }
 
-        Style boxStyle = Style::fromRGBA(100, 149, 237, 255);
-        // ✅ 生成射线：只传递矩阵，不依赖 Camera 类
-        Ray ray = Ray::fromScreen(
-            point.x(), point.y(),
-            viewportWidth, viewportHeight,
-            camera->getViewMatrix(),
-            camera->getProjectionMatrix(
-                static_cast<float>(viewportWidth) / viewportHeight));
         glm::vec3 centerPos;
-        // ✅ 与工作平面求交：只传递平面参数，不依赖 WorkPlane 类
-        if (!ray.intersectPlane(
-                workPlane_->getOrigin(),
-                workPlane_->getNormal(),
-                centerPos))
+        if (!projectToWorkPlane(point, centerPos))
         {
             emit statusMessage("Cannot project to work plane");
             break;
         }
-        EntityId boxId = document_->addBox(centerPos, 1.0f, boxStyle);
-        qDebug() << "box point: " << centerPos.x << " " << centerPos.y << " " << centerPos.z;
-        emit documentChanged();
+        toolStart_ = toolCurrent_ = centerPos;
+        toolActive_ = true;
+        renderer_->setPreviewBox(Box{centerPos, kDefaultBoxSize}, kPreviewColor);
+        emit frameRequested();
     }
     break;
     }
@@ -247,30 +240,97 @@ void CADDemo::processMouseMove(QPoint point, QPoint delta_point, glm::vec3 wpoin
         break;
 
     case DrawMode::LINE:
-        if (camera->is2D())
+        if (toolActive_ && camera->is2D())
         {
-            document_->updateEndLinePoint(cur_draw_, wpoint);
-            // qDebug() << "linepos :" << delta_wpoint.x << " " << delta_wpoint.y << " " << delta_wpoint.z;
-
-            emit documentChanged();
+            toolCurrent_ = wpoint;
+            renderer_->setPreviewLine(toolStart_, toolCurrent_, kPreviewColor);
+            emit frameRequested();
         }
         break;
 
     case DrawMode::CIRCLE:
-        emit statusMessage("Circle tool selected - Click to set center");
-        qDebug() << "Switched to: Circle";
+        if (toolActive_)
+        {
+            toolCurrent_ = wpoint;
+            Circle c{toolStart_, glm::length(toolCurrent_ - toolStart_)};
+            renderer_->setPreviewCircle(c, kPreviewColor, viewportState_);
+            emit frameRequested();
+        }
         break;
 
     case DrawMode::RECT:
-        emit statusMessage("Rectangle tool selected - Click to set first corner");
-        qDebug() << "Switched to: Rectangle";
+        if (toolActive_)
+        {
+            toolCurrent_ = wpoint;
+            std::vector<glm::vec3> corners = rectCorners(toolStart_, toolCurrent_);
+            renderer_->setPreviewPolyline(corners.data(), corners.size(), true, kPreviewColor);
+            emit frameRequested();
+        }
         break;
+
+    case DrawMode::BOX:
+    {
+        glm::vec3 p;
+        if (toolActive_ && projectToWorkPlane(point, p))
+        {
+            toolCurrent_ = p;
+            renderer_->setPreviewBox(Box{toolStart_, boxSize()}, kPreviewColor);
+            emit frameRequested();
+        }
+    }
+    break;
     }
 }
 
 void CADDemo::processMouseRelease()
 {
     isPanning_ = false;
+    if (!toolActive_)
+    {
+        return;
+    }
+    toolActive_ = false;
+    renderer_->clearPreview();
+
+    // 提交到文档：一次插入，渲染器按变更日志增量上传
+    EntityId id = 0;
+    switch (cad_mode_)
+    {
+    case DrawMode::LINE:
+        if (toolCurrent_ != toolStart_)
+            id = document_->addLine(toolStart_, toolCurrent_, Style::fromRGBA(0, 255, 0, 255));
+        break;
+
+    case DrawMode::CIRCLE:
+    {
+        float r = glm::length(toolCurrent_ - toolStart_);
+        if (r > 0.0f)
+            id = document_->addCircle(toolStart_, r, Style::fromRGBA(0, 0, 255, 255));
+    }
+    break;
+
+    case DrawMode::RECT:
+        if (toolCurrent_.x != toolStart_.x && toolCurrent_.y != toolStart_.y)
+            id = document_->addPolyline(rectCorners(toolStart_, toolCurrent_), true, Style::fromRGBA(255, 0, 0, 255));
+        break;
+
+    case DrawMode::BOX:
+        id = document_->addBox(toolStart_, boxSize(), Style::fromRGBA(100, 149, 237, 255));
+        break;
+
+    default:
+        break;
+    }
+
+    if (id)
+    {
+        cur_draw_ = id;
+        emit documentChanged();
+    }
+    else
+    {
+        emit frameRequested();
+    }
 }
 
 void CADDemo::processMouseWheel(int offset)
@@ -438,6 +498,19 @@ void CADDemo::onDrawModeChanged(int id)
         emit statusMessage("Rectangle tool selected - Click to set first corner");
         qDebug() << "Switched to: Rectangle";
         break;
+
+    case DrawMode::BOX:
+        emit statusMessage("Box tool selected - Click on the work plane to set center");
+        qDebug() << "Switched to: Box";
+        break;
+    }
+
+    // 切换工具时丢弃未完成的预览
+    if (toolActive_)
+    {
+        toolActive_ = false;
+        renderer_->clearPreview();
+        emit frameRequested();
     }
 }
 
@@ -467,6 +540,54 @@ void CADDemo::syncRendererFromDocument()
     document_->clearAllDirtyFlags();
 }
 
+bool CADDemo::projectToWorkPlane(QPoint point, glm::vec3 &out) const
+{
+    // ✅ 生成射线：只传递矩阵，不依赖 Camera 类
+    Ray ray = Ray::fromScreen(
+        point.x(), point.y(),
+        viewportWidth, viewportHeight,
+        camera->getViewMatrix(),
+        camera->getProjectionMatrix(
+            static_cast<float>(viewportWidth) / viewportHeight));
+    // ✅ 与工作平面求交：只传递平面参数，不依赖 WorkPlane 类
+    return ray.intersectPlane(workPlane_->getOrigin(), workPlane_->getNormal(), out);
+}
+
+std::vector<glm::vec3> CADDemo::rectCorners(const glm::vec3 &a, const glm::vec3 &b)
+{
+    // XY 平面内的轴对齐矩形，z 取起点
+    return {a, glm::vec3(b.x, a.y, a.z), glm::vec3(b.x, b.y, a.z), glm::vec3(a.x, b.y, a.z)};
+}
+
+float CADDemo::boxSize() const
+{
+    // 拖拽距离为半边长；原地点击时使用默认尺寸
+    float d = glm::length(toolCurrent_ - toolStart_);
+    return d > 0.0f ? 2.0f * d : kDefaultBoxSize;
+}
+
+void CADDemo::applyPickResult(const PickResult &result)
+{
+    // 读回期间实体可能已被删除
+    EntityId id = (result.hit && document_->contains(result.id)) ? result.id : 0;
+    if (id == selected_)
+        return;
+
+    // 选中高亮只改渲染器属性表中的一位
+    if (selected_)
+        renderer_->setSelected(selected_, false);
+    selected_ = id;
+    if (id)
+        renderer_->setSelected(id, true);
+    emit frameRequested();
+
+    if (id)
+        emit statusMessage(QString("Selected entity %1").arg(entityIndex(id)));
+    else
+        emit statusMessage("Selection cleared");
+    emit selectionChanged();
+}
+
 // ============================================
 // 控制面板
 // ============================================
@@ -523,10 +644,16 @@ QWidget *CADDemo::createCADControls(QWidget *parent)
     drawModeGroup->addButton(drawSelect, (int)DrawMode::SELECT);
     QRadioButton *drawLine = new QRadioButton("Line");
     drawModeGroup->addButton(drawLine, (int)DrawMode::LINE);
+    QRadioButton *drawCircle = new QRadioButton("Circle");
+    drawModeGroup->addButton(drawCircle, (int)DrawMode::CIRCLE);
+    QRadioButton *drawRect = new QRadioButton("Rect");
+    drawModeGroup->addButton(drawRect, (int)DrawMode::RECT);
     QRadioButton *drawBox = new QRadioButton("Box");
     drawModeGroup->addButton(drawBox, (int)DrawMode::BOX);
     drawLayout->addWidget(drawSelect);
     drawLayout->addWidget(drawLine);
+    drawLayout->addWidget(drawCircle);
+    drawLayout->addWidget(drawRect);
     drawLayout->addWidget(drawBox);
     layout->addWidget(drawGroup);
     connect(drawModeGroup, QOverload<int>::of(&QButtonGroup::idClicked), this, &CADDemo::onDrawModeChanged);
@@ -577,7 +704,7 @@ QWidget *CADDemo::createCADControls(QWidget *parent)
         if (!statsPtr)
             return;
 
-        int entityCount = document_->all().size();
+        int entityCount = int(document_->size());
         QString mode = camera->is2D() ? "2D" : "3D";
         statsPtr->setText(QString("Mode: %1\nEntities: %2\nWorld/Pixel: %3")
                               .arg(mode)
@@ -45,6 +45,13 @@ public:
     void processMouseWheel(int offset) override;
     void resizeViewport(int width, int height) override;
 
+    // 拾取结果异步读回期间、缩放后的重新细分分帧进行期间、后台上传期间需要继续出帧
+    bool isAnimating() const override
+    {
+        return pickRequested_ || (renderer_ && (renderer_->pickPending() || renderer_->retessellatePending() ||
+                                             renderer_->uploadPending()));
+    }
+
     // ============================================
     // 文档访问
     // ============================================
@@ -55,6 +62,9 @@ public:
     Renderer* getRenderer() { return renderer_.get(); }
     const Renderer* getRenderer() const { return renderer_.get(); }
 
+    // 当前选中的实体（0 表示无）
+    EntityId selectedEntity() const { return selected_; }
+
     // ============================================
     // 控制面板
     // ============================================
@@ -101,6 +111,12 @@ private:
     // ============================================
     
     void syncRendererFromDocument();
+    void applyPickResult(const PickResult& result);
+
+    // 绘图工具
+    bool projectToWorkPlane(QPoint point, glm::vec3& out) const;
+    static std::vector<glm::vec3> rectCorners(const glm::vec3& a, const glm::vec3& b);
+    float boxSize() const;
     
     QWidget* createCADControls(QWidget *parent = nullptr);
     QWidget* createDocumentControls(QWidget *parent = nullptr);
@@ -137,6 +153,18 @@ private:
     // 鼠标交互
     bool isPanning_;
 
+    // 绘图工具：按下点与当前点，拖拽期间只更新渲染器预览层
+    static constexpr std::uint32_t kPreviewColor = 0xFFFF00FF;  // 黄色
+    static constexpr float kDefaultBoxSize = 1.0f;
+    bool toolActive_ = false;
+    glm::vec3 toolStart_{0.0f};
+    glm::vec3 toolCurrent_{0.0f};
+
+    // 选择：按下时记录拾取点，在 render 中发起 ID 缓冲拾取
+    bool pickRequested_ = false;
+    QPoint pickPoint_;
+    EntityId selected_ = 0;
+
     std::unique_ptr<WorkPlane> workPlane_;
 };
 
@@ -22,6 +22,7 @@ GLWidget::GLWidget(QWidget *parent)
     , input(std::make_unique<InputManager>())
     , controlPanelDock(nullptr)
     , autoUpdate(true)
+    , renderOnDemand(true)
     , targetFPS(0)
     , frameCount(0)
     , lastFPS(0)
@@ -35,6 +36,12 @@ GLWidget::GLWidget(QWidget *parent)
     connect(fpsTimer, &QTimer::timeout, this, &GLWidget::updateFPS);
     fpsTimer->start(1000);
     
+    // 帧率限制计时器
+    frameLimitTimer = new QTimer(this);
+    frameLimitTimer->setSingleShot(true);
+    frameLimitTimer->setTimerType(Qt::PreciseTimer);
+    connect(frameLimitTimer, &QTimer::timeout, this, [this]() { update(); });
+    
     // 启动帧计时器
     frameTimer.start();
     
@@ -212,7 +219,9 @@ void GLWidget::setDemo(std::unique_ptr<Demo> demo)
         
         // ✅ 只触发重绘
         connect(currentDemo.get(), &Demo::parameterChanged,
-                this, [this]() { update(); });
+                this, &GLWidget::requestFrame);
+        connect(currentDemo.get(), &Demo::frameRequested,
+                this, &GLWidget::requestFrame);
         
         emit statusMessage(QString("Demo loaded: %1").arg(currentDemo->getName()));
     } else {
@@ -228,7 +237,7 @@ void GLWidget::setDemo(std::unique_ptr<Demo> demo)
     // ✅ 只在 demoChanged 信号中重建控制面板（已经在第 415-429 行有处理）
     // 不需要这里再调用 updateControlPanel()
     
-    update();
+    requestFrame();
 }
 
 void GLWidget::clearDemo()
@@ -438,13 +447,69 @@ void GLWidget::setAutoUpdate(bool enabled)
     autoUpdate = enabled;
     
     if (autoUpdate) {
-        update();
+        requestFrame();
     }
 }
 
+void GLWidget::setRenderOnDemand(bool enabled)
+{
+    renderOnDemand = enabled;
+    requestFrame();
+}
+
 void GLWidget::setTargetFPS(int fps)
 {
     targetFPS = fps;
+    
+    // 取消按旧帧率排定的延迟帧
+    if (frameLimitTimer->isActive()) {
+        frameLimitTimer->stop();
+        requestFrame();
+    }
+}
+
+void GLWidget::requestFrame()
+{
+    if (targetFPS <= 0) {
+        update();  // Qt 会把同一事件循环内的多次 update() 合并
+        return;
+    }
+    
+    // 已有排定的帧
+    if (frameLimitTimer->isActive()) {
+        return;
+    }
+    
+    qint64 targetFrameTime = 1000 / targetFPS;
+    qint64 wait = lastUpdateTime + targetFrameTime - frameTimer.elapsed();
+    if (wait <= 0) {
+        update();
+    } else {
+        frameLimitTimer->start(int(wait));
+    }
+}
+
+/**
+ * 当前帧结束后是否还需要下一帧
+ * 持续模式总是需要；按需模式只在相机键按住或 Demo 正在播放动画时需要
+ */
+bool GLWidget::needsNextFrame() const
+{
+    if (!autoUpdate) {
+        return false;
+    }
+    if (!renderOnDemand) {
+        return true;
+    }
+    
+    static const int cameraKeys[] = { Qt::Key_W, Qt::Key_S, Qt::Key_A, Qt::Key_D, Qt::Key_E, Qt::Key_Q };
+    for (int key : cameraKeys) {
+        if (input->isKeyDown(key)) {
+            return true;
+        }
+    }
+    
+    return currentDemo && currentDemo->isAnimating();
 }
 
 // ============================================
@@ -493,19 +558,8 @@ void GLWidget::paintGL()
     input->beginFrame();
     calculateDeltaTime();
     
-    
-    if (targetFPS > 0) {
-        qint64 currentTime = frameTimer.elapsed();
-        qint64 targetFrameTime = 1000 / targetFPS;
-        qint64 elapsedSinceLastUpdate = currentTime - lastUpdateTime;
-        
-        if (elapsedSinceLastUpdate < targetFrameTime) {
-            update();
-            return;
-        }
-        
-        lastUpdateTime = currentTime;
-    }
+    // 帧率限制由 requestFrame() 的定时器完成，这里只记录本帧时刻
+    lastUpdateTime = frameTimer.elapsed();
 
     if (currentDemo) {
         // 键盘输入（保持不变）
@@ -566,8 +620,8 @@ void GLWidget::paintGL()
     
     frameCount++;
     
-    if (autoUpdate) {
-        update();
+    if (needsNextFrame()) {
+        requestFrame();
     }
 }
 
@@ -580,6 +634,7 @@ void GLWidget::keyPressEvent(QKeyEvent *event)
     if (input) {
         input->onKeyPress(event);
     }
+    requestFrame();
     QOpenGLWidget::keyPressEvent(event);
 }
 
@@ -588,6 +643,7 @@ void GLWidget::keyReleaseEvent(QKeyEvent *event)
     if (input) {
         input->onKeyRelease(event);
     }
+    requestFrame();
     QOpenGLWidget::keyReleaseEvent(event);
 }
 
@@ -597,6 +653,7 @@ void GLWidget::mousePressEvent(QMouseEvent *event)
     if(input) {
         input->onMousePress(event);
     }
+    requestFrame();
 
     QOpenGLWidget::mousePressEvent(event);
 }
@@ -606,6 +663,7 @@ void GLWidget::mouseMoveEvent(QMouseEvent *event)
     if(input) {
         input->onMouseMove(event);
     }
+    requestFrame();
     QOpenGLWidget::mouseMoveEvent(event);
 }
 
@@ -614,6 +672,7 @@ void GLWidget::mouseReleaseEvent(QMouseEvent *event)
     if(input) {
         input->onMouseRelease(event);
     }
+    requestFrame();
     QOpenGLWidget::mouseReleaseEvent(event);
 }
 
@@ -622,6 +681,7 @@ void GLWidget::wheelEvent(QWheelEvent *event)
     if(input) {
         input->onWheel(event);
     }
+    requestFrame();
     QOpenGLWidget::wheelEvent(event);
 }
 
@@ -188,6 +188,17 @@ public:
      */
     bool isAutoUpdate() const { return autoUpdate; }
     
+    /**
+     * 按需渲染：开启后只在输入、参数/文档变化、动画或异步请求时才绘制，
+     * 空闲时不占用 CPU/GPU；关闭则恢复为持续重绘
+     */
+    void setRenderOnDemand(bool enabled);
+    
+    /**
+     * 获取按需渲染状态
+     */
+    bool isRenderOnDemand() const { return renderOnDemand; }
+    
     /**
      * 设置目标帧率（0 = 无限制）
      */
@@ -203,6 +214,13 @@ public:
      */
     int getCurrentFPS() const { return lastFPS; }
 
+public slots:
+    /**
+     * 请求绘制一帧
+     * 多次请求合并为一次；设置了目标帧率时延迟到下一帧时刻
+     */
+    void requestFrame();
+
 signals:
     /**
      * FPS 更新信号（每秒发送一次）
@@ -268,6 +286,7 @@ private:
     
     void printOpenGLInfo();
     void calculateDeltaTime();
+    bool needsNextFrame() const;
 
     // ============================================
     // 成员变量
@@ -286,7 +305,9 @@ private:
     
     // 渲染控制
     bool autoUpdate;
+    bool renderOnDemand;
     int targetFPS;
+    QTimer *frameLimitTimer;   // 目标帧率限制：单次定时器，到点再 update()
     
     // FPS 计算
     QTimer *fpsTimer;
@@ -5,6 +5,44 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+
+// 展开着色器文件中 #version 之后的 #include "路径"（GLSL 本身不支持）：被包含文件的内容
+// 原样插入该行的位置，路径相对于着色器文件所在目录；只展开一层。失败时返回 false
+static bool expandIncludes(std::string& code, const std::string& path)
+{
+    const std::string::size_type slash = path.find_last_of("/\\");
+    const std::string dir = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+
+    std::istringstream in(code);
+    std::ostringstream out;
+    std::string line;
+    while (std::getline(in, line)) {
+        const std::string::size_type begin = line.find_first_not_of(" \t");
+        if (begin == std::string::npos || line.compare(begin, 8, "#include") != 0) {
+            out << line << '\n';
+            continue;
+        }
+
+        const std::string::size_type open = line.find('"', begin);
+        const std::string::size_type close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            qCritical() << "ERROR::SHADER::BAD_INCLUDE:" << line.c_str() << "in" << path.c_str();
+            return false;
+        }
+        const std::string includePath = dir + line.substr(open + 1, close - open - 1);
+        std::ifstream includeFile(includePath);
+        if (!includeFile) {
+            qCritical() << "ERROR::SHADER::INCLUDE_NOT_FOUND:" << includePath.c_str();
+            return false;
+        }
+        std::stringstream includeStream;
+        includeStream << includeFile.rdbuf();
+        out << includeStream.str() << '\n';
+    }
+    code = out.str();
+    return true;
+}
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath)
 {
@@ -43,6 +81,12 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
         ID = 0;
         return;
     }
+
+    // cadshaders 的公共函数（实体属性表等）以 #include 形式写在 #version 之后
+    if (!expandIncludes(vertexCode, vertexPath) || !expandIncludes(fragmentCode, fragmentPath)) {
+        ID = 0;
+        return;
+    }
     
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
@@ -74,49 +118,46 @@ void Shader::use()
     glUseProgram(ID);
 }
 
+GLint Shader::uniform(const std::string& name) const
+{
+    auto it = uniforms_.find(name);
+    return it != uniforms_.end() ? it->second : -1;
+}
+
 // 移除所有函数的 const 修饰符
 void Shader::setBool(const std::string& name, bool value)
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(uniform(name), (int)value);
 }
 
 void Shader::setInt(const std::string& name, int value)
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(uniform(name), value);
 }
 
 void Shader::setFloat(const std::string& name, float value)
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(uniform(name), value);
 }
 
 void Shader::setVec3(const std::string& name, float x, float y, float z)
 {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    glUniform3f(uniform(name), x, y, z);
 }
 
 void Shader::setVec2(const std::string& name, const glm::vec2& value)
 {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform2fv(uniform(name), 1, &value[0]);
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& value)
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(uniform(name), 1, &value[0]);
 }
 
-// void Shader::setVec4(const std::string& name, const glm::vec4& value)
-// {
-//     glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
-// }
-
-// void Shader::setMat4(const std::string& name, const glm::mat4& mat)
-// {
-//     glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
-// }
 void Shader::setMat4(const std::string& name, const glm::mat4& mat)
 {
-    GLint location = glGetUniformLocation(ID, name.c_str());
+    GLint location = uniform(name);
     
     if (location == -1) {
         qWarning() << "Uniform" << name.c_str() << "not found in shader" << ID;
@@ -128,7 +169,7 @@ void Shader::setMat4(const std::string& name, const glm::mat4& mat)
 
 void Shader::setVec4(const std::string& name, const glm::vec4& value)
 {
-    GLint location = glGetUniformLocation(ID, name.c_str());
+    GLint location = uniform(name);
     
     if (location == -1) {
         qWarning() << "Uniform" << name.c_str() << "not found in shader" << ID;
@@ -141,7 +182,7 @@ void Shader::setVec4(const std::string& name, const glm::vec4& value)
 
 void Shader::setMat3(const std::string& name, const glm::mat3& mat)
 {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+    glUniformMatrix3fv(uniform(name), 1, GL_FALSE, glm::value_ptr(mat));
 }
 
 void Shader::compileShaders(const char* vShaderCode, const char* fShaderCode)
@@ -170,10 +211,47 @@ void Shader::compileShaders(const char* vShaderCode, const char* fShaderCode)
     // 删除着色器
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    cacheUniforms();
     
     qDebug() << "Shader program created successfully, ID:" << ID;
 }
 
+void Shader::cacheUniforms()
+{
+    uniforms_.clear();
+
+    int linked = 0;
+    glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+    if (!linked)
+        return;
+
+    // 遍历活动 uniform（uniform block 成员的位置为 -1，不会被单独设置）
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(std::size_t(std::max(maxLength, 1)), '\0');
+    for (GLint i = 0; i < count; ++i)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, GLuint(i), GLsizei(name.size()), &length, &size, &type, &name[0]);
+        std::string key(name.data(), std::size_t(length));
+        GLint location = glGetUniformLocation(ID, key.c_str());
+        if (location == -1)
+            continue;
+        uniforms_[key] = location;
+        // 数组以 "name[0]" 报告，同时登记不带下标的名字
+        if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+            uniforms_[key.substr(0, key.size() - 3)] = location;
+    }
+
+    GLuint camera = glGetUniformBlockIndex(ID, "Camera");
+    if (camera != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, camera, kCameraBinding);
+}
+
 void Shader::checkCompileErrors(unsigned int shader, std::string type)
 {
     int success;
@@ -5,13 +5,17 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <string>
+#include <unordered_map>
 
 class Shader : protected QOpenGLFunctions_3_3_Core
 {
 public:
     unsigned int ID;
+
+    // 名为 Camera 的 uniform block 在链接时绑定到此绑定点（缓冲由 Renderer::setCamera 维护）
+    static constexpr GLuint kCameraBinding = 0;
     
-    // 从文件路径构造
+    // 从文件路径构造；文件中的 #include "相对路径" 在编译前展开（见 cadshaders/common）
     Shader(const char* vertexPath, const char* fragmentPath);
     
     // 从字符串内容构造
@@ -33,9 +37,22 @@ public:
     void setMat3(const std::string& name, const glm::mat3& mat);     // 移除 const
     void setMat4(const std::string& name, const glm::mat4& mat);     // 移除 const
 
+    // uniform 位置在链接后一次性解析缓存；不存在时返回 -1（设置 -1 是合法的空操作）
+    GLint uniform(const std::string& name) const;
+
+    // 热路径：用 uniform() 预先取得的位置直接设置，跳过字符串查找
+    void setInt(GLint location, int value) { glUniform1i(location, value); }
+    void setFloat(GLint location, float value) { glUniform1f(location, value); }
+    void setVec2(GLint location, const glm::vec2& value) { glUniform2fv(location, 1, &value[0]); }
+    void setVec4(GLint location, const glm::vec4& value) { glUniform4fv(location, 1, &value[0]); }
+    void setMat4(GLint location, const glm::mat4& mat) { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat)); }
+
 private:
     void compileShaders(const char* vShaderCode, const char* fShaderCode);
+    void cacheUniforms();
     void checkCompileErrors(unsigned int shader, std::string type);
+
+    std::unordered_map<std::string, GLint> uniforms_;
 };
 
 #endif // SHADER_H
\ No newline at end of file
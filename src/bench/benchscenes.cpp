@@ -0,0 +1,233 @@
+#include "benchscenes.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+
+static constexpr float kTwoPi = 6.28318530718f;
+
+// ============================================
+// 随机量
+// ============================================
+
+struct SceneRng {
+    std::mt19937 gen;
+    explicit SceneRng(std::uint32_t seed) : gen(seed) {}
+
+    float uniform(float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(gen); }
+    // 对数均匀：跨多个数量级的尺寸（半径、线长）
+    float logUniform(float lo, float hi) { return std::exp(uniform(std::log(lo), std::log(hi))); }
+    glm::vec3 point(float extent) { return glm::vec3(uniform(-extent, extent), uniform(-extent, extent), 0.0f); }
+    Style style()
+    {
+        std::uniform_int_distribution<int> c(64, 255);
+        return Style::fromRGBA(std::uint8_t(c(gen)), std::uint8_t(c(gen)), std::uint8_t(c(gen)));
+    }
+};
+
+// ============================================
+// 场景生成器
+// ============================================
+
+static void addLines(Document &doc, SceneRng &rng, std::size_t n, float extent)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        glm::vec3 a = rng.point(extent);
+        float angle = rng.uniform(0.0f, kTwoPi);
+        float len = rng.logUniform(extent * 1e-3f, extent * 0.05f);
+        glm::vec3 b = a + glm::vec3(std::cos(angle), std::sin(angle), 0.0f) * len;
+        doc.addLine(a, b, rng.style());
+    }
+}
+
+static void addPolylines(Document &doc, SceneRng &rng, std::size_t n, std::size_t vertices, float extent)
+{
+    // 随机游走：每条折线覆盖场景的一小块区域，顶点密集
+    std::vector<glm::vec3> pts;
+    float step = extent * 0.2f / float(std::max<std::size_t>(vertices, 1));
+    // 短折线的点都进文档的顶点池，先一次预留
+    if (vertices <= PointPages::kMaxPagePoints)
+        doc.reserveVertices(doc.vertexPool().usedVertices() + n * vertices);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        pts.clear();
+        pts.reserve(vertices);
+        glm::vec3 p = rng.point(extent);
+        float heading = rng.uniform(0.0f, kTwoPi);
+        for (std::size_t k = 0; k < vertices; ++k)
+        {
+            pts.push_back(p);
+            heading += rng.uniform(-0.5f, 0.5f);
+            p += glm::vec3(std::cos(heading), std::sin(heading), 0.0f) * step;
+        }
+        doc.addPolyline(pts, false, rng.style());
+    }
+}
+
+static void addCurves(Document &doc, SceneRng &rng, std::size_t n, float extent)
+{
+    // 半数整圆、半数圆弧，半径跨越四个数量级
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        glm::vec3 c = rng.point(extent);
+        float r = rng.logUniform(extent * 1e-4f, extent * 0.2f);
+        if (i % 2 == 0)
+        {
+            doc.addCircle(c, r, rng.style());
+        }
+        else
+        {
+            float a0 = rng.uniform(0.0f, kTwoPi);
+            float span = rng.uniform(0.1f, kTwoPi);
+            doc.addArc(c, r, a0, a0 + span, rng.style());
+        }
+    }
+}
+
+static void addBoxes(Document &doc, SceneRng &rng, std::size_t n, float extent)
+{
+    // 规则网格，边长为间距的 60%
+    std::size_t side = std::size_t(std::ceil(std::sqrt(double(n))));
+    float spacing = 2.0f * extent / float(std::max<std::size_t>(side, 1));
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        std::size_t x = i % side, y = i / side;
+        glm::vec3 c(-extent + (float(x) + 0.5f) * spacing, -extent + (float(y) + 0.5f) * spacing, 0.0f);
+        doc.addBox(c, spacing * 0.6f, rng.style());
+    }
+}
+
+static void generateLines(Document &doc, const SceneParams &p)
+{
+    SceneRng rng(p.seed);
+    addLines(doc, rng, p.count, p.extent);
+}
+
+static void generatePolylines(Document &doc, const SceneParams &p)
+{
+    SceneRng rng(p.seed);
+    addPolylines(doc, rng, p.count, p.vertices, p.extent);
+}
+
+static void generateCurves(Document &doc, const SceneParams &p)
+{
+    SceneRng rng(p.seed);
+    addCurves(doc, rng, p.count, p.extent);
+}
+
+static void generateBoxes(Document &doc, const SceneParams &p)
+{
+    SceneRng rng(p.seed);
+    addBoxes(doc, rng, p.count, p.extent);
+}
+
+static void generateMixed(Document &doc, const SceneParams &p)
+{
+    // 40% 直线，40% 圆/圆弧，15% 立方体，5% 折线
+    SceneRng rng(p.seed);
+    std::size_t n = p.count;
+    addLines(doc, rng, n * 40 / 100, p.extent);
+    addCurves(doc, rng, n * 40 / 100, p.extent);
+    addBoxes(doc, rng, n * 15 / 100, p.extent);
+    addPolylines(doc, rng, std::max<std::size_t>(n * 5 / 100, 1), std::max<std::size_t>(p.vertices / 10, 2), p.extent);
+}
+
+const std::vector<SceneInfo> &benchScenes()
+{
+    static const std::vector<SceneInfo> scenes = {
+        {"lines", "N random line segments, lengths 0.1%-5% of the scene", 100000, generateLines},
+        {"polylines", "N dense random-walk polylines with M vertices each", 200, generatePolylines},
+        {"curves", "N circles and arcs, radii spanning four orders of magnitude", 50000, generateCurves},
+        {"boxes", "N boxes on a regular grid", 10000, generateBoxes},
+        {"mixed", "lines, curves, boxes and polylines in one document", 100000, generateMixed},
+    };
+    return scenes;
+}
+
+const SceneInfo *findBenchScene(const char *name)
+{
+    for (const SceneInfo &s : benchScenes())
+    {
+        if (std::strcmp(s.name, name) == 0)
+            return &s;
+    }
+    return nullptr;
+}
+
+// ============================================
+// 相机路径
+// ============================================
+
+// 俯视正交相机：中心 (cx, cy)，可见半高 halfH
+static CameraPose topView(const Aabb &bounds, float aspect, float cx, float cy, float halfH)
+{
+    glm::vec3 e = bounds.extent();
+    float dist = e.z + 10.0f;
+    CameraPose pose;
+    pose.view = glm::lookAt(glm::vec3(cx, cy, bounds.max.z + dist), glm::vec3(cx, cy, bounds.min.z),
+                            glm::vec3(0.0f, 1.0f, 0.0f));
+    pose.proj = glm::ortho(-halfH * aspect, halfH * aspect, -halfH, halfH, 0.1f, dist + e.z + 10.0f);
+    return pose;
+}
+
+static float fitHalfHeight(const Aabb &bounds, float aspect)
+{
+    glm::vec3 e = bounds.extent();
+    return std::max(e.y * 0.5f, e.x * 0.5f / aspect) * 1.05f;
+}
+
+// 放大 4 倍后从左到右横扫整个场景：可见集合持续变化
+static CameraPose panPose(const Aabb &bounds, float aspect, float t)
+{
+    glm::vec3 c = bounds.center();
+    float halfW = bounds.extent().x * 0.5f;
+    float x = c.x - halfW + 2.0f * halfW * t;
+    return topView(bounds, aspect, x, c.y, fitHalfHeight(bounds, aspect) * 0.25f);
+}
+
+// 从全图放大到 1/1000 再缩回：屏幕尺寸跨三个数量级
+static CameraPose zoomPose(const Aabb &bounds, float aspect, float t)
+{
+    glm::vec3 c = bounds.center();
+    float tri = t < 0.5f ? t * 2.0f : (1.0f - t) * 2.0f;
+    float scale = std::exp(std::log(1e-3f) * tri);
+    return topView(bounds, aspect, c.x, c.y, fitHalfHeight(bounds, aspect) * scale);
+}
+
+// 透视相机绕场景中心旋转一周，俯仰 35°
+static CameraPose orbitPose(const Aabb &bounds, float aspect, float t)
+{
+    glm::vec3 c = bounds.center();
+    float radius = glm::length(bounds.extent()) * 0.5f;
+    float dist = std::max(radius, 1e-3f) * 1.5f / std::tan(glm::radians(22.5f));
+    float yaw = kTwoPi * t;
+    float pitch = glm::radians(35.0f);
+    glm::vec3 eye = c + dist * glm::vec3(std::cos(pitch) * std::cos(yaw), std::cos(pitch) * std::sin(yaw), std::sin(pitch));
+
+    CameraPose pose;
+    pose.view = glm::lookAt(eye, c, glm::vec3(0.0f, 0.0f, 1.0f));
+    pose.proj = glm::perspective(glm::radians(45.0f), aspect, dist * 0.01f, dist + radius * 2.0f);
+    return pose;
+}
+
+const std::vector<CameraPathInfo> &benchCameraPaths()
+{
+    static const std::vector<CameraPathInfo> paths = {
+        {"pan", "4x zoomed top view sweeping across the scene", panPose},
+        {"zoom", "top view zooming from fit-all to 1/1000 and back", zoomPose},
+        {"orbit", "perspective camera orbiting the scene at 35 degrees pitch", orbitPose},
+    };
+    return paths;
+}
+
+const CameraPathInfo *findBenchCameraPath(const char *name)
+{
+    for (const CameraPathInfo &p : benchCameraPaths())
+    {
+        if (std::strcmp(p.name, name) == 0)
+            return &p;
+    }
+    return nullptr;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "../cad/data/document.h"
+
+// ============================================
+// 基准测试用的参数化场景与相机路径
+// 所有随机量都由 seed 决定：同一参数、同一标准库实现下生成的场景完全一致
+// ============================================
+
+struct SceneParams {
+    std::size_t count = 0;        // 实体数
+    std::size_t vertices = 1000;  // 每条折线的顶点数
+    float extent = 1000.0f;       // 场景半边长（世界单位），实体分布在 [-extent, extent]² 的 z = 0 平面上
+    std::uint32_t seed = 1;
+};
+
+struct SceneInfo {
+    const char* name;
+    const char* description;
+    std::size_t defaultCount;     // 未指定 count 时使用
+    void (*generate)(Document& doc, const SceneParams& params);
+};
+
+// lines / polylines / curves / boxes / mixed
+const std::vector<SceneInfo>& benchScenes();
+const SceneInfo* findBenchScene(const char* name);
+
+// 相机姿态与路径：t ∈ [0, 1] 为路径上的位置
+struct CameraPose {
+    glm::mat4 view{1.0f};
+    glm::mat4 proj{1.0f};
+};
+
+struct CameraPathInfo {
+    const char* name;
+    const char* description;
+    CameraPose (*pose)(const Aabb& bounds, float aspect, float t);
+};
+
+// pan / zoom / orbit
+const std::vector<CameraPathInfo>& benchCameraPaths();
+const CameraPathInfo* findBenchCameraPath(const char* name);
@@ -0,0 +1,343 @@
+// ============================================
+// RenderBench - 端到端渲染基准
+// 生成参数化场景 → Document → Renderer::syncFromDocument → Renderer::draw（离屏），
+// 沿脚本化相机路径逐帧计时，结果以 JSON 输出
+//
+// 例：RenderBench --scene lines,curves --count 200000 --frames 240 --out result.json
+// 无显示器的 Linux：QT_QPA_PLATFORM=offscreen LIBGL_ALWAYS_SOFTWARE=1 RenderBench ...
+// ============================================
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+#include "benchscenes.h"
+#include "../cad/data/offscreenrenderer.h"
+
+// ============================================
+// 统计
+// ============================================
+
+// 均值与分位数（nearest-rank）
+static QJsonObject summarize(std::vector<double> v)
+{
+    QJsonObject o;
+    if (v.empty())
+        return o;
+
+    std::sort(v.begin(), v.end());
+    auto percentile = [&v](double p)
+    {
+        std::size_t rank = std::size_t(std::ceil(p * double(v.size())));
+        return v[std::min(std::max<std::size_t>(rank, 1), v.size()) - 1];
+    };
+
+    o["mean"] = std::accumulate(v.begin(), v.end(), 0.0) / double(v.size());
+    o["min"] = v.front();
+    o["p50"] = percentile(0.50);
+    o["p90"] = percentile(0.90);
+    o["p95"] = percentile(0.95);
+    o["p99"] = percentile(0.99);
+    o["max"] = v.back();
+    return o;
+}
+
+static QJsonObject frameToJson(const FrameTiming &t, const RenderStats &s)
+{
+    QJsonObject o;
+    o["syncCpuMs"] = t.syncCpuMs;
+    o["drawCpuMs"] = t.drawCpuMs;
+    o["syncGpuMs"] = t.syncGpuMs;
+    o["drawGpuMs"] = t.drawGpuMs;
+    o["frameMs"] = t.frameMs;
+    o["drawCalls"] = double(s.drawCalls);
+    o["bytesUploaded"] = double(s.bytesUploaded);
+    o["bytesCopied"] = double(s.bytesCopied);
+    o["entitiesUploaded"] = double(s.entitiesUploaded);
+    o["visibleEntities"] = double(s.visibleEntities);
+    o["curvesRetessellated"] = double(s.curvesRetessellated);
+    o["entitiesPatched"] = double(s.entitiesPatched);
+    o["bytesStaged"] = double(s.bytesStaged);
+    o["stagingStalls"] = double(s.stagingStalls);
+    o["pagesUploaded"] = double(s.pagesUploaded);
+    return o;
+}
+
+// ============================================
+// 相机路径
+// ============================================
+
+static QJsonObject runPath(OffscreenRenderer &off, const Document &doc, const Aabb &bounds,
+                           const CameraPathInfo &path, int frames, int warmup)
+{
+    float aspect = float(off.width()) / float(std::max(off.height(), 1));
+
+    std::vector<double> syncCpu, drawCpu, syncGpu, drawGpu, frame;
+    std::vector<double> drawCalls, bytesUploaded, bytesCopied, entitiesUploaded, visible, retessellated;
+    std::vector<double> bytesStaged, stagingStalls;
+    double totalUploaded = 0.0;
+
+    // 预热帧停在路径起点，不计入统计
+    for (int i = -warmup; i < frames; ++i)
+    {
+        float t = frames > 1 ? float(std::max(i, 0)) / float(frames - 1) : 0.0f;
+        CameraPose pose = path.pose(bounds, aspect, t);
+        off.setView(pose.view, pose.proj);
+
+        const FrameTiming &ft = off.renderFrame(doc);
+        if (i < 0)
+            continue;
+
+        RenderStats s = off.renderer().stats();
+        syncCpu.push_back(ft.syncCpuMs);
+        drawCpu.push_back(ft.drawCpuMs);
+        syncGpu.push_back(ft.syncGpuMs);
+        drawGpu.push_back(ft.drawGpuMs);
+        frame.push_back(ft.frameMs);
+        drawCalls.push_back(double(s.drawCalls));
+        bytesUploaded.push_back(double(s.bytesUploaded));
+        bytesCopied.push_back(double(s.bytesCopied));
+        entitiesUploaded.push_back(double(s.entitiesUploaded));
+        visible.push_back(double(s.visibleEntities));
+        retessellated.push_back(double(s.curvesRetessellated));
+        bytesStaged.push_back(double(s.bytesStaged));
+        stagingStalls.push_back(double(s.stagingStalls));
+        totalUploaded += double(s.bytesUploaded);
+    }
+
+    QJsonObject phases;
+    phases["syncCpuMs"] = summarize(syncCpu);
+    phases["drawCpuMs"] = summarize(drawCpu);
+    phases["syncGpuMs"] = summarize(syncGpu);
+    phases["drawGpuMs"] = summarize(drawGpu);
+    phases["frameMs"] = summarize(frame);
+
+    QJsonObject o;
+    o["path"] = path.name;
+    o["frames"] = frames;
+    o["phases"] = phases;
+    o["drawCalls"] = summarize(drawCalls);
+    o["bytesUploaded"] = summarize(bytesUploaded);
+    o["bytesUploadedTotal"] = totalUploaded;
+    o["bytesCopied"] = summarize(bytesCopied);
+    o["entitiesUploaded"] = summarize(entitiesUploaded);
+    o["visibleEntities"] = summarize(visible);
+    o["curvesRetessellated"] = summarize(retessellated);
+    o["bytesStaged"] = summarize(bytesStaged);
+    o["stagingStalls"] = summarize(stagingStalls);
+
+    QJsonObject frameStats = phases["frameMs"].toObject();
+    qInfo().noquote() << QString("  %1: frame p50 %2 ms, p99 %3 ms, %4 draw calls/frame, %5 KB uploaded/frame")
+                             .arg(path.name, -6)
+                             .arg(frameStats["p50"].toDouble(), 0, 'f', 3)
+                             .arg(frameStats["p99"].toDouble(), 0, 'f', 3)
+                             .arg(o["drawCalls"].toObject()["mean"].toDouble(), 0, 'f', 1)
+                             .arg(o["bytesUploaded"].toObject()["mean"].toDouble() / 1024.0, 0, 'f', 1);
+    return o;
+}
+
+// 逗号分隔的名字列表；"all" 展开为全部
+template <class Info, class Find>
+static bool resolveList(const QString &arg, const std::vector<Info> &all, Find find,
+                        std::vector<const Info *> &out)
+{
+    out.clear();
+    if (arg == "all")
+    {
+        for (const Info &info : all)
+            out.push_back(&info);
+        return true;
+    }
+    for (const QString &name : arg.split(',', Qt::SkipEmptyParts))
+    {
+        const Info *info = find(name.trimmed().toUtf8().constData());
+        if (!info)
+        {
+            qCritical().noquote() << "Unknown name:" << name;
+            return false;
+        }
+        out.push_back(info);
+    }
+    return !out.empty();
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef Q_OS_LINUX
+    // 没有显示服务时默认使用 offscreen 平台插件
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM") &&
+        qEnvironmentVariableIsEmpty("DISPLAY") && qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+#endif
+
+    QGuiApplication app(argc, argv);
+    app.setApplicationName("RenderBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("End-to-end CAD rendering benchmark (offscreen)");
+    parser.addHelpOption();
+    QCommandLineOption sceneOpt("scene", "Scenes: all or a comma list of lines,polylines,curves,boxes,mixed.", "names", "all");
+    QCommandLineOption pathOpt("path", "Camera paths: all or a comma list of pan,zoom,orbit.", "names", "all");
+    QCommandLineOption countOpt("count", "Entity count (default depends on the scene).", "n", "0");
+    QCommandLineOption verticesOpt("vertices", "Vertices per polyline.", "m", "1000");
+    QCommandLineOption extentOpt("extent", "Scene half-size in world units.", "size", "1000");
+    QCommandLineOption seedOpt("seed", "Random seed.", "seed", "1");
+    QCommandLineOption framesOpt("frames", "Measured frames per camera path.", "n", "120");
+    QCommandLineOption warmupOpt("warmup", "Unmeasured frames before each path.", "n", "5");
+    QCommandLineOption widthOpt("width", "Framebuffer width.", "px", "1920");
+    QCommandLineOption heightOpt("height", "Framebuffer height.", "px", "1080");
+    QCommandLineOption samplesOpt("samples", "MSAA samples (0 = off; lines are anti-aliased in the shader).", "n", "0");
+    QCommandLineOption tessOpt("tessellated", "Tessellate circles/arcs on the CPU instead of the GPU.");
+    QCommandLineOption noCullOpt("no-cull", "Disable frustum culling.");
+    QCommandLineOption threadsOpt("threads", "Threads for tessellation/packing (0 = all cores, 1 = serial).", "n", "0");
+    QCommandLineOption pngOpt("png", "Write a fit-all snapshot of each scene into this directory.", "dir");
+    QCommandLineOption outOpt("out", "Write JSON here instead of stdout.", "file");
+    QCommandLineOption listOpt("list", "List scenes and camera paths, then exit.");
+    parser.addOptions({sceneOpt, pathOpt, countOpt, verticesOpt, extentOpt, seedOpt, framesOpt, warmupOpt,
+                       widthOpt, heightOpt, samplesOpt, tessOpt, noCullOpt, threadsOpt, pngOpt, outOpt, listOpt});
+    parser.process(app);
+
+    if (parser.isSet(listOpt))
+    {
+        std::printf("Scenes:\n");
+        for (const SceneInfo &s : benchScenes())
+            std::printf("  %-10s %s (default count %zu)\n", s.name, s.description, s.defaultCount);
+        std::printf("Camera paths:\n");
+        for (const CameraPathInfo &p : benchCameraPaths())
+            std::printf("  %-10s %s\n", p.name, p.description);
+        return 0;
+    }
+
+    std::vector<const SceneInfo *> scenes;
+    std::vector<const CameraPathInfo *> paths;
+    if (!resolveList(parser.value(sceneOpt), benchScenes(), findBenchScene, scenes) ||
+        !resolveList(parser.value(pathOpt), benchCameraPaths(), findBenchCameraPath, paths))
+    {
+        return 2;
+    }
+
+    SceneParams params;
+    params.vertices = std::max(parser.value(verticesOpt).toULongLong(), 2ull);
+    params.extent = std::max(parser.value(extentOpt).toFloat(), 1e-3f);
+    params.seed = parser.value(seedOpt).toUInt();
+    std::size_t count = parser.value(countOpt).toULongLong();
+    int frames = std::max(parser.value(framesOpt).toInt(), 1);
+    int warmup = std::max(parser.value(warmupOpt).toInt(), 0);
+    int width = std::max(parser.value(widthOpt).toInt(), 1);
+    int height = std::max(parser.value(heightOpt).toInt(), 1);
+    int samples = std::max(parser.value(samplesOpt).toInt(), 0);
+    bool analytic = !parser.isSet(tessOpt);
+    bool culling = !parser.isSet(noCullOpt);
+    unsigned threads = parser.value(threadsOpt).toUInt();
+
+    // 输出路径先转为绝对路径：下面可能切换工作目录去找 shaders/
+    QString outPath = parser.isSet(outOpt) ? QFileInfo(parser.value(outOpt)).absoluteFilePath() : QString();
+    QString pngDir = parser.isSet(pngOpt) ? QFileInfo(parser.value(pngOpt)).absoluteFilePath() : QString();
+    if (!pngDir.isEmpty())
+        QDir().mkpath(pngDir);
+    if (!QDir("shaders").exists())
+        QDir::setCurrent(QCoreApplication::applicationDirPath());
+
+    OffscreenRenderer off;
+    if (!off.initialize(width, height, samples))
+    {
+        qCritical() << "Failed to initialize offscreen renderer";
+        return 1;
+    }
+    off.renderer().setAnalyticCurves(analytic);
+    off.renderer().setCulling(culling);
+    off.renderer().setWorkerThreads(threads);
+
+    QJsonObject gl;
+    {
+        QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+        gl["vendor"] = QString::fromLatin1((const char *)f->glGetString(GL_VENDOR));
+        gl["renderer"] = QString::fromLatin1((const char *)f->glGetString(GL_RENDERER));
+        gl["version"] = QString::fromLatin1((const char *)f->glGetString(GL_VERSION));
+    }
+
+    QJsonObject config;
+    config["width"] = width;
+    config["height"] = height;
+    config["samples"] = samples;
+    config["frames"] = frames;
+    config["warmup"] = warmup;
+    config["seed"] = double(params.seed);
+    config["extent"] = params.extent;
+    config["analyticCurves"] = analytic;
+    config["culling"] = culling;
+    config["threads"] = double(threads);
+
+    QJsonArray sceneResults;
+    for (const SceneInfo *scene : scenes)
+    {
+        SceneParams p = params;
+        p.count = count ? count : scene->defaultCount;
+
+        // 构建文档
+        Document doc;
+        QElapsedTimer timer;
+        timer.start();
+        scene->generate(doc, p);
+        double buildMs = timer.nsecsElapsed() / 1.0e6;
+        Aabb bounds = doc.spatialIndex().rootBounds();
+
+        qInfo().noquote() << QString("%1: %2 entities, built in %3 ms")
+                                 .arg(scene->name).arg(doc.size()).arg(buildMs, 0, 'f', 1);
+
+        // 首帧：全量上传，全图视角
+        off.fitTopView(bounds);
+        const FrameTiming &first = off.renderFrame(doc, true);
+        QJsonObject load = frameToJson(first, off.renderer().stats());
+        if (!pngDir.isEmpty())
+            off.savePng(QDir(pngDir).filePath(QString("%1.png").arg(scene->name)));
+
+        QJsonArray pathResults;
+        for (const CameraPathInfo *path : paths)
+            pathResults.append(runPath(off, doc, bounds, *path, frames, warmup));
+
+        QJsonObject o;
+        o["scene"] = scene->name;
+        o["count"] = double(p.count);
+        o["vertices"] = double(p.vertices);
+        o["entities"] = double(doc.size());
+        o["buildDocumentMs"] = buildMs;
+        o["firstFrame"] = load;
+        o["paths"] = pathResults;
+        sceneResults.append(o);
+    }
+    off.shutdown();
+
+    QJsonObject root;
+    root["benchmark"] = "RenderBench";
+    root["gl"] = gl;
+    root["config"] = config;
+    root["scenes"] = sceneResults;
+    QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+
+    QFile out(outPath);
+    bool opened = outPath.isEmpty() ? out.open(stdout, QIODevice::WriteOnly)
+                                    : out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!opened)
+    {
+        qCritical().noquote() << "Cannot write" << outPath;
+        return 1;
+    }
+    out.write(json);
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include "GridAxisHelper.h"
 #include <cmath>
+#include <cstring>
 #include <QDebug>
 
 // ============================================
@@ -71,7 +72,7 @@ float GridRenderer::chooseMinorStep(float worldPerPixel)
 // ============================================
 
 GridRenderer::GridRenderer()
-    : gridVAO_(0), gridVBO_(0), initialized_(false)
+    : gridVAO_(0), initialized_(false)
 {
 }
 
@@ -99,26 +100,21 @@ void GridRenderer::initializeGrid()
         return;
     }
 
-    // ✅ 创建一个覆盖整个视口的大四边形
-    // 在 draw() 中会根据实际视口范围动态调整
-    float vertices[] = {
-        -1.0f, -1.0f, -0.02f, // 左下
-        1.0f, -1.0f, -0.02f,  // 右下
-        1.0f, 1.0f, -0.02f,   // 右上
-        -1.0f, 1.0f, -0.02f   // 左上
-    };
+    // 常量 uniform 只设置一次；相机来自 Renderer 维护的 Camera uniform block
+    gridShader_->use();
+    gridShader_->setMat4("model", glm::mat4(1.0f));
+    gridShader_->setFloat("fadeNear", 30.0f);
+    gridShader_->setFloat("fadeFar", 60.0f);
+    uGridMinor_ = gridShader_->uniform("gridMinor");
+    uGridMajor_ = gridShader_->uniform("gridMajor");
+    uMinorColor_ = gridShader_->uniform("minorColor");
+    uMajorColor_ = gridShader_->uniform("majorColor");
 
+    // ✅ 覆盖可见区域的大四边形：每帧在 draw() 中写进 Renderer 的流式环形缓冲，
+    // VAO 只记录属性格式，缓冲与偏移在绘制时指向本帧写入的位置
     glGenVertexArrays(1, &gridVAO_);
-    glGenBuffers(1, &gridVBO_);
-
     glBindVertexArray(gridVAO_);
-    glBindBuffer(GL_ARRAY_BUFFER, gridVBO_);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
     glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
     initialized_ = true;
@@ -129,9 +125,7 @@ void GridRenderer::cleanup()
 {
     if (gridVAO_)
         glDeleteVertexArrays(1, &gridVAO_);
-    if (gridVBO_)
-        glDeleteBuffers(1, &gridVBO_);
-    gridVAO_ = gridVBO_ = 0;
+    gridVAO_ = 0;
     initialized_ = false;
 }
 
@@ -174,9 +168,13 @@ void GridRenderer::draw(Renderer &r, const ViewportState &vp,
         maxXY.x + padding, maxXY.y + padding, -0.0f,
         minXY.x - padding, maxXY.y + padding, -0.0f};
 
-    glBindBuffer(GL_ARRAY_BUFFER, gridVBO_);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // 直接写进流式环形缓冲（不与 GPU 同步，上一帧的四边形不会被覆盖）
+    GLint first = 0;
+    void *dst = r.mapStream(4, 3 * sizeof(float), first);
+    if (!dst)
+        return;
+    std::memcpy(dst, vertices, sizeof(vertices));
+    r.unmapStream();
 
      // ✅ 使用深度测试 + 禁用深度写入，让网格在背景但不影响深度缓冲
     glEnable(GL_DEPTH_TEST);
@@ -187,21 +185,19 @@ void GridRenderer::draw(Renderer &r, const ViewportState &vp,
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // 使用 shader
+    r.setCamera(vp);
     gridShader_->use();
-    gridShader_->setMat4("model", glm::mat4(1.0f));
-    gridShader_->setMat4("view", vp.view);
-    gridShader_->setMat4("projection", vp.proj);
-    gridShader_->setFloat("gridMinor", minor);
-    gridShader_->setFloat("gridMajor", major);
-    gridShader_->setVec4("minorColor", minorCol);
-    gridShader_->setVec4("majorColor", majorCol);
-    gridShader_->setFloat("worldPerPixel", vp.worldPerPixel);
-    gridShader_->setFloat("fadeNear", 30.0f);
-    gridShader_->setFloat("fadeFar", 60.0f);
+    gridShader_->setFloat(uGridMinor_, minor);
+    gridShader_->setFloat(uGridMajor_, major);
+    gridShader_->setVec4(uMinorColor_, minorCol);
+    gridShader_->setVec4(uMajorColor_, majorCol);
 
     // 绘制四边形
     glBindVertexArray(gridVAO_);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    glBindBuffer(GL_ARRAY_BUFFER, r.streamBuffer());
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDrawArrays(GL_TRIANGLE_FAN, first, 4);
     glBindVertexArray(0);
 }
 
@@ -219,14 +215,11 @@ void GridRenderer::drawLines(Renderer &r, const ViewportState &vp,
 // ============================================
 
 AxisRenderer::AxisRenderer()
-    : axisVAO_(0), axisVBO_(0), initialized_(false)
+    : initialized_(false)
 {
 }
 
-AxisRenderer::~AxisRenderer()
-{
-    cleanup();
-}
+AxisRenderer::~AxisRenderer() = default;
 
 void AxisRenderer::initializeAxis()
 {
@@ -234,34 +227,7 @@ void AxisRenderer::initializeAxis()
         return;
 
     initializeOpenGLFunctions();
-
-    try
-    {
-        axisShader_ = std::make_unique<Shader>(
-            "shaders/axis/axis.vs",
-            "shaders/axis/axis.fs");
-    }
-    catch (const std::exception &e)
-    {
-        qCritical() << "Failed to create grid shader:" << e.what();
-        return;
-    }
-
-    glGenVertexArrays(1, &axisVAO_);
-    glGenBuffers(1, &axisVBO_);
-
     initialized_ = true;
-    qDebug() << "AxisRenderer initialized with shader";
-}
-
-void AxisRenderer::cleanup()
-{
-    if (axisVAO_)
-        glDeleteVertexArrays(1, &axisVAO_);
-    if (axisVBO_)
-        glDeleteBuffers(1, &axisVBO_);
-    axisVAO_ = axisVBO_ = 0;
-    initialized_ = false;
 }
 
 void AxisRenderer::draw(Renderer& r, const ViewportState& vp,
@@ -275,63 +241,20 @@ void AxisRenderer::draw(Renderer& r, const ViewportState& vp,
         initializeAxis();
     }
 
-    auto colorToVec4 = [](std::uint32_t color) {
-        float r = ((color >> 24) & 0xFF) / 255.0f;
-        float g = ((color >> 16) & 0xFF) / 255.0f;
-        float b = ((color >> 8) & 0xFF) / 255.0f;
-        float a = (color & 0xFF) / 255.0f;
-        return glm::vec4(r, g, b, a);
-    };
-
-    glm::vec4 xCol = colorToVec4(xColor);
-    glm::vec4 yCol = colorToVec4(yColor);
-    glm::vec4 zCol = colorToVec4(zColor);
-
-    // ✅ 总是准备完整的 3 轴数据（简单！）
-    float vertices[] = {
-        // X 轴（顶点 0, 1）
-        0.0f, 0.0f, 0.0f,  xCol.r, xCol.g, xCol.b, 1.0f,
-        axisLength, 0.0f, 0.0f,  xCol.r, xCol.g, xCol.b, 1.0f,
-        // Y 轴（顶点 2, 3）
-        0.0f, 0.0f, 0.0f,  yCol.r, yCol.g, yCol.b, yCol.a,
-        0.0f, axisLength, 0.0f,  yCol.r, yCol.g, yCol.b, yCol.a,
-        // Z 轴（顶点 4, 5）
-        0.0f, 0.0f, 0.0f,  zCol.r, zCol.g, zCol.b, zCol.a,
-        0.0f, 0.0f, axisLength,  zCol.r, zCol.g, zCol.b, zCol.a
-    };
-
-    glBindVertexArray(axisVAO_);
-    glBindBuffer(GL_ARRAY_BUFFER, axisVBO_);
-    
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // ✅ 每根轴一条线段；宽线由渲染器的屏幕空间四边形绘制（core profile 下 glLineWidth > 1 不可用）
+    const std::vector<glm::vec3> xAxis = {glm::vec3(0.0f), glm::vec3(axisLength, 0.0f, 0.0f)};
+    const std::vector<glm::vec3> yAxis = {glm::vec3(0.0f), glm::vec3(0.0f, axisLength, 0.0f)};
+    const std::vector<glm::vec3> zAxis = {glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, axisLength)};
 
+    // 坐标轴始终画在最上层
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_ALWAYS);
-    glEnable(GL_LINE_SMOOTH);
-    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
-    glLineWidth(2.0f);
 
-    axisShader_->use();
-    axisShader_->setMat4("model", glm::mat4(1.0f));
-    axisShader_->setMat4("view", vp.view);
-    axisShader_->setMat4("projection", vp.proj);
-
-    
-    // ✅ 如果需要，再绘制 Z 轴（顶点 4-5，共 2 个顶点 = 1 条线）
+    r.drawLineSegments(xAxis, xColor, vp, kAxisWidth);
+    r.drawLineSegments(yAxis, yColor, vp, kAxisWidth);
     if (drawZ) {
-        glDrawArrays(GL_LINES, 0, 6);
-    } else {
-        // ✅ 先绘制 X 和 Y 轴（顶点 0-3，共 4 个顶点 = 2 条线）
-        glDrawArrays(GL_LINES, 0, 4);
+        r.drawLineSegments(zAxis, zColor, vp, kAxisWidth);
     }
 
     glDepthFunc(GL_LESS);
-    glDisable(GL_LINE_SMOOTH);
-    glLineWidth(1.0f);
-    glBindVertexArray(0);
-}
\ No newline at end of file
+}
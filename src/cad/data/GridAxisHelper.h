@@ -31,7 +31,8 @@ private:
     
     // Shader 方式
     std::unique_ptr<Shader> gridShader_;
-    unsigned int gridVAO_, gridVBO_;
+    GLint uGridMinor_ = -1, uGridMajor_ = -1, uMinorColor_ = -1, uMajorColor_ = -1;
+    unsigned int gridVAO_;
     bool initialized_;
 };
 
@@ -49,9 +50,7 @@ public:
 
 private:
     void initializeAxis();
-    void cleanup();
-    
-    std::unique_ptr<Shader> axisShader_;
-    unsigned int axisVAO_, axisVBO_;
+
+    static constexpr float kAxisWidth = 2.0f;  // 像素
     bool initialized_;
 };
\ No newline at end of file
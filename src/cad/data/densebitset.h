@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// ============================================
+// DenseBitset - 按 64 位字存储的稠密位集
+// 用于 visible / dirty 等逐实体标志，支持整字批量清零与扫描
+// ============================================
+class DenseBitset {
+public:
+    std::size_t size() const { return size_; }
+
+    bool test(std::size_t i) const { return (words_[i >> 6] >> (i & 63)) & 1ull; }
+
+    void set(std::size_t i, bool v)
+    {
+        std::uint64_t mask = 1ull << (i & 63);
+        if (v) words_[i >> 6] |= mask;
+        else   words_[i >> 6] &= ~mask;
+    }
+
+    void pushBack(bool v)
+    {
+        if ((size_ & 63) == 0) words_.push_back(0);
+        ++size_;
+        set(size_ - 1, v);
+    }
+
+    void popBack()
+    {
+        set(size_ - 1, false);
+        --size_;
+        if ((size_ & 63) == 0) words_.pop_back();
+    }
+
+    void clearAll()
+    {
+        for (auto &w : words_) w = 0;
+    }
+
+    void reset()
+    {
+        words_.clear();
+        size_ = 0;
+    }
+
+    bool any() const
+    {
+        for (auto w : words_)
+            if (w) return true;
+        return false;
+    }
+
+    // 遍历所有置位的下标：f(std::size_t index)
+    template <class F>
+    void forEachSet(F &&f) const
+    {
+        for (std::size_t wi = 0; wi < words_.size(); ++wi)
+        {
+            std::uint64_t w = words_[wi];
+            while (w)
+            {
+                unsigned bit = unsigned(__builtin_ctzll(w));
+                f((wi << 6) + bit);
+                w &= w - 1;
+            }
+        }
+    }
+
+private:
+    std::vector<std::uint64_t> words_;
+    std::size_t size_ = 0;
+};
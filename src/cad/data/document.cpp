@@ -1,81 +1,468 @@
 #include "document.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
 
-const Entity* Document::get(EntityId id) const {
-    auto it = map_.find(id);
-    return it == map_.end() ? nullptr : &it->second;
+Document::Document()
+    : vertexPool_(std::make_unique<VertexPool>())
+{
 }
-Entity* Document::get(EntityId id) {
-    auto it = map_.find(id);
-    return it == map_.end() ? nullptr : &it->second;
+
+Document::~Document() = default;
+
+Document::Document(const Document& o)
+    : vertexPool_(std::make_unique<VertexPool>())
+{
+    *this = o;
 }
 
-std::vector<const Entity*> Document::all() const {
-    std::vector<const Entity*> out;
-    out.reserve(map_.size());
-    for (auto& kv : map_) out.push_back(&kv.second);
-    return out;
+Document& Document::operator=(const Document& o) {
+    if (this == &o) return *this;
+    lines_ = o.lines_;
+    circles_ = o.circles_;
+    arcs_ = o.arcs_;
+    boxes_ = o.boxes_;
+    sparse_ = o.sparse_;
+    freeIndices_ = o.freeIndices_;
+    index_ = o.index_;
+    journal_ = o.journal_;
+    version_ = o.version_;
+    resyncBefore_ = o.resyncBefore_;
+
+    // 顶点池一次整块拷贝；折线逐条只改池指针，不拷点
+    *vertexPool_ = *o.vertexPool_;
+    polylines_.ids = o.polylines_.ids;
+    polylines_.styles = o.polylines_.styles;
+    polylines_.visible = o.polylines_.visible;
+    polylines_.dirty = o.polylines_.dirty;
+    polylines_.geom.clear();
+    polylines_.geom.reserve(o.polylines_.geom.size());
+    for (const Polyline& P : o.polylines_.geom)
+        polylines_.geom.push_back(Polyline{PointPages::inPoolCopy(P.pts, *vertexPool_), P.closed});
+    return *this;
+}
+
+Document::Document(Document&& o)
+    : vertexPool_(std::make_unique<VertexPool>())
+{
+    *this = std::move(o);
+}
+
+Document& Document::operator=(Document&& o) noexcept {
+    if (this == &o) return *this;
+    lines_ = std::move(o.lines_);
+    polylines_ = std::move(o.polylines_);
+    circles_ = std::move(o.circles_);
+    arcs_ = std::move(o.arcs_);
+    boxes_ = std::move(o.boxes_);
+    sparse_ = std::move(o.sparse_);
+    freeIndices_ = std::move(o.freeIndices_);
+    index_ = std::move(o.index_);
+    journal_ = std::move(o.journal_);
+    version_ = o.version_;
+    resyncBefore_ = o.resyncBefore_;
+
+    // 池跟着折线走；本文档原来的池（其中的折线已随旧列释放）交给源文档复用
+    std::swap(vertexPool_, o.vertexPool_);
+    o.resetMovedFrom_();
+    return *this;
+}
+
+void Document::resetMovedFrom_() {
+    lines_.clear();
+    polylines_.clear();
+    circles_.clear();
+    arcs_.clear();
+    boxes_.clear();
+    sparse_.clear();
+    freeIndices_.clear();
+    index_.clear();
+    journal_.clear();
+    vertexPool_->clear();
+    // 版本继续递增并且整体落后：在移动前同步过的游标拉取时全量重建
+    resyncBefore_ = ++version_;
+}
+
+// ============================================
+// 稀疏槽解析
+// ============================================
+
+const Document::SlotRef* Document::resolve_(EntityId id) const {
+    std::uint32_t index = entityIndex(id);
+    if (index >= sparse_.size()) return nullptr;
+    const SlotRef& ref = sparse_[index];
+    if (!ref.alive || ref.generation != entityGeneration(id)) return nullptr;
+    return &ref;
 }
-std::vector<Entity*> Document::all() {
-    std::vector<Entity*> out;
-    out.reserve(map_.size());
-    for (auto& kv : map_) out.push_back(&kv.second);
+Document::SlotRef* Document::resolve_(EntityId id) {
+    return const_cast<SlotRef*>(static_cast<const Document*>(this)->resolve_(id));
+}
+
+EntityId Document::allocId_() {
+    std::uint32_t index;
+    if (!freeIndices_.empty()) {
+        index = freeIndices_.back();
+        freeIndices_.pop_back();
+    } else {
+        index = std::uint32_t(sparse_.size());
+        sparse_.push_back(SlotRef{});
+    }
+    return makeEntityId(index, sparse_[index].generation);
+}
+
+void Document::insert_(std::uint32_t index, Entity&& e) {
+    SlotRef& ref = sparse_[index];
+    EntityId id = makeEntityId(index, ref.generation);
+    ref.type = EntityType(e.geom.index());
+    ref.alive = true;
+    withColumn_(ref.type, [&](auto& col) {
+        using G = typename std::decay_t<decltype(col.geom)>::value_type;
+        ref.slot = col.push(id, std::move(std::get<G>(e.geom)), e.style, e.visible);
+        if constexpr (std::is_same_v<G, Polyline>)
+            col.geom[ref.slot].pts.moveToPool(*vertexPool_);
+        ref.proxy = index_.insert(id, boundsOf(col.geom[ref.slot]));
+    });
+}
+
+void Document::erase_(SlotRef& ref) {
+    if (ref.proxy != SpatialIndex::kNull) {
+        index_.remove(ref.proxy);
+        ref.proxy = SpatialIndex::kNull;
+    }
+    withColumn_(ref.type, [&](auto& col) {
+        using G = typename std::decay_t<decltype(col.geom)>::value_type;
+        if constexpr (std::is_same_v<G, Polyline>)
+            col.geom[ref.slot].pts.releasePooled();
+        EntityId moved = col.swapRemove(ref.slot);
+        if (moved != 0) {
+            sparse_[entityIndex(moved)].slot = ref.slot;
+        }
+    });
+}
+
+void Document::setDirty_(const SlotRef& ref, bool dirty) {
+    withColumn_(ref.type, [&](auto& col) { col.dirty.set(ref.slot, dirty); });
+}
+
+// ============================================
+// 变更日志
+// ============================================
+
+// 日志最少保留条数；超过 max(下限, 2 × 实体数) 时裁掉较旧的一半
+static constexpr std::size_t kMinJournalCapacity = 1u << 16;
+
+// 两段点区间的并集（整体改动吸收一切，空区间不参与）
+static void mergePointRange(Change& c, std::uint32_t first, std::uint32_t count) {
+    if (c.wholeGeometry() || count == 0) return;
+    if (count == Change::kAllPoints || c.count == 0) {
+        c.first = first;
+        c.count = count;
+        return;
+    }
+    std::uint32_t end = std::max(c.first + c.count, first + count);
+    c.first = std::min(c.first, first);
+    c.count = end - c.first;
+}
+
+void Document::record_(ChangeKind kind, EntityId id, std::uint32_t first, std::uint32_t count) {
+    ++version_;
+
+    // 同一实体的连续修改（如拖拽画线、连续改色）合并为一条，只把它挪到最新版本；
+    // 改动的点区间取并集
+    if ((kind == ChangeKind::Modified || kind == ChangeKind::Restyled) && !journal_.empty()) {
+        Change& last = journal_.back();
+        if (last.id == id && last.kind == kind) {
+            last.version = version_;
+            mergePointRange(last, first, count);
+            return;
+        }
+    }
+
+    Change c{version_, kind, id};
+    if (kind == ChangeKind::Modified) {
+        c.first = first;
+        c.count = count;
+    }
+    journal_.push_back(c);
+
+    std::size_t capacity = std::max(kMinJournalCapacity, size() * 2);
+    if (journal_.size() > capacity) {
+        std::size_t drop = journal_.size() / 2;
+        journal_.erase(journal_.begin(), journal_.begin() + drop);
+        resyncBefore_ = journal_.front().version - 1;
+    }
+}
+
+// ============================================
+// 查询
+// ============================================
+
+std::optional<Entity> Document::get(EntityId id) const {
+    const SlotRef* ref = resolve_(id);
+    if (!ref) return std::nullopt;
+
+    Entity e;
+    e.id = id;
+    e.type = ref->type;
+    withColumn_(ref->type, [&](const auto& col) {
+        e.geom = col.geom[ref->slot];
+        e.style = col.styles[ref->slot];
+        e.visible = col.visible.test(ref->slot);
+        e.dirty = col.dirty.test(ref->slot);
+    });
+    return e;
+}
+
+bool Document::contains(EntityId id) const {
+    return resolve_(id) != nullptr;
+}
+
+std::size_t Document::size() const {
+    return lines_.size() + polylines_.size() + circles_.size() + arcs_.size() + boxes_.size();
+}
+
+std::optional<Aabb> Document::bounds(EntityId id) const {
+    const SlotRef* ref = resolve_(id);
+    if (!ref) return std::nullopt;
+    return index_.bounds(ref->proxy);
+}
+
+std::vector<std::pair<EntityId, float>> Document::nearest(const glm::vec3& p, std::size_t k, float maxDist) const {
+    std::vector<std::pair<EntityId, float>> out;
+    index_.nearest(p, k, maxDist, [&](EntityId id) {
+        float d = std::numeric_limits<float>::max();
+        visit(id, [&](const auto& g, const Style&, bool) { d = distanceTo(g, p); });
+        return d;
+    }, out);
     return out;
 }
 
+// ============================================
+// 修改
+// ============================================
+
+// 注意：e.id 会被忽略，ID 总是由 Document 分配
 EntityId Document::add(Entity e) {
-    if (e.id == 0) e.id = next_++;
-    e.dirty = true;  // 新实体标记为脏
-    map_[e.id] = std::move(e);
-    return e.id;
+    EntityId id = allocId_();
+    insert_(entityIndex(id), std::move(e));  // 新实体在列中默认标记为脏
+    record_(ChangeKind::Added, id);
+    return id;
 }
 
 bool Document::remove(EntityId id) {
-    return map_.erase(id) > 0;
+    SlotRef* ref = resolve_(id);
+    if (!ref) return false;
+    erase_(*ref);
+    ref->alive = false;
+    ref->generation++;  // 使旧 ID 失效
+    freeIndices_.push_back(entityIndex(id));
+    record_(ChangeKind::Removed, id);
+    return true;
 }
 
 void Document::clear() {
-    map_.clear();
-    next_ = 1;
+    lines_.clear();
+    polylines_.clear();
+    circles_.clear();
+    arcs_.clear();
+    boxes_.clear();
+    index_.clear();
+    // 池中折线不持有内存，清空列后整池一次释放
+    vertexPool_->clear();
+
+    // 保留稀疏槽并提升代数，避免清空前的 ID 误命中新实体
+    freeIndices_.clear();
+    freeIndices_.reserve(sparse_.size());
+    for (std::uint32_t i = std::uint32_t(sparse_.size()); i-- > 0;) {
+        if (sparse_[i].alive) {
+            sparse_[i].alive = false;
+            sparse_[i].generation++;
+        }
+        sparse_[i].proxy = SpatialIndex::kNull;
+        freeIndices_.push_back(i);
+    }
+
+    // Cleared 之前的记录已无意义，直接丢弃；落后的游标从 Cleared 开始消费即可
+    journal_.clear();
+    ++version_;
+    journal_.push_back(Change{version_, ChangeKind::Cleared, 0});
+}
+
+// 同类型几何中改动的点区间；点数或闭合变化时返回 false（整体改动）
+static bool changedPoints(const Line& a, const Line& b, std::uint32_t& first, std::uint32_t& count) {
+    bool d0 = a.p0 != b.p0, d1 = a.p1 != b.p1;
+    first = !d0 && d1 ? 1 : 0;
+    count = std::uint32_t(d0) + std::uint32_t(d1);
+    return true;
+}
+
+static bool changedPoints(const Polyline& a, const Polyline& b, std::uint32_t& first, std::uint32_t& count) {
+    if (a.pts.size() != b.pts.size() || a.closed != b.closed) return false;
+    // 分页存储只能顺序遍历：一遍记下第一个与最后一个不同的点
+    std::size_t i = 0, lo = 0, hi = 0;
+    bool any = false;
+    for (auto ia = a.pts.begin(), ib = b.pts.begin(); ia != a.pts.end(); ++ia, ++ib, ++i) {
+        if (*ia == *ib) continue;
+        if (!any) lo = i;
+        any = true;
+        hi = i + 1;
+    }
+    first = std::uint32_t(lo);
+    count = std::uint32_t(hi - lo);
+    return true;
 }
 
+template <class G>
+static bool changedPoints(const G&, const G&, std::uint32_t&, std::uint32_t&) { return false; }
+
 bool Document::update(EntityId id, const Entity& e) {
-    auto it = map_.find(id);
-    if (it == map_.end()) return false;
-    it->second = e;
-    it->second.id = id;  // 保持 ID 不变
-    it->second.dirty = true;
+    SlotRef* ref = resolve_(id);
+    if (!ref) return false;
+
+    std::uint32_t first = 0, count = Change::kAllPoints;
+    ChangeKind kind = ChangeKind::Modified;
+    EntityType newType = EntityType(e.geom.index());
+    if (newType == ref->type) {
+        // 同类型：原地覆盖（ID 保持不变）
+        withColumn_(ref->type, [&](auto& col) {
+            using G = typename std::decay_t<decltype(col.geom)>::value_type;
+            // 颜色、线宽与可见性由渲染器的属性表提供，与几何分开比较
+            const G& next = std::get<G>(e.geom);
+            if (changedPoints(col.geom[ref->slot], next, first, count)) {
+                // 点完全相同：只有样式 / 可见性可能变了
+                if (count == 0) kind = ChangeKind::Restyled;
+            } else {
+                first = 0;
+                count = Change::kAllPoints;
+            }
+            if constexpr (std::is_same_v<G, Polyline>) {
+                // 点数不变时原地覆写池中的区间
+                PointPages& pts = col.geom[ref->slot].pts;
+                if (pts.pooled() && next.pts.size() == pts.size() && next.pts.pageCount() <= 1) {
+                    if (!next.pts.empty()) pts.assign(next.pts.page(0).pts, next.pts.size());
+                    col.geom[ref->slot].closed = next.closed;
+                } else {
+                    pts.releasePooled();
+                    col.geom[ref->slot] = next;
+                    pts.moveToPool(*vertexPool_);
+                }
+            } else {
+                col.geom[ref->slot] = next;
+            }
+            col.styles[ref->slot] = e.style;
+            col.visible.set(ref->slot, e.visible);
+            col.dirty.set(ref->slot, true);
+            index_.move(ref->proxy, boundsOf(col.geom[ref->slot]));
+        });
+    } else {
+        // 类型改变：从旧列移到新列，ID 保持不变
+        erase_(*ref);
+        Entity copy = e;
+        insert_(entityIndex(id), std::move(copy));
+    }
+    record_(kind, id, first, count);
     return true;
 }
 
 void Document::markDirty(EntityId id) {
-    auto it = map_.find(id);
-    if (it != map_.end()) {
-        it->second.dirty = true;
+    if (const SlotRef* ref = resolve_(id)) {
+        setDirty_(*ref, true);
+        record_(ChangeKind::Modified, id);
     }
 }
 
 void Document::clearAllDirtyFlags() {
-    for (auto& kv : map_) {
-        kv.second.dirty = false;
-    }
+    lines_.dirty.clearAll();
+    polylines_.dirty.clearAll();
+    circles_.dirty.clearAll();
+    arcs_.dirty.clearAll();
+    boxes_.dirty.clearAll();
+}
+
+bool Document::setStyle(EntityId id, const Style& s) {
+    const SlotRef* ref = resolve_(id);
+    if (!ref) return false;
+    withColumn_(ref->type, [&](auto& col) { col.styles[ref->slot] = s; });
+    record_(ChangeKind::Restyled, id);
+    return true;
+}
+
+bool Document::setVisible(EntityId id, bool visible) {
+    const SlotRef* ref = resolve_(id);
+    if (!ref) return false;
+    withColumn_(ref->type, [&](auto& col) { col.visible.set(ref->slot, visible); });
+    record_(ChangeKind::Restyled, id);
+    return true;
 }
 
 bool Document::updateEndLinePoint(EntityId id, glm::vec3 linepos)
 {
-    bool flag = false;
-    auto it = map_.find(id);
-    if (it == map_.end()) {
-        return flag;
-    }
-    if(it->second.type == EntityType::Line) { // 保持 ID 不变
-        // ✅ 推荐：检查类型后修改
-        if (auto* line = std::get_if<Line>(&it->second.geom)) {
-            line->p1 = linepos;
-        }
-        it->second.dirty = true;
-        flag = true;
+    const SlotRef* ref = resolve_(id);
+    if (!ref || ref->type != EntityType::Line) {
+        return false;
     }
-    return flag;
+    lines_.geom[ref->slot].p1 = linepos;
+    lines_.dirty.set(ref->slot, true);
+    index_.move(ref->proxy, boundsOf(lines_.geom[ref->slot]));
+    record_(ChangeKind::Modified, id, 1, 1);
+    return true;
+}
+
+bool Document::updatePoints(EntityId id, std::uint32_t first, const glm::vec3* pts, std::uint32_t count)
+{
+    const SlotRef* ref = resolve_(id);
+    if (!ref || count == 0) {
+        return false;
+    }
+    if (ref->type == EntityType::Line) {
+        if (std::uint64_t(first) + count > 2) return false;
+        Line& L = lines_.geom[ref->slot];
+        for (std::uint32_t i = 0; i < count; ++i)
+            (first + i == 0 ? L.p0 : L.p1) = pts[i];
+        lines_.dirty.set(ref->slot, true);
+        index_.move(ref->proxy, boundsOf(L));
+    } else if (ref->type == EntityType::Polyline) {
+        Polyline& P = polylines_.geom[ref->slot];
+        if (std::uint64_t(first) + count > P.pts.size()) return false;
+        P.pts.write(first, pts, count);
+        polylines_.dirty.set(ref->slot, true);
+        index_.move(ref->proxy, boundsOf(P));
+    } else {
+        return false;
+    }
+    record_(ChangeKind::Modified, id, first, count);
+    return true;
+}
+
+bool Document::insertPoints(EntityId id, std::uint32_t pos, const glm::vec3* pts, std::uint32_t count)
+{
+    const SlotRef* ref = resolve_(id);
+    if (!ref || ref->type != EntityType::Polyline || count == 0) {
+        return false;
+    }
+    Polyline& P = polylines_.geom[ref->slot];
+    if (pos > P.pts.size()) return false;
+    P.pts.insert(pos, pts, count);
+    polylines_.dirty.set(ref->slot, true);
+    index_.move(ref->proxy, boundsOf(P));
+    record_(ChangeKind::Modified, id);
+    return true;
+}
+
+bool Document::erasePoints(EntityId id, std::uint32_t first, std::uint32_t count)
+{
+    const SlotRef* ref = resolve_(id);
+    if (!ref || ref->type != EntityType::Polyline || count == 0) {
+        return false;
+    }
+    Polyline& P = polylines_.geom[ref->slot];
+    if (std::uint64_t(first) + count > P.pts.size() || P.pts.size() - count < 2) return false;
+    P.pts.erase(first, count);
+    polylines_.dirty.set(ref->slot, true);
+    index_.move(ref->proxy, boundsOf(P));
+    record_(ChangeKind::Modified, id);
+    return true;
 }
 
 EntityId Document::addLine(const glm::vec3& a, const glm::vec3& b, const Style& s) {
@@ -88,13 +475,27 @@ EntityId Document::addLine(const glm::vec3& a, const glm::vec3& b, const Style&
 
 EntityId Document::addPolyline(const std::vector<glm::vec3>& pts, bool closed, const Style& s) {
     if (pts.size() < 2) return 0;  // 边界检查
+    // 点直接写进顶点池（短折线），不经过临时的分页存储
+    Polyline P;
+    P.closed = closed;
+    P.pts.moveToPool(*vertexPool_);
+    P.pts.assign(pts.data(), pts.size());
     Entity e;
     e.type = EntityType::Polyline;
     e.style = s;
-    e.geom = Polyline{pts, closed};
+    e.geom = std::move(P);
     return add(std::move(e));
 }
 
+void Document::compactVertices() {
+    std::vector<VertexPool::Span*> live;
+    live.reserve(polylines_.size());
+    for (Polyline& P : polylines_.geom) {
+        if (VertexPool::Span* span = P.pts.poolSpan()) live.push_back(span);
+    }
+    vertexPool_->compact(live);
+}
+
 EntityId Document::addCircle(const glm::vec3& c, float r, const Style& s) {
     if (r <= 0.0f) return 0;  // 边界检查
     Entity e;
@@ -116,10 +517,113 @@ EntityId Document::addArc(const glm::vec3& c, float r, float a0, float a1, const
 EntityId Document::addBox(const glm::vec3 &center, float size, const Style &s)
 {
     if (size <= 0.0f) return 0;  // 边界检查
-    
+
     Entity e;
     e.type = EntityType::Box;
     e.style = s;
     e.geom = Box{center, size};
     return add(std::move(e));
 }
+
+// ============================================
+// 包围盒与距离
+// ============================================
+
+static constexpr float kTwoPi = 6.28318530717958647692f;
+
+Aabb boundsOf(const Line& L) {
+    Aabb b;
+    b.expand(L.p0);
+    b.expand(L.p1);
+    return b;
+}
+
+// 各页缓存了包围盒，合并即可
+Aabb boundsOf(const Polyline& P) {
+    return P.pts.bounds();
+}
+
+Aabb boundsOf(const Circle& C) {
+    glm::vec3 r(C.r, C.r, 0.0f);
+    return Aabb(C.c - r, C.c + r);
+}
+
+// 张角归一化到 [0, 2pi]
+static float arcSpan(const Arc& A) {
+    float span = A.a1 - A.a0;
+    while (span < 0) span += kTwoPi;
+    while (span > kTwoPi) span -= kTwoPi;
+    return span;
+}
+
+static glm::vec3 arcPoint(const Arc& A, float t) {
+    return {A.c.x + A.r * std::cos(t), A.c.y + A.r * std::sin(t), A.c.z};
+}
+
+// 圆弧：两端点 + 张角内经过的坐标轴方向极值点
+Aabb boundsOf(const Arc& A) {
+    float span = arcSpan(A);
+    Aabb b;
+    b.expand(arcPoint(A, A.a0));
+    b.expand(arcPoint(A, A.a0 + span));
+    float start = A.a0 - kTwoPi * std::floor(A.a0 / kTwoPi);  // [0, 2pi)
+    for (int q = 0; q < 8; ++q) {
+        float axis = q * (kTwoPi / 4.0f);  // 覆盖两圈，处理跨 2pi 的情况
+        if (axis >= start && axis <= start + span) b.expand(arcPoint(A, axis));
+    }
+    return b;
+}
+
+Aabb boundsOf(const Box& B) {
+    float half = B.size * 0.5f;
+    if (B.rotation != glm::vec3(0.0f)) half *= 1.7320508f;  // 旋转后不超出外接球
+    return Aabb(B.center - glm::vec3(half), B.center + glm::vec3(half));
+}
+
+static float segmentDistance(const glm::vec3& a, const glm::vec3& b, const glm::vec3& p) {
+    glm::vec3 ab = b - a;
+    float len2 = glm::dot(ab, ab);
+    float t = len2 > 0.0f ? glm::clamp(glm::dot(p - a, ab) / len2, 0.0f, 1.0f) : 0.0f;
+    return glm::length(p - (a + ab * t));
+}
+
+float distanceTo(const Line& L, const glm::vec3& p) {
+    return segmentDistance(L.p0, L.p1, p);
+}
+
+// 逐页求最近线段：页包围盒比当前最近距离还远的页整页跳过，页间的连接线段单独计算
+float distanceTo(const Polyline& P, const glm::vec3& p) {
+    float best = std::numeric_limits<float>::max();
+    for (std::size_t k = 0; k < P.pts.pageCount(); ++k) {
+        PointPages::PageView pg = P.pts.page(k);
+        if (k > 0)
+            best = std::min(best, segmentDistance(P.pts.page(k - 1).back(), pg.front(), p));
+        if (pg.bounds.distanceTo(p) >= best) continue;
+        for (std::size_t i = 1; i < pg.count; ++i)
+            best = std::min(best, segmentDistance(pg.pts[i - 1], pg.pts[i], p));
+    }
+    if (P.closed && P.pts.size() > 2)
+        best = std::min(best, segmentDistance(P.pts.back(), P.pts.front(), p));
+    return best;
+}
+
+// 圆位于 z = c.z 平面：面内到圆周的距离与面外高度合成
+float distanceTo(const Circle& C, const glm::vec3& p) {
+    glm::vec2 d(p.x - C.c.x, p.y - C.c.y);
+    float radial = glm::length(d) - C.r;
+    float dz = p.z - C.c.z;
+    return std::sqrt(radial * radial + dz * dz);
+}
+
+float distanceTo(const Arc& A, const glm::vec3& p) {
+    float span = arcSpan(A);
+    float angle = std::atan2(p.y - A.c.y, p.x - A.c.x);
+    float rel = angle - A.a0;
+    rel -= kTwoPi * std::floor(rel / kTwoPi);  // [0, 2pi)
+    if (rel <= span) return distanceTo(Circle{A.c, A.r}, p);
+    return std::min(glm::length(p - arcPoint(A, A.a0)), glm::length(p - arcPoint(A, A.a0 + span)));
+}
+
+float distanceTo(const Box& B, const glm::vec3& p) {
+    return boundsOf(B).distanceTo(p);
+}
@@ -1,19 +1,37 @@
 #pragma once
 #include <cstdint>
-#include <unordered_map>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <variant>
 #include <glm/glm.hpp>
+#include "densebitset.h"
+#include "pointpages.h"
+#include "spatialindex.h"
+#include "vertexpool.h"
 
 using EntityId = std::uint64_t;
 
+// ============================================
+// 实体 ID 编码
+// 低 32 位：稀疏槽索引；高 32 位：代数（generation，从 1 开始）
+// 槽被回收后代数递增，旧 ID 自动失效；ID 0 始终无效
+// ============================================
+inline std::uint32_t entityIndex(EntityId id) { return std::uint32_t(id & 0xFFFFFFFFull); }
+inline std::uint32_t entityGeneration(EntityId id) { return std::uint32_t(id >> 32); }
+inline EntityId makeEntityId(std::uint32_t index, std::uint32_t generation)
+{
+    return (EntityId(generation) << 32) | EntityId(index);
+}
+
+// 注意：顺序与 Entity::geom 的 variant 下标一致
 enum class EntityType { Line, Polyline, Circle, Arc, Box };
 
 struct Style {
     std::uint32_t rgba = 0xFFFFFFFF; // RGBA 格式: 0xRRGGBBAA
     float lineWidth = 1.0f;          // v0.1 仅参考
     // TODO: layerId, linetype, etc.
-    
+
     // 便捷构造
     static Style fromRGBA(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
         return Style{(uint32_t(r) << 24) | (uint32_t(g) << 16) | (uint32_t(b) << 8) | a};
@@ -21,7 +39,9 @@ struct Style {
 };
 
 struct Line      { glm::vec3 p0, p1; };
-struct Polyline  { std::vector<glm::vec3> pts; bool closed = false; };
+// 折线的点分页存储（见 PointPages）：中间插入 / 删除不搬动整条折线，渲染器只重新上传改动的页。
+// 文档中不超过 PointPages::kMaxPagePoints 个点的折线放在 Document 的顶点池里（池模式）
+struct Polyline  { PointPages pts; bool closed = false; };
 struct Circle    { glm::vec3 c; float r; };
 struct Arc       { glm::vec3 c; float r; float a0, a1; /* 弧度 */ };
 // ✅ 新增：立方体实体（正六面体）
@@ -32,7 +52,22 @@ struct Box {
     glm::vec3 rotation = glm::vec3(0.0f);  // 欧拉角
 };
 
+// 各几何类型的包围盒（Box 带旋转时取外接球的包围盒）
+Aabb boundsOf(const Line& L);
+Aabb boundsOf(const Polyline& P);
+Aabb boundsOf(const Circle& C);
+Aabb boundsOf(const Arc& A);
+Aabb boundsOf(const Box& B);
 
+// 点到几何的精确距离（Box 取到包围盒的距离）
+float distanceTo(const Line& L, const glm::vec3& p);
+float distanceTo(const Polyline& P, const glm::vec3& p);
+float distanceTo(const Circle& C, const glm::vec3& p);
+float distanceTo(const Arc& A, const glm::vec3& p);
+float distanceTo(const Box& B, const glm::vec3& p);
+
+// 实体的值类型表示：用于 add / update / get 交换数据
+// Document 内部并不以 Entity 形式存储（见 EntityColumn）
 struct Entity {
     EntityId id{};
     EntityType type{};
@@ -42,26 +77,222 @@ struct Entity {
     bool dirty = true;  // 标记是否需要重新上传到 GPU
 };
 
+// ============================================
+// EntityColumn - 单一几何类型的列式（SoA）存储
+// 同一下标（slot）在各列中描述同一个实体；删除采用 swap-and-pop，保持稠密
+// ============================================
+template <class G>
+struct EntityColumn {
+    std::vector<G>        geom;
+    std::vector<EntityId> ids;
+    std::vector<Style>    styles;
+    DenseBitset           visible;
+    DenseBitset           dirty;
+
+    std::size_t size() const { return ids.size(); }
+    bool empty() const { return ids.empty(); }
+
+    std::uint32_t push(EntityId id, G g, const Style &s, bool vis)
+    {
+        geom.push_back(std::move(g));
+        ids.push_back(id);
+        styles.push_back(s);
+        visible.pushBack(vis);
+        dirty.pushBack(true);
+        return std::uint32_t(ids.size() - 1);
+    }
+
+    // 删除 slot，末尾实体搬入空位；返回被搬动实体的 ID（无搬动时返回 0）
+    EntityId swapRemove(std::uint32_t slot)
+    {
+        std::uint32_t last = std::uint32_t(ids.size() - 1);
+        EntityId moved = 0;
+        if (slot != last)
+        {
+            geom[slot] = std::move(geom[last]);
+            ids[slot] = ids[last];
+            styles[slot] = styles[last];
+            visible.set(slot, visible.test(last));
+            dirty.set(slot, dirty.test(last));
+            moved = ids[slot];
+        }
+        geom.pop_back();
+        ids.pop_back();
+        styles.pop_back();
+        visible.popBack();
+        dirty.popBack();
+        return moved;
+    }
+
+    void clear()
+    {
+        geom.clear();
+        ids.clear();
+        styles.clear();
+        visible.reset();
+        dirty.reset();
+    }
+};
+
+// ============================================
+// 变更日志
+// Document 的每次修改都会以单调递增的版本号记录一条变更；
+// 各消费者（Renderer、空间索引、统计面板……）各自持有 ChangeCursor，
+// 只拉取上次同步之后的增量
+// ============================================
+// Restyled：只有样式或可见性变化，几何不变（渲染器只需更新属性表）
+enum class ChangeKind : std::uint8_t { Added, Modified, Removed, Cleared, Restyled };
+
+struct Change {
+    static constexpr std::uint32_t kAllPoints = 0xFFFFFFFFu;
+
+    std::uint64_t version = 0;
+    ChangeKind kind = ChangeKind::Modified;
+    EntityId id = 0;  // Cleared 时为 0
+    // Modified：几何中改动的点区间 [first, first + count)（Line 为 p0 / p1，Polyline 为 pts 下标），
+    // 点数与闭合都没变时才是部分区间；count == kAllPoints 表示整体改动，count == 0 表示几何未变
+    std::uint32_t first = 0;
+    std::uint32_t count = kAllPoints;
+
+    bool wholeGeometry() const { return count == kAllPoints; }
+};
+
+struct ChangeCursor {
+    std::uint64_t version = 0;  // 已消费到的版本
+};
+
 class Document {
 public:
-    const Entity* get(EntityId id) const;
-    Entity*       get(EntityId id);
+    Document();
+    ~Document();
+    // 拷贝：顶点池整块拷贝，池中的折线只重新指向新池，不逐条分配
+    Document(const Document& o);
+    Document& operator=(const Document& o);
+    // 移动：顶点池随 unique_ptr 整体转移，池中折线的池指针仍然有效；
+    // 源文档留下一个空池与空的列 / 日志，可以继续使用（旧游标在它上面全量重建）
+    Document(Document&& o);
+    Document& operator=(Document&& o) noexcept;
+
+    // 按 ID 取出实体的一份拷贝（ID 失效时返回空）
+    std::optional<Entity> get(EntityId id) const;
+    bool contains(EntityId id) const;
+    std::size_t size() const;
+
+    // ============================================
+    // 遍历（不分配内存）
+    // ============================================
+
+    // 按类型直接访问列存储，适合紧凑循环
+    const EntityColumn<Line>&     lines()     const { return lines_; }
+    const EntityColumn<Polyline>& polylines() const { return polylines_; }
+    const EntityColumn<Circle>&   circles()   const { return circles_; }
+    const EntityColumn<Arc>&      arcs()      const { return arcs_; }
+    const EntityColumn<Box>&      boxes()     const { return boxes_; }
+
+    template <class G> const EntityColumn<G>& column() const;
+
+    // 访问所有实体：f(EntityId id, const G& geom, const Style& style, bool visible)
+    // G 为具体几何类型，调用方可用泛型 lambda + if constexpr 分派
+    template <class F>
+    void forEach(F &&f) const
+    {
+        forEachIn_(lines_, f);
+        forEachIn_(polylines_, f);
+        forEachIn_(circles_, f);
+        forEachIn_(arcs_, f);
+        forEachIn_(boxes_, f);
+    }
+
+    // 按 ID 访问单个实体（不拷贝）：f(const G& geom, const Style& style, bool visible)
+    // ID 失效时返回 false
+    template <class F>
+    bool visit(EntityId id, F &&f) const
+    {
+        const SlotRef* ref = resolve_(id);
+        if (!ref) return false;
+        withColumn_(ref->type, [&](const auto& col) {
+            f(col.geom[ref->slot], col.styles[ref->slot], col.visible.test(ref->slot));
+        });
+        return true;
+    }
+
+    // ============================================
+    // 空间查询（动态包围盒树，随增删改增量维护）
+    // ============================================
+
+    const SpatialIndex& spatialIndex() const { return index_; }
+    std::optional<Aabb> bounds(EntityId id) const;
 
-    std::vector<const Entity*> all() const;  // 只读遍历
-    std::vector<Entity*>       all();        // 可写遍历
+    // 包围盒与 box 相交的实体：f(EntityId id, const Aabb& bounds)
+    template <class F>
+    void queryBox(const Aabb &box, F &&f) const { index_.query(box, f); }
+
+    // 包围盒被射线穿过的实体：f(EntityId id, float tEnter)
+    template <class F>
+    void queryRay(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, F &&f) const
+    {
+        index_.raycast(origin, dir, maxT, f);
+    }
+
+    // 距 p 最近的 k 个实体（按到几何的精确距离升序），超过 maxDist 的不返回
+    std::vector<std::pair<EntityId, float>> nearest(const glm::vec3& p, std::size_t k,
+                                                    float maxDist = std::numeric_limits<float>::max()) const;
+
+    // ============================================
+    // 变更日志
+    // ============================================
+
+    // 当前版本（每条变更 +1）
+    std::uint64_t version() const { return version_; }
+
+    // 拉取 cursor 之后的所有变更并推进 cursor：f(const Change&)
+    // 若 cursor 过旧（所需记录已被裁剪），不回调并返回 false，调用方应全量重建
+    template <class F>
+    bool pullChanges(ChangeCursor& cursor, F &&f) const
+    {
+        if (cursor.version >= version_) return true;
+        if (cursor.version < resyncBefore_) {
+            cursor.version = version_;
+            return false;
+        }
+        // 日志按版本有序，二分定位第一条未消费的变更
+        std::size_t lo = 0, hi = journal_.size();
+        while (lo < hi) {
+            std::size_t mid = (lo + hi) / 2;
+            if (journal_[mid].version <= cursor.version) lo = mid + 1;
+            else hi = mid;
+        }
+        for (std::size_t i = lo; i < journal_.size(); ++i) f(journal_[i]);
+        cursor.version = version_;
+        return true;
+    }
 
     EntityId add(Entity e);
     bool     remove(EntityId id);
     void     clear();
-    
-    // 更新实体（标记为 dirty）
+
+    // 更新实体（标记为 dirty）。同类型的 Line / Polyline 点数与闭合都不变时，
+    // 变更日志只记录实际改动的点区间；点完全相同时记录为 Restyled
     bool update(EntityId id, const Entity& e);
     void markDirty(EntityId id);
     void clearAllDirtyFlags();
 
+    // 只改样式 / 可见性：记录为 Restyled，不触发几何重新上传
+    bool setStyle(EntityId id, const Style& s);
+    bool setVisible(EntityId id, bool visible);
+
     // 更新实体信息
     bool updateEndLinePoint(EntityId id, glm::vec3 linepos);
 
+    // 原地改写 Line / Polyline 从 first 开始的 count 个点（Line 的点为 p0、p1），点数不变；
+    // 变更日志只记录这段区间，渲染器据此只改写对应的顶点。越界或类型不符时返回 false
+    bool updatePoints(EntityId id, std::uint32_t first, const glm::vec3* pts, std::uint32_t count);
+
+    // 在折线的 pos 之前插入 count 个点 / 删除 [first, first + count) 的点（删除后至少保留 2 个点）。
+    // 只触及所在的页，变更按整体改动记录，渲染器按页戳记只重新上传变化的页
+    bool insertPoints(EntityId id, std::uint32_t pos, const glm::vec3* pts, std::uint32_t count);
+    bool erasePoints(EntityId id, std::uint32_t first, std::uint32_t count);
+
     // 便捷构造（可选）
     EntityId addLine(const glm::vec3& a, const glm::vec3& b, const Style& s = {});
     EntityId addPolyline(const std::vector<glm::vec3>& pts, bool closed, const Style& s = {});
@@ -69,7 +300,89 @@ public:
     EntityId addArc(const glm::vec3& c, float r, float a0, float a1, const Style& s = {});
     EntityId addBox(const glm::vec3& center, float size, const Style& s = {});
 
+    // ============================================
+    // 折线顶点池
+    // ============================================
+
+    // 批量导入前预留顶点池容量，避免反复扩容
+    void reserveVertices(std::size_t vertices) { vertexPool_->reserve(vertices); }
+    // 整理顶点池：删除 / 改点数留下的空洞全部挤掉（不改变任何折线的内容与页戳记）
+    void compactVertices();
+    const VertexPool& vertexPool() const { return *vertexPool_; }
+
 private:
-    std::unordered_map<EntityId, Entity> map_;
-    EntityId next_ = 1;
-};
\ No newline at end of file
+    // 稀疏槽：ID 索引 → (类型, 列内下标)
+    struct SlotRef {
+        std::uint32_t generation = 1;
+        std::uint32_t slot = 0;
+        std::int32_t proxy = SpatialIndex::kNull;  // 空间索引中的叶子
+        EntityType type = EntityType::Line;
+        bool alive = false;
+    };
+
+    const SlotRef* resolve_(EntityId id) const;
+    SlotRef*       resolve_(EntityId id);
+
+    EntityId allocId_();
+    void     insert_(std::uint32_t index, Entity&& e);   // 放入对应类型的列
+    void     erase_(SlotRef& ref);                       // 从列中移除（swap-and-pop）
+    void     setDirty_(const SlotRef& ref, bool dirty);
+    void     resetMovedFrom_();                          // 移动后清空源文档（池保留，内容清空）
+
+    // 按类型分派到对应的列：f(EntityColumn<G>&)
+    template <class F> void withColumn_(EntityType type, F&& f);
+    template <class F> void withColumn_(EntityType type, F&& f) const;
+
+    void record_(ChangeKind kind, EntityId id,
+                 std::uint32_t first = 0, std::uint32_t count = Change::kAllPoints);
+
+    template <class G, class F>
+    static void forEachIn_(const EntityColumn<G>& col, F& f)
+    {
+        for (std::size_t i = 0; i < col.size(); ++i)
+            f(col.ids[i], col.geom[i], col.styles[i], col.visible.test(i));
+    }
+
+    EntityColumn<Line>     lines_;
+    EntityColumn<Polyline> polylines_;
+    EntityColumn<Circle>   circles_;
+    EntityColumn<Arc>      arcs_;
+    EntityColumn<Box>      boxes_;
+
+    std::vector<SlotRef>       sparse_;
+    std::vector<std::uint32_t> freeIndices_;
+
+    SpatialIndex index_;
+
+    // 地址固定（unique_ptr）：池中折线保存的是池的指针
+    std::unique_ptr<VertexPool> vertexPool_;
+
+    std::vector<Change> journal_;
+    std::uint64_t version_ = 0;
+    std::uint64_t resyncBefore_ = 0;  // 早于该版本的游标需要全量重建
+};
+
+template <> inline const EntityColumn<Line>&     Document::column<Line>()     const { return lines_; }
+template <> inline const EntityColumn<Polyline>& Document::column<Polyline>() const { return polylines_; }
+template <> inline const EntityColumn<Circle>&   Document::column<Circle>()   const { return circles_; }
+template <> inline const EntityColumn<Arc>&      Document::column<Arc>()      const { return arcs_; }
+template <> inline const EntityColumn<Box>&      Document::column<Box>()      const { return boxes_; }
+
+template <class F>
+inline void Document::withColumn_(EntityType type, F &&f)
+{
+    switch (type)
+    {
+    case EntityType::Line:     f(lines_);     break;
+    case EntityType::Polyline: f(polylines_); break;
+    case EntityType::Circle:   f(circles_);   break;
+    case EntityType::Arc:      f(arcs_);      break;
+    case EntityType::Box:      f(boxes_);     break;
+    }
+}
+
+template <class F>
+inline void Document::withColumn_(EntityType type, F &&f) const
+{
+    const_cast<Document *>(this)->withColumn_(type, [&](const auto &col) { f(col); });
+}
@@ -0,0 +1,1161 @@
+#include "gpuheap.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <QOpenGLContext>
+
+// ============================================
+// RangeAllocator
+// ============================================
+
+RangeAllocator::RangeAllocator(std::uint32_t capacity)
+    : capacity_(capacity)
+{
+    reset();
+}
+
+void RangeAllocator::reset()
+{
+    used_ = 0;
+    freeByOffset_.clear();
+    freeBySize_.clear();
+    if (capacity_ > 0)
+        insertFree_(0, capacity_);
+}
+
+void RangeAllocator::insertFree_(std::uint32_t offset, std::uint32_t count)
+{
+    freeByOffset_.emplace(offset, count);
+    freeBySize_.emplace(count, offset);
+}
+
+void RangeAllocator::eraseFree_(std::map<std::uint32_t, std::uint32_t>::iterator it)
+{
+    auto range = freeBySize_.equal_range(it->second);
+    for (auto s = range.first; s != range.second; ++s)
+    {
+        if (s->second == it->first)
+        {
+            freeBySize_.erase(s);
+            break;
+        }
+    }
+    freeByOffset_.erase(it);
+}
+
+bool RangeAllocator::allocate(std::uint32_t count, std::uint32_t &outOffset)
+{
+    return allocateBelow(count, capacity_, outOffset);
+}
+
+bool RangeAllocator::allocateBelow(std::uint32_t count, std::uint32_t limit, std::uint32_t &outOffset)
+{
+    if (count == 0)
+        return false;
+
+    // best-fit：从恰好够用的最小空闲块开始找，跳过越界的块
+    for (auto s = freeBySize_.lower_bound(count); s != freeBySize_.end(); ++s)
+    {
+        std::uint32_t offset = s->second;
+        if (offset + count > limit)
+            continue;
+
+        std::uint32_t size = s->first;
+        eraseFree_(freeByOffset_.find(offset));
+        if (size > count)
+            insertFree_(offset + count, size - count);
+
+        used_ += count;
+        outOffset = offset;
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(std::uint32_t offset, std::uint32_t count)
+{
+    if (count == 0)
+        return;
+    used_ -= count;
+
+    // 与后继空闲块合并
+    auto next = freeByOffset_.lower_bound(offset);
+    if (next != freeByOffset_.end() && offset + count == next->first)
+    {
+        count += next->second;
+        eraseFree_(next);
+    }
+    // 与前驱空闲块合并
+    auto prev = freeByOffset_.lower_bound(offset);
+    if (prev != freeByOffset_.begin())
+    {
+        --prev;
+        if (prev->first + prev->second == offset)
+        {
+            offset = prev->first;
+            count += prev->second;
+            eraseFree_(prev);
+        }
+    }
+    insertFree_(offset, count);
+}
+
+std::uint32_t RangeAllocator::highWater() const
+{
+    if (freeByOffset_.empty())
+        return capacity_;
+    auto last = std::prev(freeByOffset_.end());
+    return last->first + last->second == capacity_ ? last->first : capacity_;
+}
+
+// ============================================
+// GpuBufferHeap
+// ============================================
+
+void GpuBufferHeap::initialize(GLenum drawMode, bool indexed,
+                               std::uint32_t arenaVertices, std::uint32_t arenaIndices)
+{
+    initializeOpenGLFunctions();
+    drawMode_ = drawMode;
+    indexed_ = indexed;
+    arenaVertices_ = arenaVertices;
+    arenaIndices_ = indexed ? arenaIndices : 0;
+}
+
+void GpuBufferHeap::shutdown()
+{
+    vertexRun_ = {};
+    keyRun_ = {};
+    batching_ = false;
+    for (Arena &a : arenas_)
+    {
+        if (a.ibo)
+            glDeleteBuffers(1, &a.ibo);
+        if (a.vbo)
+            glDeleteBuffers(1, &a.vbo);
+        if (a.idVbo)
+            glDeleteBuffers(1, &a.idVbo);
+        if (a.vao)
+            glDeleteVertexArrays(1, &a.vao);
+        if (a.segVao)
+            glDeleteVertexArrays(1, &a.segVao);
+    }
+    arenas_.clear();
+    if (gatherVbo_)
+        glDeleteBuffers(1, &gatherVbo_);
+    if (gatherIdVbo_)
+        glDeleteBuffers(1, &gatherIdVbo_);
+    if (gatherVao_)
+        glDeleteVertexArrays(1, &gatherVao_);
+    gatherVbo_ = gatherIdVbo_ = gatherVao_ = 0;
+    gatherCapacity_ = 0;
+    records_.clear();
+    freeHandles_.clear();
+    pickScratch_.clear();
+    pickScratch_.shrink_to_fit();
+}
+
+void GpuBufferHeap::clear()
+{
+    // 只清空分配状态，保留 GL 缓冲与容量；未提交的写入属于已清空的分配，直接丢弃
+    vertexRun_.data.clear();
+    keyRun_.data.clear();
+    for (Arena &a : arenas_)
+    {
+        a.vertices.reset();
+        a.indices.reset();
+        a.liveByOffset.clear();
+        a.firsts.clear();
+        a.counts.clear();
+        a.indexOffsets.clear();
+        a.baseVertices.clear();
+        a.drawHandles.clear();
+    }
+    records_.clear();
+    freeHandles_.clear();
+}
+
+std::uint16_t GpuBufferHeap::createArena_(std::uint32_t minVertices, std::uint32_t minIndices)
+{
+    Arena a;
+    // 超过默认容量的大实体单独开一个刚好够用的 arena
+    a.vertices = RangeAllocator(std::max(arenaVertices_, minVertices));
+    a.indices = RangeAllocator(indexed_ ? std::max(arenaIndices_, minIndices) : 0);
+
+    if (deferred_ && !indexed_)
+    {
+        // 只建 CPU 镜像，GL 缓冲由上传线程创建
+        a.staged.assign(a.vertices.capacity(), BatchVertex{glm::vec3(0.0f), 0u});
+        a.stagedKeys.assign(a.vertices.capacity(), 0u);
+        arenas_.push_back(std::move(a));
+        return std::uint16_t(arenas_.size() - 1);
+    }
+
+    glGenBuffers(1, &a.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, a.vbo);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(a.vertices.capacity()) * GLsizeiptr(sizeof(BatchVertex)),
+                 nullptr, GL_DYNAMIC_DRAW);
+
+    // 拾取键单独一个缓冲：普通绘制不读取，不增加主缓冲的带宽
+    glGenBuffers(1, &a.idVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, a.idVbo);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(a.vertices.capacity()) * GLsizeiptr(sizeof(std::uint32_t)),
+                 nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (indexed_)
+    {
+        glGenBuffers(1, &a.ibo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, a.ibo);
+        glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(a.indices.capacity()) * GLsizeiptr(sizeof(GLuint)),
+                     nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    setupArenaVaos_(a);
+    arenas_.push_back(std::move(a));
+    return std::uint16_t(arenas_.size() - 1);
+}
+
+void GpuBufferHeap::setupArenaVaos_(Arena &a)
+{
+    glGenVertexArrays(1, &a.vao);
+    glBindVertexArray(a.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, a.vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void *)offsetof(BatchVertex, pos));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BatchVertex), (void *)offsetof(BatchVertex, rgba));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, a.idVbo);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(std::uint32_t), (void *)0);
+    glEnableVertexAttribArray(2);
+    if (indexed_)
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, a.ibo);  // 记录在 VAO 中
+    glBindVertexArray(0);
+
+    if (!indexed_)
+    {
+        glGenVertexArrays(1, &a.segVao);
+        glBindVertexArray(a.segVao);
+        pointSegments_(a.vbo, a.idVbo, 0);
+        for (GLuint loc = 0; loc < 5; ++loc)
+        {
+            glEnableVertexAttribArray(loc);
+            glVertexAttribDivisor(loc, 1);
+        }
+        glBindVertexArray(0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GpuBufferHeap::pointSegments_(GLuint vbo, GLuint idVbo, std::uint32_t firstVertex)
+{
+    // 宽线的实例属性：GL_LINES 步长为两个顶点，折线步长为一个顶点；终点即下一个顶点
+    GLsizei pairs = drawMode_ == GL_LINES ? 2 : 1;
+    GLsizei stride = pairs * GLsizei(sizeof(BatchVertex));
+    GLsizei idStride = pairs * GLsizei(sizeof(std::uint32_t));
+    std::uintptr_t base = std::uintptr_t(firstVertex) * sizeof(BatchVertex);
+    std::uintptr_t idBase = std::uintptr_t(firstVertex) * sizeof(std::uint32_t);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(BatchVertex, pos)));
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)(base + offsetof(BatchVertex, rgba)));
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(base + sizeof(BatchVertex) + offsetof(BatchVertex, pos)));
+    glBindBuffer(GL_ARRAY_BUFFER, idVbo);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, idStride, (void *)idBase);
+    glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, idStride, (void *)(idBase + sizeof(std::uint32_t)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool GpuBufferHeap::place_(Record &r, std::uint16_t arena, std::uint32_t vtxCount, std::uint32_t idxCount)
+{
+    Arena &a = arenas_[arena];
+    std::uint32_t vtxOffset = 0, idxOffset = 0;
+    if (!a.vertices.allocate(vtxCount, vtxOffset))
+        return false;
+    if (indexed_ && !a.indices.allocate(idxCount, idxOffset))
+    {
+        a.vertices.free(vtxOffset, vtxCount);
+        return false;
+    }
+    r.arena = arena;
+    r.vtxOffset = vtxOffset;
+    r.vtxCount = vtxCount;
+    r.idxOffset = idxOffset;
+    r.idxCount = indexed_ ? idxCount : 0;
+    return true;
+}
+
+GpuBufferHeap::Handle GpuBufferHeap::allocate(std::uint32_t vertexCount, std::uint32_t indexCount)
+{
+    if (vertexCount == 0 || (indexed_ && indexCount == 0))
+        return kInvalid;
+
+    Record r;
+    bool placed = false;
+    for (std::size_t i = 0; i < arenas_.size() && !placed; ++i)
+        placed = place_(r, std::uint16_t(i), vertexCount, indexCount);
+    if (!placed && !place_(r, createArena_(vertexCount, indexCount), vertexCount, indexCount))
+        return kInvalid;
+    r.alive = true;
+
+    Handle h;
+    if (!freeHandles_.empty())
+    {
+        h = freeHandles_.back();
+        freeHandles_.pop_back();
+        records_[h] = r;
+    }
+    else
+    {
+        h = Handle(records_.size());
+        records_.push_back(r);
+    }
+
+    arenas_[r.arena].liveByOffset.emplace(r.vtxOffset, h);
+    addDraw_(h);
+    return h;
+}
+
+void GpuBufferHeap::release(Handle h)
+{
+    if (h >= records_.size() || !records_[h].alive)
+        return;
+
+    Record &r = records_[h];
+    Arena &a = arenas_[r.arena];
+    removeDraw_(h);
+    a.liveByOffset.erase(r.vtxOffset);
+    zeroFill_(a, r.vtxOffset, r.vtxCount);
+    a.vertices.free(r.vtxOffset, r.vtxCount);
+    if (indexed_)
+        a.indices.free(r.idxOffset, r.idxCount);
+
+    r.alive = false;
+    freeHandles_.push_back(h);
+}
+
+// ============================================
+// 多重绘制参数
+// ============================================
+
+void GpuBufferHeap::addDraw_(Handle h)
+{
+    // GL_LINES 整段绘制，不需要逐分配的参数
+    if (drawMode_ == GL_LINES && !indexed_)
+        return;
+
+    Record &r = records_[h];
+    Arena &a = arenas_[r.arena];
+    r.drawSlot = std::uint32_t(a.drawHandles.size());
+    a.drawHandles.push_back(h);
+    if (indexed_)
+    {
+        a.counts.push_back(GLsizei(r.idxCount));
+        a.indexOffsets.push_back((void *)(std::uintptr_t(r.idxOffset) * sizeof(GLuint)));
+        a.baseVertices.push_back(GLint(r.vtxOffset));
+    }
+    else
+    {
+        a.firsts.push_back(GLint(r.vtxOffset));
+        a.counts.push_back(GLsizei(r.vtxCount));
+    }
+}
+
+void GpuBufferHeap::removeDraw_(Handle h)
+{
+    if (drawMode_ == GL_LINES && !indexed_)
+        return;
+
+    Record &r = records_[h];
+    Arena &a = arenas_[r.arena];
+    std::uint32_t slot = r.drawSlot;
+    std::uint32_t last = std::uint32_t(a.drawHandles.size() - 1);
+    if (slot != last)
+    {
+        // swap-remove：末项搬入空位
+        Handle moved = a.drawHandles[last];
+        a.drawHandles[slot] = moved;
+        a.counts[slot] = a.counts[last];
+        if (indexed_)
+        {
+            a.indexOffsets[slot] = a.indexOffsets[last];
+            a.baseVertices[slot] = a.baseVertices[last];
+        }
+        else
+        {
+            a.firsts[slot] = a.firsts[last];
+        }
+        records_[moved].drawSlot = slot;
+    }
+    a.drawHandles.pop_back();
+    a.counts.pop_back();
+    if (indexed_)
+    {
+        a.indexOffsets.pop_back();
+        a.baseVertices.pop_back();
+    }
+    else
+    {
+        a.firsts.pop_back();
+    }
+}
+
+// ============================================
+// 写入
+// ============================================
+
+void GpuBufferHeap::zeroFill_(Arena &a, std::uint32_t offset, std::uint32_t count)
+{
+    // 整段绘制需要：零顶点构成零长度、全透明的线段，不产生像素。
+    // 拾取键也清零，宽线着色器据此跳过空闲区（折线堆同样整段实例化绘制）
+    if (indexed_)
+        return;
+    if (!a.vbo)
+    {
+        if (!a.staged.empty())
+        {
+            std::fill_n(a.staged.begin() + offset, count, BatchVertex{glm::vec3(0.0f), 0u});
+            std::fill_n(a.stagedKeys.begin() + offset, count, 0u);
+        }
+        return;
+    }
+    // 被释放的区间可能还在待提交的写入里，先提交，填零才不会被覆盖
+    flushWrites_();
+    static_assert(sizeof(BatchVertex) % sizeof(std::uint32_t) == 0, "BatchVertex must be a whole number of words");
+    fill_(a.vbo, GLintptr(offset) * GLintptr(sizeof(BatchVertex)), 0u,
+          GLsizeiptr(count) * GLsizeiptr(sizeof(BatchVertex) / sizeof(std::uint32_t)));
+    fill_(a.idVbo, GLintptr(offset) * GLintptr(sizeof(std::uint32_t)), 0u, GLsizeiptr(count));
+    counters_.bytesUploaded += std::uint64_t(count) * (sizeof(BatchVertex) + sizeof(std::uint32_t));
+}
+
+void GpuBufferHeap::put_(GLuint buffer, GLintptr offset, const void *data, GLsizeiptr bytes)
+{
+    if (staging_)
+    {
+        staging_->upload(buffer, offset, data, bytes);
+        return;
+    }
+    // 用 COPY_WRITE 目标写入，不扰动当前绑定的 VAO / ARRAY_BUFFER
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GpuBufferHeap::fill_(GLuint buffer, GLintptr offset, std::uint32_t value, GLsizeiptr count)
+{
+    // 暂存环直接在映射内存里填值；没有暂存环时借 pickScratch_ 组一块再写
+    if (staging_)
+    {
+        staging_->fill(buffer, offset, value, count);
+        return;
+    }
+    pickScratch_.assign(std::size_t(count), value);
+    put_(buffer, offset, pickScratch_.data(), count * GLsizeiptr(sizeof(std::uint32_t)));
+}
+
+void GpuBufferHeap::writeVertices(Handle h, const BatchVertex *v, std::uint32_t count, std::uint32_t offset)
+{
+    const Record &r = records_[h];
+    if (count == 0 || offset + count > r.vtxCount)
+        return;
+
+    Arena &a = arenas_[r.arena];
+    GLuint vbo = a.vbo;
+    std::uint32_t first = r.vtxOffset + offset;
+    counters_.bytesUploaded += std::uint64_t(count) * sizeof(BatchVertex);
+    if (!vbo)
+    {
+        if (!a.staged.empty())
+            std::copy(v, v + count, a.staged.begin() + first);
+        return;
+    }
+    if (batching_)
+    {
+        if (!vertexRun_.continues(vbo, first))
+        {
+            submitRun_(vertexRun_);
+            vertexRun_.buffer = vbo;
+            vertexRun_.begin = first;
+        }
+        vertexRun_.data.insert(vertexRun_.data.end(), v, v + count);
+        return;
+    }
+
+    put_(vbo, GLintptr(first) * GLintptr(sizeof(BatchVertex)),
+         v, GLsizeiptr(count) * GLsizeiptr(sizeof(BatchVertex)));
+}
+
+void GpuBufferHeap::writeIndices(Handle h, const GLuint *idx, std::uint32_t count, std::uint32_t offset)
+{
+    const Record &r = records_[h];
+    if (!indexed_ || count == 0 || offset + count > r.idxCount)
+        return;
+
+    // 索引相对于分配的首顶点，绘制时由 basevertex 平移
+    put_(arenas_[r.arena].ibo, GLintptr(r.idxOffset + offset) * GLintptr(sizeof(GLuint)),
+         idx, GLsizeiptr(count) * GLsizeiptr(sizeof(GLuint)));
+    counters_.bytesUploaded += std::uint64_t(count) * sizeof(GLuint);
+}
+
+void GpuBufferHeap::writePickId(Handle h, std::uint32_t key, std::uint32_t offset, std::uint32_t count)
+{
+    const Record &r = records_[h];
+    if (offset >= r.vtxCount)
+        return;
+    count = std::min(count, r.vtxCount - offset);
+    std::uint32_t begin = r.vtxOffset + offset;
+
+    Arena &a = arenas_[r.arena];
+    GLuint idVbo = a.idVbo;
+    counters_.bytesUploaded += std::uint64_t(count) * sizeof(std::uint32_t);
+    if (!idVbo)
+    {
+        if (!a.stagedKeys.empty())
+            std::fill_n(a.stagedKeys.begin() + begin, count, key);
+        return;
+    }
+    if (batching_)
+    {
+        if (!keyRun_.continues(idVbo, begin))
+        {
+            submitRun_(keyRun_);
+            keyRun_.buffer = idVbo;
+            keyRun_.begin = begin;
+        }
+        keyRun_.data.insert(keyRun_.data.end(), count, key);
+        return;
+    }
+
+    fill_(idVbo, GLintptr(begin) * GLintptr(sizeof(std::uint32_t)), key, GLsizeiptr(count));
+}
+
+template <class T>
+void GpuBufferHeap::submitRun_(PendingRun<T> &run)
+{
+    if (run.data.empty())
+        return;
+    put_(run.buffer, GLintptr(run.begin) * GLintptr(sizeof(T)),
+         run.data.data(), GLsizeiptr(run.data.size()) * GLsizeiptr(sizeof(T)));
+    run.data.clear();
+}
+
+void GpuBufferHeap::flushWrites_()
+{
+    submitRun_(vertexRun_);
+    submitRun_(keyRun_);
+}
+
+void GpuBufferHeap::endWrites()
+{
+    flushWrites_();
+    batching_ = false;
+}
+
+// ============================================
+// 绘制
+// ============================================
+
+void GpuBufferHeap::draw()
+{
+    for (const Arena &a : arenas_)
+    {
+        if (a.vertices.used() == 0 || !a.vao)
+            continue;
+
+        glBindVertexArray(a.vao);
+        if (indexed_)
+        {
+            glMultiDrawElementsBaseVertex(drawMode_, a.counts.data(), GL_UNSIGNED_INT,
+                                          a.indexOffsets.data(), GLsizei(a.counts.size()),
+                                          a.baseVertices.data());
+        }
+        else if (drawMode_ == GL_LINES)
+        {
+            glDrawArrays(GL_LINES, 0, GLsizei(a.vertices.highWater()));
+        }
+        else
+        {
+            glMultiDrawArrays(drawMode_, a.firsts.data(), a.counts.data(), GLsizei(a.firsts.size()));
+        }
+        ++counters_.drawCalls;
+    }
+    glBindVertexArray(0);
+}
+
+void GpuBufferHeap::drawSegments()
+{
+    if (indexed_)
+        return;
+
+    for (const Arena &a : arenas_)
+    {
+        if (a.vertices.used() == 0 || !a.vao)
+            continue;
+
+        // 高水位以下全部提交：空闲区已填零，不需要逐分配的参数
+        std::uint32_t hw = a.vertices.highWater();
+        std::uint32_t segments = drawMode_ == GL_LINES ? hw / 2 : hw - 1;
+        if (segments == 0)
+            continue;
+
+        glBindVertexArray(a.segVao);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(segments));
+        ++counters_.drawCalls;
+    }
+    glBindVertexArray(0);
+}
+
+void GpuBufferHeap::drawSegmentSubset()
+{
+    if (indexed_)
+        return;
+
+    for (const Arena &a : arenas_)
+    {
+        if (a.subCounts.empty() || !a.vao)
+            continue;
+
+        glBindVertexArray(a.segVao);
+        for (std::size_t i = 0; i < a.subCounts.size(); ++i)
+        {
+            GLsizei n = a.subCounts[i];
+            GLsizei segments = drawMode_ == GL_LINES ? n / 2 : n - 1;
+            if (segments <= 0)
+                continue;
+            pointSegments_(a.vbo, a.idVbo, std::uint32_t(a.subFirsts[i]));
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, segments);
+            ++counters_.drawCalls;
+        }
+        // 恢复整段绘制的偏移
+        pointSegments_(a.vbo, a.idVbo, 0);
+    }
+    glBindVertexArray(0);
+}
+
+void GpuBufferHeap::drawSegmentGathered()
+{
+    if (indexed_)
+        return;
+
+    // 每个 arena 的子集按偏移排序，首尾相接的分配合并成一段拷贝
+    gatherRuns_.clear();
+    std::uint32_t total = 0;
+    for (std::size_t ai = 0; ai < arenas_.size(); ++ai)
+    {
+        const Arena &a = arenas_[ai];
+        if (a.subCounts.empty() || !a.vao)
+            continue;
+        gatherScratch_.clear();
+        for (std::size_t i = 0; i < a.subCounts.size(); ++i)
+            gatherScratch_.emplace_back(std::uint32_t(a.subFirsts[i]), std::uint32_t(a.subCounts[i]));
+        std::sort(gatherScratch_.begin(), gatherScratch_.end());
+        for (const auto &r : gatherScratch_)
+        {
+            GatherRun *last = gatherRuns_.empty() ? nullptr : &gatherRuns_.back();
+            if (last && last->arena == ai && last->first + last->count == r.first)
+                last->count += r.second;
+            else
+                gatherRuns_.push_back(GatherRun{std::uint32_t(ai), r.first, r.second});
+            total += r.second;
+        }
+    }
+    std::uint32_t segments = drawMode_ == GL_LINES ? total / 2 : (total > 0 ? total - 1 : 0);
+    if (segments == 0)
+        return;
+
+    if (!gatherVao_)
+    {
+        glGenBuffers(1, &gatherVbo_);
+        glGenBuffers(1, &gatherIdVbo_);
+        glGenVertexArrays(1, &gatherVao_);
+        // 之后每帧重新申请存储，缓冲名不变，属性指针不用重设
+        glBindVertexArray(gatherVao_);
+        pointSegments_(gatherVbo_, gatherIdVbo_, 0);
+        for (GLuint loc = 0; loc < 5; ++loc)
+        {
+            glEnableVertexAttribArray(loc);
+            glVertexAttribDivisor(loc, 1);
+        }
+        glBindVertexArray(0);
+    }
+    // 每帧整块重新申请（孤立上一帧仍在绘制的存储），容量按 2 倍增长
+    if (total > gatherCapacity_)
+        gatherCapacity_ = std::max(total, gatherCapacity_ * 2);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, gatherVbo_);
+    glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(gatherCapacity_) * GLsizeiptr(sizeof(BatchVertex)), nullptr,
+                 GL_STREAM_DRAW);
+    std::uint32_t dst = 0;
+    for (const GatherRun &r : gatherRuns_)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, arenas_[r.arena].vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            GLintptr(r.first) * GLintptr(sizeof(BatchVertex)), GLintptr(dst) * GLintptr(sizeof(BatchVertex)),
+                            GLsizeiptr(r.count) * GLsizeiptr(sizeof(BatchVertex)));
+        dst += r.count;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, gatherIdVbo_);
+    glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(gatherCapacity_) * GLsizeiptr(sizeof(std::uint32_t)), nullptr,
+                 GL_STREAM_DRAW);
+    dst = 0;
+    for (const GatherRun &r : gatherRuns_)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, arenas_[r.arena].idVbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            GLintptr(r.first) * GLintptr(sizeof(std::uint32_t)),
+                            GLintptr(dst) * GLintptr(sizeof(std::uint32_t)),
+                            GLsizeiptr(r.count) * GLsizeiptr(sizeof(std::uint32_t)));
+        dst += r.count;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    counters_.bytesCopied += std::uint64_t(total) * (sizeof(BatchVertex) + sizeof(std::uint32_t));
+
+    glBindVertexArray(gatherVao_);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(segments));
+    glBindVertexArray(0);
+    ++counters_.drawCalls;
+}
+
+void GpuBufferHeap::beginSubset()
+{
+    for (Arena &a : arenas_)
+    {
+        a.subFirsts.clear();
+        a.subCounts.clear();
+        a.subIndexOffsets.clear();
+        a.subBaseVertices.clear();
+    }
+}
+
+void GpuBufferHeap::addToSubset(Handle h)
+{
+    const Record &r = records_[h];
+    Arena &a = arenas_[r.arena];
+    if (indexed_)
+    {
+        a.subCounts.push_back(GLsizei(r.idxCount));
+        a.subIndexOffsets.push_back((void *)(std::uintptr_t(r.idxOffset) * sizeof(GLuint)));
+        a.subBaseVertices.push_back(GLint(r.vtxOffset));
+    }
+    else
+    {
+        a.subFirsts.push_back(GLint(r.vtxOffset));
+        a.subCounts.push_back(GLsizei(r.vtxCount));
+    }
+}
+
+void GpuBufferHeap::drawSubset()
+{
+    for (const Arena &a : arenas_)
+    {
+        if (a.subCounts.empty() || !a.vao)
+            continue;
+
+        glBindVertexArray(a.vao);
+        if (indexed_)
+        {
+            glMultiDrawElementsBaseVertex(drawMode_, a.subCounts.data(), GL_UNSIGNED_INT,
+                                          a.subIndexOffsets.data(), GLsizei(a.subCounts.size()),
+                                          a.subBaseVertices.data());
+        }
+        else
+        {
+            glMultiDrawArrays(drawMode_, a.subFirsts.data(), a.subCounts.data(), GLsizei(a.subCounts.size()));
+        }
+        ++counters_.drawCalls;
+    }
+    glBindVertexArray(0);
+}
+
+// ============================================
+// 增量整理
+// ============================================
+
+// 空洞占高水位以下的比例超过 1/4 且达到一定规模才整理
+static bool fragmented(const RangeAllocator &alloc)
+{
+    std::uint32_t holes = alloc.holes();
+    return holes >= 1024 && holes * 4 > alloc.highWater();
+}
+
+bool GpuBufferHeap::moveDown_(Arena &a, Handle h)
+{
+    Record &r = records_[h];
+
+    std::uint32_t vtxOffset = 0, idxOffset = 0;
+    if (!a.vertices.allocateBelow(r.vtxCount, r.vtxOffset, vtxOffset))
+        return false;
+    if (indexed_ && !a.indices.allocate(r.idxCount, idxOffset))
+    {
+        a.vertices.free(vtxOffset, r.vtxCount);
+        return false;
+    }
+
+    // 同一缓冲内、互不重叠的区间拷贝，全程在 GPU 上完成（源数据须已提交）
+    flushWrites_();
+    glBindBuffer(GL_COPY_READ_BUFFER, a.vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, a.vbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        GLintptr(r.vtxOffset) * GLintptr(sizeof(BatchVertex)),
+                        GLintptr(vtxOffset) * GLintptr(sizeof(BatchVertex)),
+                        GLsizeiptr(r.vtxCount) * GLsizeiptr(sizeof(BatchVertex)));
+    glBindBuffer(GL_COPY_READ_BUFFER, a.idVbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, a.idVbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        GLintptr(r.vtxOffset) * GLintptr(sizeof(std::uint32_t)),
+                        GLintptr(vtxOffset) * GLintptr(sizeof(std::uint32_t)),
+                        GLsizeiptr(r.vtxCount) * GLsizeiptr(sizeof(std::uint32_t)));
+    if (indexed_)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, a.ibo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, a.ibo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            GLintptr(r.idxOffset) * GLintptr(sizeof(GLuint)),
+                            GLintptr(idxOffset) * GLintptr(sizeof(GLuint)),
+                            GLsizeiptr(r.idxCount) * GLsizeiptr(sizeof(GLuint)));
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    counters_.bytesCopied += std::uint64_t(r.vtxCount) * (sizeof(BatchVertex) + sizeof(std::uint32_t)) +
+                             std::uint64_t(r.idxCount) * sizeof(GLuint);
+
+    // 释放旧区间并更新记录
+    a.liveByOffset.erase(r.vtxOffset);
+    zeroFill_(a, r.vtxOffset, r.vtxCount);
+    a.vertices.free(r.vtxOffset, r.vtxCount);
+    if (indexed_)
+        a.indices.free(r.idxOffset, r.idxCount);
+
+    removeDraw_(h);
+    r.vtxOffset = vtxOffset;
+    r.idxOffset = idxOffset;
+    a.liveByOffset.emplace(vtxOffset, h);
+    addDraw_(h);
+    return true;
+}
+
+void GpuBufferHeap::compact(std::size_t budgetBytes)
+{
+    for (Arena &a : arenas_)
+    {
+        if (!a.vbo)
+            continue;
+        // 每次把最高处的分配搬进低处的空洞，高水位随之下降
+        while (budgetBytes > 0 && fragmented(a.vertices) && !a.liveByOffset.empty())
+        {
+            Handle h = std::prev(a.liveByOffset.end())->second;
+            std::size_t bytes = std::size_t(records_[h].vtxCount) * sizeof(BatchVertex) +
+                                std::size_t(records_[h].idxCount) * sizeof(GLuint);
+            if (!moveDown_(a, h))
+                break;  // 低处没有足够大的空洞
+            budgetBytes -= std::min(budgetBytes, bytes);
+        }
+        if (budgetBytes == 0)
+            return;
+    }
+}
+
+// ============================================
+// 延迟上传
+// ============================================
+
+std::vector<StagedArena> GpuBufferHeap::takeStaged()
+{
+    std::vector<StagedArena> out;
+    for (std::size_t i = 0; i < arenas_.size(); ++i)
+    {
+        Arena &a = arenas_[i];
+        if (a.vbo || a.staged.empty())
+            continue;
+        StagedArena st;
+        st.arena = std::uint32_t(i);
+        st.vertices = std::move(a.staged);
+        st.keys = std::move(a.stagedKeys);
+        a.staged.clear();
+        a.stagedKeys.clear();
+        out.push_back(std::move(st));
+    }
+    return out;
+}
+
+void GpuBufferHeap::adoptArena(std::uint32_t arena, GLuint vbo, GLuint idVbo)
+{
+    if (arena >= arenas_.size() || arenas_[arena].vbo)
+        return;
+    Arena &a = arenas_[arena];
+    a.vbo = vbo;
+    a.idVbo = idVbo;
+    setupArenaVaos_(a);
+}
+
+void GpuBufferHeap::swapContents(GpuBufferHeap &other)
+{
+    std::swap(arenas_, other.arenas_);
+    std::swap(records_, other.records_);
+    std::swap(freeHandles_, other.freeHandles_);
+    std::swap(deferred_, other.deferred_);
+}
+
+// ============================================
+// StreamRing
+// ============================================
+
+// ARB_buffer_storage / GL 4.4 的映射标志（3.3 Core 的头文件里没有）
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// 暂存写入的起点对齐：映射内存按 16 字节对齐，调用方可以直接写 vec4 / 实例结构
+static constexpr GLsizeiptr kStageAlign = 16;
+
+void StreamRing::initialize(GLsizeiptr capacityBytes, bool persistent)
+{
+    initializeOpenGLFunctions();
+    bufferStorage_ = nullptr;
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (persistent && ctx &&
+        (ctx->format().version() >= qMakePair(4, 4) || ctx->hasExtension("GL_ARB_buffer_storage")))
+        bufferStorage_ = reinterpret_cast<BufferStorageFn>(ctx->getProcAddress("glBufferStorage"));
+    glGenBuffers(1, &vbo_);
+    allocate_(capacityBytes);
+}
+
+void StreamRing::shutdown()
+{
+    for (GLsync &f : fences_)
+    {
+        if (f)
+            glDeleteSync(f);
+        f = nullptr;
+    }
+    if (vbo_)
+    {
+        if (mapped_ || rangeMapped_)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, vbo_);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &vbo_);
+    }
+    vbo_ = 0;
+    mapped_ = nullptr;
+    rangeMapped_ = false;
+    bufferStorage_ = nullptr;
+    capacity_ = segmentBytes_ = head_ = 0;
+    segment_ = 0;
+}
+
+void StreamRing::allocate_(GLsizeiptr capacityBytes)
+{
+    // 重新分配存储（旧存储由驱动在 GPU 用完后回收），旧 fence 不再需要
+    for (GLsync &f : fences_)
+    {
+        if (f)
+            glDeleteSync(f);
+        f = nullptr;
+    }
+    segmentBytes_ = std::max<GLsizeiptr>(capacityBytes / kSegments, 256);
+    capacity_ = segmentBytes_ * kSegments;
+    head_ = 0;
+    segment_ = 0;
+
+    if (bufferStorage_)
+    {
+        // 不可变存储不能重新指定大小：扩容时换一个缓冲
+        if (mapped_)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, vbo_);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &vbo_);
+            glGenBuffers(1, &vbo_);
+            mapped_ = nullptr;
+        }
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBindBuffer(GL_COPY_READ_BUFFER, vbo_);
+        bufferStorage_(GL_COPY_READ_BUFFER, capacity_, nullptr, flags);
+        mapped_ = static_cast<char *>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, capacity_, flags));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        if (mapped_)
+            return;
+
+        // 持久映射失败：换回可变存储，逐段映射
+        qWarning() << "StreamRing: persistent mapping failed, falling back to per-write mapping";
+        bufferStorage_ = nullptr;
+        glDeleteBuffers(1, &vbo_);
+        glGenBuffers(1, &vbo_);
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, vbo_);
+    glBufferData(GL_COPY_READ_BUFFER, capacity_, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void StreamRing::enterSegment_(int s)
+{
+    // 离开的段：此前引用它的绘制与拷贝都已提交，fence 之后 GPU 读完即可覆盖
+    fences_[segment_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    segment_ = s;
+    head_ = GLsizeiptr(s) * segmentBytes_;
+
+    GLsync &f = fences_[s];
+    if (f)
+    {
+        // 一整圈之前的命令通常早已完成；没完成时才真正等待，并计入 stalls
+        if (glClientWaitSync(f, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            ++stalls_;
+            while (glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED)
+            {
+            }
+        }
+        glDeleteSync(f);
+        f = nullptr;
+    }
+}
+
+GLintptr StreamRing::reserve_(GLsizeiptr bytes, GLsizeiptr align)
+{
+    // 调用方保证 bytes + align 不超过一段
+    GLsizeiptr start = (head_ + align - 1) / align * align;
+    if (start + bytes > GLsizeiptr(segment_ + 1) * segmentBytes_)
+    {
+        enterSegment_((segment_ + 1) % kSegments);
+        start = (head_ + align - 1) / align * align;
+    }
+    head_ = start + bytes;
+    bytesWritten_ += std::uint64_t(bytes);
+    return start;
+}
+
+void *StreamRing::mapRange_(GLintptr start, GLsizeiptr bytes)
+{
+    if (mapped_)
+        return mapped_ + start;
+
+    // 映射期间保持绑定在 COPY_READ 上，unmap 时解除
+    glBindBuffer(GL_COPY_READ_BUFFER, vbo_);
+    void *ptr = glMapBufferRange(GL_COPY_READ_BUFFER, start, bytes,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!ptr)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return nullptr;
+    }
+    rangeMapped_ = true;
+    return ptr;
+}
+
+void *StreamRing::map(GLsizeiptr count, GLsizeiptr stride, GLint &outFirst)
+{
+    GLsizeiptr bytes = count * stride;
+    if (!vbo_ || bytes <= 0)
+        return nullptr;
+
+    // 首元素按 stride 对齐，以便用 first 而不是重新设置属性指针
+    if (bytes + stride > segmentBytes_)
+    {
+        GLsizeiptr grown = capacity_;
+        while ((bytes + stride) * kSegments > grown)
+            grown *= 2;
+        allocate_(grown);
+    }
+    GLintptr start = reserve_(bytes, stride);
+    void *ptr = mapRange_(start, bytes);
+    if (ptr)
+        outFirst = GLint(start / stride);
+    return ptr;
+}
+
+void StreamRing::unmap()
+{
+    if (!rangeMapped_)
+        return;
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    rangeMapped_ = false;
+}
+
+GLsizeiptr StreamRing::stageChunk_() const
+{
+    return (segmentBytes_ - kStageAlign) / kStageAlign * kStageAlign;
+}
+
+void *StreamRing::stage(GLsizeiptr bytes, GLintptr &outOffset)
+{
+    if (!vbo_ || bytes <= 0 || bytes > stageChunk_())
+        return nullptr;
+    outOffset = reserve_(bytes, kStageAlign);
+    return mapRange_(outOffset, bytes);
+}
+
+void StreamRing::copy(GLintptr srcOffset, GLuint dst, GLintptr dstOffset, GLsizeiptr bytes)
+{
+    // 逐段映射时拷贝前必须先解除映射
+    unmap();
+    glBindBuffer(GL_COPY_READ_BUFFER, vbo_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, srcOffset, dstOffset, bytes);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void StreamRing::upload(GLuint dst, GLintptr dstOffset, const void *src, GLsizeiptr bytes)
+{
+    const char *p = static_cast<const char *>(src);
+    // 环未初始化时整块直接写入
+    const GLsizeiptr chunk = vbo_ ? stageChunk_() : bytes;
+    while (bytes > 0)
+    {
+        GLsizeiptr n = std::min(bytes, chunk);
+        GLintptr offset = 0;
+        void *dstPtr = stage(n, offset);
+        if (dstPtr)
+        {
+            std::memcpy(dstPtr, p, std::size_t(n));
+            copy(offset, dst, dstOffset, n);
+        }
+        else
+        {
+            // 映射失败（或环尚未初始化）时直接写入
+            glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, dstOffset, n, p);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        p += n;
+        dstOffset += n;
+        bytes -= n;
+    }
+}
+
+void StreamRing::fill(GLuint dst, GLintptr dstOffset, std::uint32_t value, GLsizeiptr count)
+{
+    const GLsizeiptr chunk = vbo_ ? stageChunk_() / GLsizeiptr(sizeof(std::uint32_t)) : count;
+    while (count > 0)
+    {
+        GLsizeiptr n = std::min(count, chunk);
+        GLsizeiptr bytes = n * GLsizeiptr(sizeof(std::uint32_t));
+        GLintptr offset = 0;
+        void *dstPtr = stage(bytes, offset);
+        if (dstPtr)
+        {
+            std::fill_n(static_cast<std::uint32_t *>(dstPtr), n, value);
+            copy(offset, dst, dstOffset, bytes);
+        }
+        else
+        {
+            std::vector<std::uint32_t> values(std::size_t(n), value);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, dstOffset, bytes, values.data());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        dstOffset += bytes;
+        count -= n;
+    }
+}
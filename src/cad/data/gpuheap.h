@@ -0,0 +1,281 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <QOpenGLFunctions_3_3_Core>
+#include <glm/glm.hpp>
+
+// 合批顶点：位置 + 打包颜色（0xRRGGBBAA）
+struct BatchVertex {
+    glm::vec3 pos;
+    std::uint32_t rgba;
+};
+
+// 延迟上传的 arena 内容：整块容量的顶点与拾取键（空闲处为零），
+// 由上传线程建缓冲并写入后经 GpuBufferHeap::adoptArena 接回
+struct StagedArena {
+    std::uint32_t arena = 0;
+    std::vector<BatchVertex> vertices;
+    std::vector<std::uint32_t> keys;
+};
+
+class StreamRing;
+
+// ============================================
+// RangeAllocator - 固定容量内的区间子分配器（单位：元素）
+// 空闲块按偏移与大小双索引：best-fit 分配 O(log n)，释放时与相邻空闲块合并
+// ============================================
+class RangeAllocator {
+public:
+    explicit RangeAllocator(std::uint32_t capacity = 0);
+
+    bool allocate(std::uint32_t count, std::uint32_t& outOffset);
+    // 只在 [0, limit) 内分配（整理时把数据往低处搬）
+    bool allocateBelow(std::uint32_t count, std::uint32_t limit, std::uint32_t& outOffset);
+    void free(std::uint32_t offset, std::uint32_t count);
+    void reset();
+
+    std::uint32_t capacity() const { return capacity_; }
+    std::uint32_t used() const { return used_; }
+    // 最高已分配位置（其后全部空闲）
+    std::uint32_t highWater() const;
+    // 高水位以下的空闲元素数，衡量碎片程度
+    std::uint32_t holes() const { return highWater() - used_; }
+
+private:
+    void insertFree_(std::uint32_t offset, std::uint32_t count);
+    void eraseFree_(std::map<std::uint32_t, std::uint32_t>::iterator it);
+
+    std::uint32_t capacity_ = 0;
+    std::uint32_t used_ = 0;
+    std::map<std::uint32_t, std::uint32_t> freeByOffset_;       // offset → count
+    std::multimap<std::uint32_t, std::uint32_t> freeBySize_;    // count → offset
+};
+
+// ============================================
+// GpuBufferHeap - 实体几何的 GPU 缓冲堆
+// 少量大 VBO/IBO（arena）被子分配给各实体；实体只持有句柄，
+// 编辑时尺寸不变即 glBufferSubData 原地写入；碎片由 compact() 增量整理
+// ============================================
+class GpuBufferHeap : protected QOpenGLFunctions_3_3_Core {
+public:
+    using Handle = std::uint32_t;
+    static constexpr Handle kInvalid = 0xFFFFFFFFu;
+
+    // drawMode：GL_LINES 时整段绘制（空闲区填零，退化为不可见的零长线段），
+    // 其它图元按分配逐段 glMultiDrawArrays / glMultiDrawElementsBaseVertex。
+    // 非索引堆的空闲区（顶点与拾取键）都填零，供 drawSegments 整段实例化绘制
+    void initialize(GLenum drawMode, bool indexed,
+                    std::uint32_t arenaVertices, std::uint32_t arenaIndices = 0);
+    void shutdown();
+    void clear();
+
+    Handle allocate(std::uint32_t vertexCount, std::uint32_t indexCount = 0);
+    void   release(Handle h);
+
+    std::uint32_t vertexCount(Handle h) const { return records_[h].vtxCount; }
+    std::uint32_t indexCount(Handle h) const { return records_[h].idxCount; }
+
+    // 写入（offset 以分配内的元素为单位）
+    void writeVertices(Handle h, const BatchVertex* v, std::uint32_t count, std::uint32_t offset = 0);
+    void writeIndices(Handle h, const GLuint* idx, std::uint32_t count, std::uint32_t offset = 0);
+    // 拾取键：分配内 [offset, offset + count) 的顶点写入同一个值（顶点属性 2，整型），默认整个分配
+    void writePickId(Handle h, std::uint32_t key, std::uint32_t offset = 0, std::uint32_t count = 0xFFFFFFFFu);
+
+    // 合并写入：beginWrites 之后，writeVertices / writePickId 先在 CPU 端按缓冲位置拼接，
+    // 首尾相接的写入合成一次传输（重建时新分配连续排布，一个 arena 只需一两次传输）。
+    // endWrites 提交剩余部分；释放填零与整理搬移之前会先提交。绘制前必须 endWrites
+    void beginWrites() { batching_ = true; }
+    void endWrites();
+
+    // 写入经由暂存环（StreamRing::upload / fill）以 GPU 拷贝落到 arena；不设置时直接 glBufferSubData
+    void setStaging(StreamRing* ring) { staging_ = ring; }
+
+    // 每个 arena 一次绘制调用
+    void draw();
+
+    // 宽线：每个 arena 一次实例化绘制（GL_TRIANGLE_STRIP，每实例 4 个顶点），
+    // 实例属性直接取自 arena 缓冲：0 = 起点位置, 1 = 起点颜色, 2 = 起点拾取键, 3 = 终点位置, 4 = 终点拾取键。
+    // GL_LINES 按顶点对取一段；GL_LINE_STRIP 按相邻顶点取一段，跨分配的伪线段两端拾取键不同，由着色器剔除。
+    // 只用于非索引堆
+    void drawSegments();
+    // 宽线的子集：addToSubset 加入的每个分配一次实例化绘制（实例属性指针逐段移到分配起点），
+    // 只适合少量分配（叠加层、很小的裁剪结果）
+    void drawSegmentSubset();
+    // 宽线的大子集：加入的分配按偏移排序、相邻的合并，用 GPU 拷贝拼接到一对紧凑缓冲后一次实例化绘制。
+    // 分配首尾的拾取键不同（折线分页以键 0 的顶点结尾），拼接处不会连出伪线段
+    void drawSegmentGathered();
+
+    // 子集绘制（视锥裁剪后）：beginSubset → addToSubset(h)... → drawSubset
+    // 只提交加入的分配，每个 arena 仍是一次多重绘制
+    void beginSubset();
+    void addToSubset(Handle h);
+    void drawSubset();
+
+    // 增量整理：把高处的分配搬到低处的空洞，最多搬动 budgetBytes 字节
+    void compact(std::size_t budgetBytes);
+
+    // 延迟上传（只用于非索引堆）：开启后新建的 arena 不创建 GL 对象，写入落在 CPU 端的整块镜像；
+    // takeStaged 交出这些镜像（此后到接回前，对这些 arena 的写入被丢弃），
+    // 另一个共享上下文建好缓冲后由 adoptArena 接回并在当前上下文创建 VAO（VAO 不跨上下文共享）。
+    // 尚未接回的 arena 不参与绘制与整理
+    void setDeferred(bool on) { deferred_ = on; }
+    std::vector<StagedArena> takeStaged();
+    void adoptArena(std::uint32_t arena, GLuint vbo, GLuint idVbo);
+    // 与另一个堆交换全部分配与 GL 对象（两者须以相同参数 initialize）
+    void swapContents(GpuBufferHeap& other);
+
+    std::size_t arenaCount() const { return arenas_.size(); }
+    std::size_t liveAllocations() const { return records_.size() - freeHandles_.size(); }
+
+    // 统计计数（累计，由调用方按帧清零）
+    struct Counters {
+        std::uint64_t bytesUploaded = 0;  // CPU → GPU 写入（含释放时的填零）
+        std::uint64_t bytesCopied = 0;    // 整理时的 GPU 内部拷贝
+        std::uint32_t drawCalls = 0;
+    };
+    const Counters& counters() const { return counters_; }
+    void resetCounters() { counters_ = Counters{}; }
+
+private:
+    struct Record {
+        std::uint16_t arena = 0;
+        std::uint32_t vtxOffset = 0, vtxCount = 0;
+        std::uint32_t idxOffset = 0, idxCount = 0;
+        std::uint32_t drawSlot = 0;
+        bool alive = false;
+    };
+
+    struct Arena {
+        GLuint vao = 0, vbo = 0, ibo = 0;
+        GLuint idVbo = 0;  // 每顶点一个拾取键，与 vbo 同偏移
+        GLuint segVao = 0; // 宽线：同一缓冲按实例读取线段两端
+        RangeAllocator vertices, indices;
+        // 延迟上传时的 CPU 镜像（vbo 为 0 且镜像为空表示正在上传）
+        std::vector<BatchVertex> staged;
+        std::vector<std::uint32_t> stagedKeys;
+        std::map<std::uint32_t, Handle> liveByOffset;  // 顶点偏移 → 句柄，整理时从高处取
+
+        // 多重绘制参数（每个分配一项，删除时 swap-remove）
+        std::vector<GLint>   firsts;
+        std::vector<GLsizei> counts;
+        std::vector<void*>   indexOffsets;
+        std::vector<GLint>   baseVertices;
+        std::vector<Handle>  drawHandles;
+
+        // 本帧子集的多重绘制参数
+        std::vector<GLint>   subFirsts;
+        std::vector<GLsizei> subCounts;
+        std::vector<void*>   subIndexOffsets;
+        std::vector<GLint>   subBaseVertices;
+    };
+
+    std::uint16_t createArena_(std::uint32_t minVertices, std::uint32_t minIndices);
+    void setupArenaVaos_(Arena& a);
+    bool place_(Record& r, std::uint16_t arena, std::uint32_t vtxCount, std::uint32_t idxCount);
+    void addDraw_(Handle h);
+    void removeDraw_(Handle h);
+    void zeroFill_(Arena& a, std::uint32_t offset, std::uint32_t count);
+    void pointSegments_(GLuint vbo, GLuint idVbo, std::uint32_t firstVertex);  // 需已绑定对应的 VAO
+    bool moveDown_(Arena& a, Handle h);
+    void flushWrites_();
+    void put_(GLuint buffer, GLintptr offset, const void* data, GLsizeiptr bytes);
+    void fill_(GLuint buffer, GLintptr offset, std::uint32_t value, GLsizeiptr count);
+
+    // 待提交的合并写入：buffer 中 [begin, begin + data.size()) 个元素
+    template <class T>
+    struct PendingRun {
+        GLuint buffer = 0;
+        std::uint32_t begin = 0;
+        std::vector<T> data;
+        bool continues(GLuint b, std::uint32_t offset) const
+        {
+            return buffer == b && begin + std::uint32_t(data.size()) == offset;
+        }
+    };
+    template <class T> void submitRun_(PendingRun<T>& run);
+
+    GLenum drawMode_ = GL_LINES;
+    bool indexed_ = false;
+    std::uint32_t arenaVertices_ = 0, arenaIndices_ = 0;
+    bool deferred_ = false;
+    StreamRing* staging_ = nullptr;
+
+    std::vector<Arena> arenas_;
+    std::vector<Record> records_;
+    std::vector<Handle> freeHandles_;
+    std::vector<std::uint32_t> pickScratch_;
+
+    // drawSegmentGathered 的收集缓冲（顶点 / 拾取键）与拷贝段
+    struct GatherRun {
+        std::uint32_t arena = 0, first = 0, count = 0;
+    };
+    GLuint gatherVbo_ = 0, gatherIdVbo_ = 0, gatherVao_ = 0;
+    std::uint32_t gatherCapacity_ = 0;  // 顶点数
+    std::vector<GatherRun> gatherRuns_;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> gatherScratch_;  // (偏移, 顶点数)
+    bool batching_ = false;
+    PendingRun<BatchVertex> vertexRun_;
+    PendingRun<std::uint32_t> keyRun_;
+    Counters counters_;
+};
+
+// ============================================
+// StreamRing - 流式环形缓冲（即时模式几何与上传暂存）
+// 一个常驻缓冲等分为若干段。支持 ARB_buffer_storage 时整块持久映射（coherent），
+// 写入直接落在映射内存里；否则每次写入用 GL_MAP_UNSYNCHRONIZED_BIT 映射一段，不与 GPU 同步。
+// 写指针离开一段时插入 fence，回绕后再次进入该段前等待它，保证 GPU 已读完（或拷完）上一圈的数据。
+// 单次写入不跨段；超过一段的 map 会把缓冲扩容（重新分配并丢弃所有 fence，持久映射时缓冲名会变），
+// upload 则按段切块，不会扩容
+// ============================================
+class StreamRing : protected QOpenGLFunctions_3_3_Core {
+public:
+    // persistent：可用时使用持久映射（须在 GL 上下文为当前时调用）
+    void initialize(GLsizeiptr capacityBytes, bool persistent = true);
+    void shutdown();
+
+    GLuint buffer() const { return vbo_; }
+    bool persistent() const { return mapped_ != nullptr; }
+
+    // 预留 count 个 stride 字节的元素并映射，返回写指针；outFirst 为首元素在缓冲中的下标
+    // （VAO 以偏移 0 绑定时即为 glDrawArrays 的 first）。写完必须 unmap（持久映射时为空操作）
+    void* map(GLsizeiptr count, GLsizeiptr stride, GLint& outFirst);
+    void unmap();
+
+    // 暂存上传：经环形缓冲写入 dst（GL_COPY_WRITE_BUFFER 上的 glCopyBufferSubData），
+    // 驱动不必拷贝调用方的内存，也不会因 dst 仍被前面的绘制引用而隐式同步。
+    // stage 返回可直接写入的映射内存（不超过一段），写完后 copy 提交；upload 为 memcpy 的便捷版本
+    void* stage(GLsizeiptr bytes, GLintptr& outOffset);
+    void copy(GLintptr srcOffset, GLuint dst, GLintptr dstOffset, GLsizeiptr bytes);
+    void upload(GLuint dst, GLintptr dstOffset, const void* src, GLsizeiptr bytes);
+    // dst 的一段填成同一个 4 字节值（直接写进暂存内存）
+    void fill(GLuint dst, GLintptr dstOffset, std::uint32_t value, GLsizeiptr count);
+
+    GLsizeiptr maxStage() const { return segmentBytes_; }
+
+    std::uint64_t bytesWritten() const { return bytesWritten_; }
+    std::uint32_t stalls() const { return stalls_; }
+    void resetCounters() { bytesWritten_ = 0; stalls_ = 0; }
+
+private:
+    static constexpr int kSegments = 4;
+
+    void allocate_(GLsizeiptr capacityBytes);
+    void enterSegment_(int s);
+    GLintptr reserve_(GLsizeiptr bytes, GLsizeiptr align);
+    GLsizeiptr stageChunk_() const;
+    void* mapRange_(GLintptr start, GLsizeiptr bytes);
+
+    using BufferStorageFn = void (QOPENGLF_APIENTRYP)(GLenum, GLsizeiptr, const void*, GLbitfield);
+    BufferStorageFn bufferStorage_ = nullptr;
+
+    GLuint vbo_ = 0;
+    char* mapped_ = nullptr;      // 持久映射的起点
+    bool rangeMapped_ = false;    // 逐段映射时，是否有一段尚未 unmap
+    GLsizeiptr capacity_ = 0, segmentBytes_ = 0;
+    GLsizeiptr head_ = 0;
+    int segment_ = 0;
+    GLsync fences_[kSegments] = {};
+    std::uint64_t bytesWritten_ = 0;
+    std::uint32_t stalls_ = 0;  // 进入一段时 fence 尚未触发、真正等待的次数
+};
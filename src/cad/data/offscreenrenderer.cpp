@@ -0,0 +1,263 @@
+#include "offscreenrenderer.h"
+#include <algorithm>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QSurfaceFormat>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <glm/gtc/matrix_transform.hpp>
+
+OffscreenRenderer::OffscreenRenderer() = default;
+
+OffscreenRenderer::~OffscreenRenderer()
+{
+    shutdown();
+}
+
+// ============================================
+// 上下文与 FBO
+// ============================================
+
+bool OffscreenRenderer::initialize(int width, int height, int samples)
+{
+    shutdown();
+
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setDepthBufferSize(24);
+    format.setRenderableType(QSurfaceFormat::OpenGL);
+
+    context_ = std::make_unique<QOpenGLContext>();
+    context_->setFormat(format);
+    if (!context_->create())
+    {
+        qCritical() << "OffscreenRenderer: failed to create OpenGL context";
+        context_.reset();
+        return false;
+    }
+
+    surface_ = std::make_unique<QOffscreenSurface>();
+    surface_->setFormat(context_->format());
+    surface_->create();
+    if (!surface_->isValid() || !context_->makeCurrent(surface_.get()))
+    {
+        qCritical() << "OffscreenRenderer: failed to make offscreen surface current";
+        surface_.reset();
+        context_.reset();
+        return false;
+    }
+
+    initializeOpenGLFunctions();
+    qDebug() << "OffscreenRenderer: OpenGL" << (const char *)glGetString(GL_VERSION)
+             << "on" << (const char *)glGetString(GL_RENDERER);
+
+    samples_ = std::max(samples, 0);
+    if (!createFbo_(width, height))
+    {
+        shutdown();
+        return false;
+    }
+
+    renderer_ = std::make_unique<Renderer>();
+    if (!renderer_->initialize())
+    {
+        shutdown();
+        return false;
+    }
+    gridRenderer_ = std::make_unique<GridRenderer>();
+    axisRenderer_ = std::make_unique<AxisRenderer>();
+
+    glGenQueries(2, timeQueries_);
+
+    // 与 GLWidget::initializeGL 相同的默认状态
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_MULTISAMPLE);
+
+    fitTopView(Aabb(glm::vec3(-1.0f), glm::vec3(1.0f)));
+    return true;
+}
+
+void OffscreenRenderer::shutdown()
+{
+    if (!context_)
+        return;
+
+    // GL 资源必须在自己的上下文中释放
+    if (surface_ && context_->makeCurrent(surface_.get()))
+    {
+        if (renderer_)
+            renderer_->shutdown();
+        renderer_.reset();
+        gridRenderer_.reset();
+        axisRenderer_.reset();
+
+        if (timeQueries_[0])
+            glDeleteQueries(2, timeQueries_);
+        timeQueries_[0] = timeQueries_[1] = 0;
+
+        fbo_.reset();
+        context_->doneCurrent();
+    }
+
+    fbo_.reset();
+    context_.reset();
+    surface_.reset();
+}
+
+bool OffscreenRenderer::createFbo_(int width, int height)
+{
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    fboFormat.setSamples(samples_);
+    fboFormat.setInternalTextureFormat(GL_RGBA8);
+
+    fbo_ = std::make_unique<QOpenGLFramebufferObject>(width, height, fboFormat);
+    if (!fbo_->isValid())
+    {
+        qCritical() << "OffscreenRenderer: failed to create" << width << "x" << height << "FBO";
+        fbo_.reset();
+        return false;
+    }
+
+    viewport_.width = width;
+    viewport_.height = height;
+    viewport_.updateWorldPerPixel();
+    return true;
+}
+
+bool OffscreenRenderer::resize(int width, int height)
+{
+    if (!makeCurrent())
+        return false;
+    if (width == viewport_.width && height == viewport_.height && fbo_)
+        return true;
+
+    fbo_.reset();
+    return createFbo_(width, height);
+}
+
+bool OffscreenRenderer::makeCurrent()
+{
+    return context_ && surface_ && context_->makeCurrent(surface_.get());
+}
+
+void OffscreenRenderer::doneCurrent()
+{
+    if (context_)
+        context_->doneCurrent();
+}
+
+// ============================================
+// 相机
+// ============================================
+
+void OffscreenRenderer::setView(const glm::mat4 &view, const glm::mat4 &proj)
+{
+    viewport_.view = view;
+    viewport_.proj = proj;
+    viewport_.updateWorldPerPixel();
+}
+
+void OffscreenRenderer::fitTopView(const Aabb &bounds, float margin)
+{
+    Aabb box = bounds.valid() ? bounds : Aabb(glm::vec3(-1.0f), glm::vec3(1.0f));
+    glm::vec3 c = box.center();
+    glm::vec3 e = glm::max(box.extent(), glm::vec3(1e-3f));
+
+    float aspect = viewport_.height > 0 ? float(viewport_.width) / float(viewport_.height) : 1.0f;
+    float halfH = std::max(e.y * 0.5f, e.x * 0.5f / aspect) * (1.0f + margin);
+    float halfW = halfH * aspect;
+
+    // 相机放在包围盒上方，近远平面覆盖整个 Z 范围
+    float dist = e.z + halfH + 1.0f;
+    glm::mat4 view = glm::lookAt(glm::vec3(c.x, c.y, box.max.z + dist),
+                                 glm::vec3(c.x, c.y, c.z),
+                                 glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::ortho(-halfW, halfW, -halfH, halfH, 0.1f, dist + e.z + 1.0f);
+    setView(view, proj);
+}
+
+// ============================================
+// 绘制
+// ============================================
+
+double OffscreenRenderer::queryMs_(GLuint query)
+{
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+    return double(ns) / 1.0e6;
+}
+
+const FrameTiming &OffscreenRenderer::renderFrame(const Document &doc, bool forceRebuild)
+{
+    timing_ = FrameTiming{};
+    if (!fbo_ || !makeCurrent())
+        return timing_;
+
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+
+    fbo_->bind();
+    glViewport(0, 0, viewport_.width, viewport_.height);
+    renderer_->resetStats();
+
+    // 同步阶段：CPU 打包 + 缓冲上传
+    QElapsedTimer timer;
+    timer.start();
+    glBeginQuery(GL_TIME_ELAPSED, timeQueries_[0]);
+    renderer_->syncFromDocument(doc, viewport_, forceRebuild);
+    glEndQuery(GL_TIME_ELAPSED);
+    timing_.syncCpuMs = timer.nsecsElapsed() / 1.0e6;
+
+    // 绘制阶段
+    timer.restart();
+    glBeginQuery(GL_TIME_ELAPSED, timeQueries_[1]);
+    glClearColor(clearColor_.r, clearColor_.g, clearColor_.b, clearColor_.a);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (drawGrid_)
+        gridRenderer_->draw(*renderer_, viewport_, 0x40404040, 0x80808080, 5);
+    if (drawAxis_)
+        axisRenderer_->draw(*renderer_, viewport_, 100.0f, 0xFF0000FF, 0x00FF00FF, 0x0000FFFF, false);
+    renderer_->draw(viewport_);
+    glEndQuery(GL_TIME_ELAPSED);
+    timing_.drawCpuMs = timer.nsecsElapsed() / 1.0e6;
+
+    // 等待 GPU 完成，使每帧的计时互不重叠
+    glFinish();
+    timing_.frameMs = frameTimer.nsecsElapsed() / 1.0e6;
+    timing_.syncGpuMs = queryMs_(timeQueries_[0]);
+    timing_.drawGpuMs = queryMs_(timeQueries_[1]);
+
+    GLenum err;
+    while ((err = glGetError()) != GL_NO_ERROR)
+    {
+        qWarning() << "OffscreenRenderer: OpenGL error:" << err;
+    }
+
+    fbo_->release();
+    return timing_;
+}
+
+QImage OffscreenRenderer::grabImage()
+{
+    if (!fbo_ || !makeCurrent())
+        return QImage();
+    // 多重采样 FBO 由 toImage 内部 blit 到单采样缓冲后读回
+    return fbo_->toImage();
+}
+
+bool OffscreenRenderer::savePng(const QString &path)
+{
+    QImage image = grabImage();
+    if (image.isNull())
+        return false;
+    if (!image.save(path, "PNG"))
+    {
+        qWarning() << "OffscreenRenderer: failed to write" << path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <memory>
+#include <QImage>
+#include <QString>
+#include <QOpenGLFunctions_3_3_Core>
+#include <glm/glm.hpp>
+#include "renderer.h"
+#include "GridAxisHelper.h"
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QOpenGLFramebufferObject;
+
+// 单帧计时（毫秒）
+struct FrameTiming {
+    double syncCpuMs = 0.0;   // syncFromDocument 的 CPU 耗时
+    double drawCpuMs = 0.0;   // 网格/坐标轴/实体绘制命令提交的 CPU 耗时
+    double syncGpuMs = 0.0;   // GPU 执行同步阶段（上传）的时间，GL_TIME_ELAPSED
+    double drawGpuMs = 0.0;   // GPU 执行绘制的时间
+    double frameMs   = 0.0;   // 整帧墙钟时间（含 glFinish）
+};
+
+// ============================================
+// OffscreenRenderer - 无窗口渲染
+// QOffscreenSurface + 独立 QOpenGLContext + FBO，供服务端缩略图和基准测试使用。
+// 只需要 QGuiApplication；无显示器的 Linux 上使用
+//   QT_QPA_PLATFORM=offscreen（或 minimalegl）+ Mesa llvmpipe（LIBGL_ALWAYS_SOFTWARE=1）
+// 着色器与 GLWidget 相同，按工作目录下的 shaders/ 相对路径加载
+// ============================================
+class OffscreenRenderer : protected QOpenGLFunctions_3_3_Core {
+public:
+    OffscreenRenderer();
+    ~OffscreenRenderer();
+
+    // 创建上下文与 FBO；samples > 0 时使用多重采样 FBO（读回时自动解析）
+    bool initialize(int width, int height, int samples = 4);
+    void shutdown();
+    bool isValid() const { return fbo_ != nullptr; }
+
+    // 重新创建 FBO（渲染器与 GPU 缓冲保留）
+    bool resize(int width, int height);
+    int width() const { return viewport_.width; }
+    int height() const { return viewport_.height; }
+
+    // 相机：直接设置矩阵，或按包围盒生成俯视正交视图
+    void setView(const glm::mat4& view, const glm::mat4& proj);
+    void fitTopView(const Aabb& bounds, float margin = 0.05f);
+    const ViewportState& viewport() const { return viewport_; }
+
+    void setDrawGrid(bool on) { drawGrid_ = on; }
+    void setDrawAxis(bool on) { drawAxis_ = on; }
+    void setClearColor(const glm::vec4& c) { clearColor_ = c; }
+
+    Renderer& renderer() { return *renderer_; }
+
+    // 同步 doc 并绘制一帧到 FBO，等待 GPU 完成后返回本帧计时；
+    // renderer().stats() 随后给出本帧的绘制调用数与上传字节。
+    // 换用另一个 Document 时必须 forceRebuild（变更日志游标只对同一文档有效）
+    const FrameTiming& renderFrame(const Document& doc, bool forceRebuild = false);
+    const FrameTiming& lastTiming() const { return timing_; }
+
+    // 读回当前帧
+    QImage grabImage();
+    bool savePng(const QString& path);
+
+    // 在离屏上下文中执行额外的 GL 调用
+    bool makeCurrent();
+    void doneCurrent();
+
+private:
+    bool createFbo_(int width, int height);
+    double queryMs_(GLuint query);
+
+    std::unique_ptr<QOffscreenSurface> surface_;
+    std::unique_ptr<QOpenGLContext> context_;
+    std::unique_ptr<QOpenGLFramebufferObject> fbo_;
+    int samples_ = 0;
+
+    std::unique_ptr<Renderer> renderer_;
+    std::unique_ptr<GridRenderer> gridRenderer_;
+    std::unique_ptr<AxisRenderer> axisRenderer_;
+
+    ViewportState viewport_;
+    bool drawGrid_ = false;
+    bool drawAxis_ = false;
+    glm::vec4 clearColor_{0.1f, 0.1f, 0.1f, 1.0f};
+
+    GLuint timeQueries_[2] = {0, 0};  // [0] 同步, [1] 绘制
+    FrameTiming timing_;
+};
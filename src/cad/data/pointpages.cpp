@@ -0,0 +1,403 @@
+#include "pointpages.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <iterator>
+
+// 戳记全局递增：不同对象、不同时刻的页不会撞号，拷贝出的页保留原戳记
+static std::uint64_t nextStamp()
+{
+    static std::atomic<std::uint64_t> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+// 拷贝不共享池：池中的点拷成自持的一页，保留包围盒与戳记
+PointPages::PointPages(const PointPages &o)
+    : size_(o.size_)
+{
+    if (!o.pool_)
+    {
+        pages_ = o.pages_;
+        starts_ = o.starts_;
+        return;
+    }
+    if (size_ > 0)
+    {
+        Page pg;
+        pg.pts.assign(o.poolData_(), o.poolData_() + size_);
+        pg.bounds = o.poolBounds_;
+        pg.stamp = o.poolStamp_;
+        pages_.push_back(std::move(pg));
+    }
+    reindex_(0);
+}
+
+PointPages::PointPages(PointPages &&o) noexcept
+    : pages_(std::move(o.pages_)), starts_(std::move(o.starts_)), size_(o.size_),
+      pool_(o.pool_), span_(o.span_), poolBounds_(o.poolBounds_), poolStamp_(o.poolStamp_)
+{
+    o.size_ = 0;
+    o.pool_ = nullptr;
+    o.span_ = VertexPool::Span{};
+}
+
+PointPages &PointPages::operator=(const PointPages &o)
+{
+    if (this != &o)
+        *this = PointPages(o);
+    return *this;
+}
+
+PointPages &PointPages::operator=(PointPages &&o) noexcept
+{
+    // 覆盖池中的序列会丢掉它的区间（池里留下永远不归还的空洞）：持有池的一方须先 releasePooled
+    assert(!pooled() || this == &o);
+    pages_ = std::move(o.pages_);
+    starts_ = std::move(o.starts_);
+    size_ = o.size_;
+    pool_ = o.pool_;
+    span_ = o.span_;
+    poolBounds_ = o.poolBounds_;
+    poolStamp_ = o.poolStamp_;
+    o.size_ = 0;
+    o.pool_ = nullptr;
+    o.span_ = VertexPool::Span{};
+    return *this;
+}
+
+PointPages PointPages::inPoolCopy(const PointPages &src, VertexPool &poolCopy)
+{
+    if (!src.pool_)
+        return PointPages(src);
+    PointPages out;
+    out.size_ = src.size_;
+    out.pool_ = &poolCopy;
+    out.span_ = src.span_;
+    out.poolBounds_ = src.poolBounds_;
+    out.poolStamp_ = src.poolStamp_;
+    return out;
+}
+
+const glm::vec3 &PointPages::operator[](std::size_t i) const
+{
+    if (pool_)
+        return poolData_()[i];
+    std::size_t k = locate_(i);
+    return pages_[k].pts[i - starts_[k]];
+}
+
+PointPages::PageView PointPages::page(std::size_t k) const
+{
+    if (pool_)
+        return PageView{poolData_(), size_, poolBounds_, poolStamp_};
+    const Page &pg = pages_[k];
+    return PageView{pg.pts.data(), pg.pts.size(), pg.bounds, pg.stamp};
+}
+
+Aabb PointPages::bounds() const
+{
+    if (pool_)
+        return poolBounds_;
+    Aabb b;
+    for (const Page &pg : pages_)
+        b.expand(pg.bounds);
+    return b;
+}
+
+std::vector<glm::vec3> PointPages::toVector() const
+{
+    std::vector<glm::vec3> out;
+    out.reserve(size_);
+    for (std::size_t k = 0; k < pageCount(); ++k)
+    {
+        PageView v = page(k);
+        out.insert(out.end(), v.begin(), v.end());
+    }
+    return out;
+}
+
+std::size_t PointPages::locate_(std::size_t i) const
+{
+    auto it = std::upper_bound(starts_.begin(), starts_.end(), i);
+    return std::size_t(it - starts_.begin()) - 1;
+}
+
+void PointPages::touch_(std::size_t k)
+{
+    Page &pg = pages_[k];
+    pg.bounds = Aabb();
+    for (const glm::vec3 &p : pg.pts)
+        pg.bounds.expand(p);
+    pg.stamp = nextStamp();
+}
+
+void PointPages::reindex_(std::size_t from)
+{
+    starts_.resize(pages_.size());
+    std::size_t start = from == 0 ? 0 : starts_[from - 1] + pages_[from - 1].pts.size();
+    for (std::size_t k = from; k < pages_.size(); ++k)
+    {
+        starts_[k] = start;
+        start += pages_[k].pts.size();
+    }
+}
+
+// ============================================
+// 池模式
+// ============================================
+
+void PointPages::moveToPool(VertexPool &pool)
+{
+    if (pool_ == &pool || size_ > kMaxPagePoints)
+        return;
+
+    // 来源可能是分页，也可能是另一个池：先拷进新区间，再丢掉原来的存储
+    VertexPool::Span span = pool.allocate(std::uint32_t(size_));
+    glm::vec3 *dst = pool.data() + span.offset;
+    for (std::size_t k = 0; k < pageCount(); ++k)
+    {
+        PageView v = page(k);
+        dst = std::copy(v.begin(), v.end(), dst);
+    }
+    Aabb b = bounds();
+    std::uint64_t stamp = pageCount() == 1 ? page(0).stamp : nextStamp();
+    if (pool_)
+        pool_->release(span_);
+
+    std::vector<Page>().swap(pages_);
+    std::vector<std::size_t>().swap(starts_);
+    pool_ = &pool;
+    span_ = span;
+    poolBounds_ = b;
+    poolStamp_ = stamp;
+}
+
+void PointPages::releasePooled()
+{
+    if (!pool_)
+        return;
+    pool_->release(span_);
+    pool_ = nullptr;
+    span_ = VertexPool::Span{};
+    poolBounds_ = Aabb();
+    size_ = 0;
+}
+
+void PointPages::touchPooled_()
+{
+    poolBounds_ = Aabb();
+    const glm::vec3 *p = poolData_();
+    for (std::size_t i = 0; i < size_; ++i)
+        poolBounds_.expand(p[i]);
+    poolStamp_ = nextStamp();
+}
+
+void PointPages::unpool_()
+{
+    Page pg;
+    pg.pts.assign(poolData_(), poolData_() + size_);
+    pg.bounds = poolBounds_;
+    pg.stamp = poolStamp_;
+    pool_->release(span_);
+    pool_ = nullptr;
+    span_ = VertexPool::Span{};
+
+    pages_.clear();
+    if (size_ > 0)
+        pages_.push_back(std::move(pg));
+    reindex_(0);
+}
+
+// ============================================
+// 修改
+// ============================================
+
+void PointPages::assign(const glm::vec3 *pts, std::size_t count)
+{
+    if (pool_)
+    {
+        if (count > kMaxPagePoints)
+        {
+            releasePooled();
+        }
+        else
+        {
+            // 点数变了换一个区间；池可能扩容，写入时重新取地址
+            if (count != size_)
+            {
+                pool_->release(span_);
+                span_ = pool_->allocate(std::uint32_t(count));
+                size_ = count;
+            }
+            std::copy(pts, pts + count, poolData_());
+            touchPooled_();
+            return;
+        }
+    }
+
+    pages_.clear();
+    std::size_t pageCount = (count + kPagePoints - 1) / kPagePoints;
+    pages_.resize(pageCount);
+    for (std::size_t k = 0; k < pageCount; ++k)
+    {
+        std::size_t begin = k * kPagePoints, end = std::min(count, begin + kPagePoints);
+        pages_[k].pts.assign(pts + begin, pts + end);
+        touch_(k);
+    }
+    size_ = count;
+    reindex_(0);
+}
+
+void PointPages::write(std::size_t first, const glm::vec3 *pts, std::size_t count)
+{
+    if (first >= size_)
+        return;
+    count = std::min(count, size_ - first);
+    if (pool_)
+    {
+        std::copy(pts, pts + count, poolData_() + first);
+        touchPooled_();
+        return;
+    }
+    for (std::size_t k = locate_(first); count > 0; ++k)
+    {
+        Page &pg = pages_[k];
+        std::size_t offset = first - starts_[k];
+        std::size_t n = std::min(count, pg.pts.size() - offset);
+        std::copy(pts, pts + n, pg.pts.begin() + offset);
+        touch_(k);
+        pts += n;
+        first += n;
+        count -= n;
+    }
+}
+
+void PointPages::insert(std::size_t pos, const glm::vec3 *pts, std::size_t count)
+{
+    if (count == 0)
+        return;
+    pos = std::min(pos, size_);
+    if (pool_)
+    {
+        if (size_ + count > kMaxPagePoints)
+        {
+            unpool_();
+        }
+        else
+        {
+            // 换一个更长的区间：前段、插入的点、后段依次拷入，再归还旧区间
+            VertexPool::Span old = span_;
+            span_ = pool_->allocate(std::uint32_t(size_ + count));
+            const glm::vec3 *src = pool_->data() + old.offset;
+            glm::vec3 *dst = poolData_();
+            dst = std::copy(src, src + pos, dst);
+            dst = std::copy(pts, pts + count, dst);
+            std::copy(src + pos, src + size_, dst);
+            pool_->release(old);
+            size_ += count;
+            touchPooled_();
+            return;
+        }
+    }
+    if (pages_.empty())
+    {
+        assign(pts, count);
+        return;
+    }
+
+    // 末尾追加落在最后一页；插入只会扩大包围盒，不必重算
+    std::size_t k = pos == size_ ? pages_.size() - 1 : locate_(pos);
+    Page &pg = pages_[k];
+    pg.pts.insert(pg.pts.begin() + (pos - starts_[k]), pts, pts + count);
+    for (std::size_t i = 0; i < count; ++i)
+        pg.bounds.expand(pts[i]);
+    pg.stamp = nextStamp();
+    size_ += count;
+    reindex_(k);
+    split_(k);
+}
+
+void PointPages::erase(std::size_t first, std::size_t count)
+{
+    if (first >= size_ || count == 0)
+        return;
+    count = std::min(count, size_ - first);
+    if (pool_)
+    {
+        // 区间内前移后段，尾部归还给池
+        glm::vec3 *p = poolData_();
+        std::copy(p + first + count, p + size_, p + first);
+        size_ -= count;
+        pool_->release(VertexPool::Span{span_.offset + std::uint32_t(size_), std::uint32_t(count)});
+        span_.count = std::uint32_t(size_);
+        touchPooled_();
+        return;
+    }
+
+    std::size_t k = locate_(first);
+    std::size_t offset = first - starts_[k];
+    std::size_t p = k, left = count;
+    while (left > 0)
+    {
+        Page &pg = pages_[p];
+        std::size_t n = std::min(left, pg.pts.size() - offset);
+        pg.pts.erase(pg.pts.begin() + offset, pg.pts.begin() + (offset + n));
+        left -= n;
+        offset = 0;
+        if (pg.pts.empty())
+        {
+            pages_.erase(pages_.begin() + p);
+        }
+        else
+        {
+            touch_(p);
+            ++p;
+        }
+    }
+    size_ -= count;
+    reindex_(std::min(k, pages_.size()));
+
+    // 删除区间两端的页可能变得过小：先处理靠后的一页，前面的下标不受影响
+    std::size_t last = p > 0 ? p - 1 : 0;
+    if (last < pages_.size())
+        rebalance_(last);
+    if (k < last && k < pages_.size())
+        rebalance_(k);
+}
+
+void PointPages::split_(std::size_t k)
+{
+    if (pages_[k].pts.size() <= kMaxPagePoints)
+        return;
+
+    // 均分为若干接近 kPagePoints 的页，避免拆出很小的尾页
+    std::vector<glm::vec3> all = std::move(pages_[k].pts);
+    std::size_t pieces = (all.size() + kPagePoints - 1) / kPagePoints;
+    std::vector<Page> parts(pieces);
+    for (std::size_t i = 0; i < pieces; ++i)
+    {
+        std::size_t begin = all.size() * i / pieces, end = all.size() * (i + 1) / pieces;
+        parts[i].pts.assign(all.begin() + begin, all.begin() + end);
+    }
+    pages_.erase(pages_.begin() + k);
+    pages_.insert(pages_.begin() + k, std::make_move_iterator(parts.begin()), std::make_move_iterator(parts.end()));
+    for (std::size_t i = 0; i < pieces; ++i)
+        touch_(k + i);
+    reindex_(k);
+}
+
+void PointPages::rebalance_(std::size_t k)
+{
+    if (pages_.size() < 2 || pages_[k].pts.size() >= kMinPagePoints)
+        return;
+
+    // 与后一页合并；末页与前一页合并
+    std::size_t a = k + 1 < pages_.size() ? k : k - 1;
+    std::vector<glm::vec3> &dst = pages_[a].pts;
+    const std::vector<glm::vec3> &src = pages_[a + 1].pts;
+    dst.insert(dst.end(), src.begin(), src.end());
+    pages_.erase(pages_.begin() + (a + 1));
+    touch_(a);
+    reindex_(a);
+    split_(a);
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+#include <glm/glm.hpp>
+#include "spatialindex.h"
+#include "vertexpool.h"
+
+// ============================================
+// PointPages - 分页的点序列（大折线的顶点表）
+// 点按顺序存放在若干页里，每页缓存自己的包围盒与一个全局唯一的戳记（内容变化时换新）。
+// 页目录按起始下标二分定位：中间插入 / 删除只移动所在页内的点与目录项，
+// 不再整体搬移、重新分配上百万个点；超过 kMaxPagePoints 的页对半拆分，过小的页与邻页合并。
+// 渲染器按戳记判断哪些页变了，只重新上传这些页；包围盒用于逐页裁剪与距离查询剪枝。
+//
+// 池模式：不超过 kMaxPagePoints 个点的序列可以放进 VertexPool（moveToPool），此时只有一页，
+// 点在池的 [span.offset, span.offset + size) 中，对象本身不持有堆内存。
+// 池中的区间由持有池的一方管理：析构不归还区间；赋值前目标须先 releasePooled（断言检查）；
+// 拷贝总是得到自持的一页（不与池共享）。池模式下插入后超过 kMaxPagePoints 时自动转回分页
+// ============================================
+class PointPages {
+public:
+    static constexpr std::size_t kPagePoints = 1024;     // 整段构造时的页大小
+    static constexpr std::size_t kMaxPagePoints = 2048;  // 插入后超过则拆分
+    static constexpr std::size_t kMinPagePoints = 256;   // 删除后少于则与邻页合并
+
+    // 一页的只读视图；pts 在下一次修改前有效
+    struct PageView {
+        const glm::vec3* pts = nullptr;
+        std::size_t count = 0;
+        Aabb bounds;
+        std::uint64_t stamp = 0;  // 内容戳记：同一戳记的页内容一定相同（拷贝保留戳记）
+
+        const glm::vec3* begin() const { return pts; }
+        const glm::vec3* end() const { return pts + count; }
+        const glm::vec3& front() const { return pts[0]; }
+        const glm::vec3& back() const { return pts[count - 1]; }
+    };
+
+    PointPages() = default;
+    PointPages(const std::vector<glm::vec3>& pts) { assign(pts.data(), pts.size()); }
+    PointPages(const PointPages& o);
+    PointPages(PointPages&& o) noexcept;
+    PointPages& operator=(const PointPages& o);
+    PointPages& operator=(PointPages&& o) noexcept;
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // 随机访问：二分定位页，O(log 页数)
+    const glm::vec3& operator[](std::size_t i) const;
+    const glm::vec3& front() const { return (*this)[0]; }
+    const glm::vec3& back() const { return (*this)[size_ - 1]; }
+
+    std::size_t pageCount() const { return pool_ ? (size_ > 0 ? 1 : 0) : pages_.size(); }
+    PageView page(std::size_t k) const;
+    std::size_t pageStart(std::size_t k) const { return pool_ ? 0 : starts_[k]; }
+    // 所有页包围盒的并
+    Aabb bounds() const;
+
+    // 整段替换 / 原地覆写 [first, first + count) / 插入到 pos 之前 / 删除 [first, first + count)
+    void assign(const glm::vec3* pts, std::size_t count);
+    void write(std::size_t first, const glm::vec3* pts, std::size_t count);
+    void insert(std::size_t pos, const glm::vec3* pts, std::size_t count);
+    void erase(std::size_t first, std::size_t count);
+    void push_back(const glm::vec3& p) { insert(size_, &p, 1); }
+
+    std::vector<glm::vec3> toVector() const;
+
+    // 池模式：把点搬进 pool（已在该池或点数超过 kMaxPagePoints 时不动）/ 归还池中的区间并清空
+    void moveToPool(VertexPool& pool);
+    void releasePooled();
+    bool pooled() const { return pool_ != nullptr; }
+    // 池中的区间（非池模式为 nullptr），仅供 VertexPool::compact 改写偏移
+    VertexPool::Span* poolSpan() { return pool_ ? &span_ : nullptr; }
+    // 整块拷贝池时用：poolCopy 是 src 所在池的逐字拷贝，池模式的 src 直接指向 poolCopy 中的同一区间，
+    // 否则为普通拷贝
+    static PointPages inPoolCopy(const PointPages& src, VertexPool& poolCopy);
+
+    // 顺序遍历（逐页推进，不做二分）
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = glm::vec3;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const glm::vec3*;
+        using reference = const glm::vec3&;
+
+        const_iterator() = default;
+        const_iterator(const PointPages* owner, std::size_t page) : owner_(owner), page_(page) { load_(); }
+
+        reference operator*() const { return *cur_; }
+        pointer operator->() const { return cur_; }
+        const_iterator& operator++()
+        {
+            if (++cur_ == end_) {
+                ++page_;
+                load_();
+            }
+            return *this;
+        }
+        const_iterator operator++(int) { const_iterator t = *this; ++*this; return t; }
+        bool operator==(const const_iterator& o) const { return page_ == o.page_ && cur_ == o.cur_; }
+        bool operator!=(const const_iterator& o) const { return !(*this == o); }
+
+    private:
+        void load_()
+        {
+            cur_ = end_ = nullptr;
+            if (page_ < owner_->pageCount()) {
+                PageView v = owner_->page(page_);
+                cur_ = v.pts;
+                end_ = v.pts + v.count;
+            }
+        }
+
+        const PointPages* owner_ = nullptr;
+        std::size_t page_ = 0;
+        const glm::vec3* cur_ = nullptr;
+        const glm::vec3* end_ = nullptr;
+    };
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, pageCount()); }
+
+private:
+    struct Page {
+        std::vector<glm::vec3> pts;
+        Aabb bounds;
+        std::uint64_t stamp = 0;
+    };
+
+    glm::vec3* poolData_() const { return pool_->data() + span_.offset; }
+    void touchPooled_();                         // 池模式的 touch_
+    void unpool_();                              // 池模式转回自持的一页
+    std::size_t locate_(std::size_t i) const;    // 包含下标 i 的页
+    void touch_(std::size_t k);                  // 页内容变化：重算包围盒、换新戳记
+    void split_(std::size_t k);
+    void rebalance_(std::size_t k);
+    void reindex_(std::size_t from);             // 重建 starts_[from..]
+
+    std::vector<Page> pages_;
+    std::vector<std::size_t> starts_;  // 每页首点的全局下标
+    std::size_t size_ = 0;
+
+    // 池模式：pages_ / starts_ 为空，唯一一页的包围盒与戳记存在这里
+    VertexPool* pool_ = nullptr;
+    VertexPool::Span span_;
+    Aabb poolBounds_;
+    std::uint64_t poolStamp_ = 0;
+};
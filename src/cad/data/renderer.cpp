@@ -1,5 +1,40 @@
 #include "renderer.h"
+#include <QOpenGLContext>
 #include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+// 每个 arena 的顶点容量（16 字节/顶点，约 16 MB）
+static constexpr std::uint32_t kArenaVertices = 1u << 20;
+// 每帧整理最多搬动的字节数
+static constexpr std::size_t kCompactBytesPerFrame = 1u << 20;
+// 曲线实例的最大分段数（与 CPU 细分的上限一致），每实例绘制 kCurveMaxSegments + 1 个顶点
+static constexpr int kCurveMaxSegments = 360;
+// 预览层初始容量：够放一个 360 段的圆（按线段展开），不够时 uploadPreview_ 倍增
+static constexpr GLsizei kPreviewVertices = 1024;
+// 即时模式画线的流式环形缓冲初始容量（不够时自动扩容）
+static constexpr GLsizeiptr kStreamBytes = 1 << 20;
+// 上传暂存环容量（4 段）：单次暂存不超过一段，更大的写入按段切块
+static constexpr GLsizeiptr kStagingBytes = 16 << 20;
+// 宽线模式下裁剪结果不超过这么多个分配时逐个绘制，否则拼接到收集缓冲后一次绘制
+static constexpr std::size_t kWideSubsetRanges = 256;
+// CPU 细分的重新细分阈值（相对细分尺度）：放大到 0.75 倍以下才加密，缩小到 4 倍以上才放疏；
+// 细分尺度取 2 的幂，加密后尺度减半，来回缩放不会在同一阈值两侧反复细分
+static constexpr float kRetessRefine = 0.75f;
+static constexpr float kRetessCoarsen = 4.0f;
+// 每帧至少重新细分的曲线数，预算极小时也能推进
+static constexpr std::size_t kRetessMinPerFrame = 16;
+// 并行打包时每个分片至少的实体数；不足两片时直接在调用线程上打包
+static constexpr std::size_t kPackShardMin = 2048;
+// 后台上传的门槛：全量重建的顶点数据不足时同步上传更快，也不会短暂显示旧几何
+static constexpr std::size_t kAsyncUploadMinBytes = 8u << 20;
+// 一次同步中变更的实体达到该数量且超过文档的一半时，按全量重建处理以便后台上传
+static constexpr std::size_t kAsyncRebuildMinEntities = 50000;
 
 bool Renderer::initialize()
 {
@@ -12,13 +47,155 @@ bool Renderer::initialize()
             "shaders/cadshaders/line/line.vs",
             "shaders/cadshaders/line/line.fs");
 
-        if (!shaderLines_ || shaderLines_->ID == 0)
+        shaderBatch_ = std::make_unique<Shader>(
+            "shaders/cadshaders/line/batch.vs",
+            "shaders/cadshaders/line/batch.fs");
+
+        shaderCurve_ = std::make_unique<Shader>(
+            "shaders/cadshaders/line/curve.vs",
+            "shaders/cadshaders/line/batch.fs");
+
+        shaderBatchPick_ = std::make_unique<Shader>(
+            "shaders/cadshaders/line/batch.vs",
+            "shaders/cadshaders/line/pick.fs");
+
+        shaderCurvePick_ = std::make_unique<Shader>(
+            "shaders/cadshaders/line/curve.vs",
+            "shaders/cadshaders/line/pick.fs");
+
+        shaderCube_ = std::make_unique<Shader>(
+            "shaders/cadshaders/cube/cube.vs",
+            "shaders/cadshaders/cube/cube.fs");
+
+        shaderCubePick_ = std::make_unique<Shader>(
+            "shaders/cadshaders/cube/cube.vs",
+            "shaders/cadshaders/line/pick.fs");
+
+        shaderWideLine_ = std::make_unique<Shader>(
+            "shaders/cadshaders/line/wideline.vs",
+            "shaders/cadshaders/line/wideline.fs");
+
+        shaderWideCurve_ = std::make_unique<Shader>(
+            "shaders/cadshaders/line/curvewide.vs",
+            "shaders/cadshaders/line/wideline.fs");
+
+        shaderWideLinePick_ = std::make_unique<Shader>(
+            "shaders/cadshaders/line/wideline.vs",
+            "shaders/cadshaders/line/pick.fs");
+
+        shaderWideCurvePick_ = std::make_unique<Shader>(
+            "shaders/cadshaders/line/curvewide.vs",
+            "shaders/cadshaders/line/pick.fs");
+
+        if (!shaderLines_ || shaderLines_->ID == 0 || !shaderBatch_ || shaderBatch_->ID == 0 ||
+            !shaderCurve_ || shaderCurve_->ID == 0 ||
+            !shaderBatchPick_ || shaderBatchPick_->ID == 0 || !shaderCurvePick_ || shaderCurvePick_->ID == 0 ||
+            !shaderCube_ || shaderCube_->ID == 0 || !shaderCubePick_ || shaderCubePick_->ID == 0 ||
+            !shaderWideLine_ || shaderWideLine_->ID == 0 || !shaderWideCurve_ || shaderWideCurve_->ID == 0 ||
+            !shaderWideLinePick_ || shaderWideLinePick_->ID == 0 || !shaderWideCurvePick_ || shaderWideCurvePick_->ID == 0)
         {
             qCritical() << "Failed to create shader program";
             return false;
         }
         qDebug() << "Renderer initialized successfully with custom Shader";
-        qDebug() << "Shader ID:" << shaderLines_->ID;
+        qDebug() << "Shader ID:" << shaderLines_->ID << shaderBatch_->ID << shaderCurve_->ID;
+
+        // 上传暂存环：后面所有缓冲写入（属性表、实例、缓冲堆、相机、预览）都经它拷贝
+        staging_.initialize(kStagingBytes);
+        qDebug() << "Renderer staging ring:" << (staging_.persistent() ? "persistent mapping" : "per-write mapping");
+
+        // 常量 uniform 只设置一次；逐次变化的取缓存位置
+        lineColorLoc_ = shaderLines_->uniform("color");
+        for (Shader *s : {shaderCurve_.get(), shaderCurvePick_.get(), shaderWideCurve_.get(), shaderWideCurvePick_.get()})
+        {
+            s->use();
+            s->setInt(s->uniform("maxSegments"), kCurveMaxSegments);
+        }
+        for (Shader *s : {shaderBatch_.get(), shaderCurve_.get(), shaderBatchPick_.get(), shaderCurvePick_.get(),
+                          shaderCube_.get(), shaderCubePick_.get(), shaderWideLine_.get(), shaderWideCurve_.get(),
+                          shaderWideLinePick_.get(), shaderWideCurvePick_.get()})
+        {
+            s->use();
+            s->setInt(s->uniform("entityAttr"), 0);  // 纹理单元 0
+        }
+        wideLineWidthLoc_ = shaderWideLine_->uniform("lineWidth");
+        shaderWideLinePick_->use();
+        shaderWideLinePick_->setFloat(shaderWideLinePick_->uniform("lineWidth"), 1.0f);
+
+        colorPass_ = PassPrograms{shaderBatch_.get(), shaderCurve_.get(), shaderCube_.get(),
+                                  shaderWideLine_.get(), shaderWideCurve_.get(), true};
+        pickPass_ = PassPrograms{shaderBatchPick_.get(), shaderCurvePick_.get(), shaderCubePick_.get(),
+                                 shaderWideLinePick_.get(), shaderWideCurvePick_.get(), false};
+        glUseProgram(0);
+
+        // 实体属性表：RG32UI 纹理缓冲，按拾取键（实体下标 + 1）索引
+        // 后台上传期间上一代用自己的一份（retiredAttr_），开始上传时两份交换
+        initAttrTable_(attr_);
+        initAttrTable_(retiredAttr_);
+
+        // 相机 uniform block：所有程序在链接时绑定到 Shader::kCameraBinding
+        glGenBuffers(1, &cameraUbo_);
+        glBindBuffer(GL_UNIFORM_BUFFER, cameraUbo_);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, Shader::kCameraBinding, cameraUbo_);
+        cameraValid_ = false;
+
+        heaps_[0].initialize(GL_LINES, false, kArenaVertices);
+        heaps_[1].initialize(GL_LINE_STRIP, false, kArenaVertices);
+        retiredHeaps_[0].initialize(GL_LINES, false, kArenaVertices);
+        retiredHeaps_[1].initialize(GL_LINE_STRIP, false, kArenaVertices);
+        for (int i = 0; i < 2; ++i)
+        {
+            heaps_[i].setStaging(&staging_);
+            retiredHeaps_[i].setStaging(&staging_);
+        }
+        initInstanceBatches_();
+
+        glGenVertexArrays(1, &previewVao_);
+        glGenBuffers(1, &previewVbo_);
+        glBindVertexArray(previewVao_);
+        glBindBuffer(GL_ARRAY_BUFFER, previewVbo_);
+        glBufferData(GL_ARRAY_BUFFER, kPreviewVertices * sizeof(BatchVertex), nullptr, GL_DYNAMIC_DRAW);
+        previewCapacity_ = kPreviewVertices;
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void *)offsetof(BatchVertex, pos));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BatchVertex), (void *)offsetof(BatchVertex, rgba));
+        glEnableVertexAttribArray(1);
+
+        // 宽线：按顶点对读取线段两端，拾取键不是数组（通用属性常量 0）
+        glGenVertexArrays(1, &previewSegVao_);
+        glBindVertexArray(previewSegVao_);
+        const GLsizei pairStride = 2 * sizeof(BatchVertex);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, pairStride, (void *)offsetof(BatchVertex, pos));
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, pairStride, (void *)offsetof(BatchVertex, rgba));
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, pairStride, (void *)(sizeof(BatchVertex) + offsetof(BatchVertex, pos)));
+        for (GLuint loc : {0u, 1u, 3u})
+        {
+            glEnableVertexAttribArray(loc);
+            glVertexAttribDivisor(loc, 1);
+        }
+        glBindVertexArray(0);
+        previewCount_ = 0;
+
+        // 即时模式画线：常驻 VAO 以偏移 0 绑定环形缓冲，绘制时用 first 定位
+        stream_.initialize(kStreamBytes);
+        glGenVertexArrays(1, &streamVao_);
+        glBindVertexArray(streamVao_);
+        glBindBuffer(GL_ARRAY_BUFFER, stream_.buffer());
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PosVertex), (void *)0);
+        glEnableVertexAttribArray(0);
+
+        // 宽线：两端位置按实例读取，偏移在每次绘制时按 first 重设；颜色与键为通用属性常量
+        glGenVertexArrays(1, &streamSegVao_);
+        glBindVertexArray(streamSegVao_);
+        for (GLuint loc : {0u, 3u})
+        {
+            glEnableVertexAttribArray(loc);
+            glVertexAttribDivisor(loc, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
         return true;
     }
@@ -31,53 +208,552 @@ bool Renderer::initialize()
 
 void Renderer::shutdown()
 {
-    // 清理所有批次
-    for (auto &kv : batches_)
-    {
-        freeBatch_(kv.second);
-    }
-    batches_.clear();
+    // 清理所有批次；重新初始化后需要全量同步
+    setBackgroundUpload(false);
+    rebuildRequested_ = false;
+    clearBatches_();
+    cursor_ = ChangeCursor{};
+    doc_ = nullptr;
+    for (auto &heap : heaps_)
+        heap.shutdown();
+    for (auto &heap : retiredHeaps_)
+        heap.shutdown();
+    freeInstanceBatch_(curves_);
+    freeInstanceBatch_(boxes_);
+    freeInstanceBatch_(retiredCurves_);
+    freeInstanceBatch_(retiredBoxes_);
+    if (boxMeshVbo_)
+        glDeleteBuffers(1, &boxMeshVbo_);
+    if (boxMeshIbo_)
+        glDeleteBuffers(1, &boxMeshIbo_);
+    boxMeshVbo_ = boxMeshIbo_ = 0;
+    freePickTarget_();
+    freeLayerTarget_();
+    attr_.pickIds.clear();
+    overlaySet_.clear();
+
+    if (previewVbo_)
+        glDeleteBuffers(1, &previewVbo_);
+    if (previewVao_)
+        glDeleteVertexArrays(1, &previewVao_);
+    if (previewSegVao_)
+        glDeleteVertexArrays(1, &previewSegVao_);
+    previewVao_ = previewVbo_ = previewSegVao_ = 0;
+    previewCount_ = previewCapacity_ = 0;
+
+    freeAttrTable_(attr_);
+    freeAttrTable_(retiredAttr_);
+
+    if (cameraUbo_)
+        glDeleteBuffers(1, &cameraUbo_);
+    cameraUbo_ = 0;
+    cameraValid_ = false;
+
+    if (streamVao_)
+        glDeleteVertexArrays(1, &streamVao_);
+    if (streamSegVao_)
+        glDeleteVertexArrays(1, &streamSegVao_);
+    streamVao_ = streamSegVao_ = 0;
+    stream_.shutdown();
+    // 缓冲堆已经关闭（待提交的写入随之丢弃），暂存环最后释放
+    staging_.shutdown();
 
     // ✅ Shader 通过 unique_ptr 自动清理
     shaderLines_.reset();
+    shaderBatch_.reset();
+    shaderCurve_.reset();
+    shaderBatchPick_.reset();
+    shaderCurvePick_.reset();
+    shaderCube_.reset();
+    shaderCubePick_.reset();
+    shaderWideLine_.reset();
+    shaderWideCurve_.reset();
+    shaderWideLinePick_.reset();
+    shaderWideCurvePick_.reset();
+    colorPass_ = pickPass_ = PassPrograms{};
 
     qDebug() << "Renderer shutdown complete";
 }
-GLuint Renderer::makeVao(GLuint vbo, GLuint ibo)
+// ============================================
+// GPU 缓冲堆
+// ============================================
+
+void Renderer::putRange_(std::uint8_t heap, EntityId id, const BatchVertex *v, std::size_t n,
+                         const GLuint *idx, std::size_t ni)
+{
+    GpuBufferHeap &h = heaps_[heap];
+
+    auto it = ranges_.find(id);
+    if (it != ranges_.end())
+    {
+        const HeapRange &r = it->second;
+        if (r.heap == heap && h.vertexCount(r.handle) == n && h.indexCount(r.handle) == ni)
+        {
+            // 尺寸不变（拖拽画线、移动、改色）：原地覆写
+            h.writeVertices(r.handle, v, std::uint32_t(n));
+            if (ni)
+                h.writeIndices(r.handle, idx, std::uint32_t(ni));
+            return;
+        }
+        releaseRange_(id);
+    }
+    // 折线删点后不足两页：换回单个分配
+    releasePages_(id);
+
+    GpuBufferHeap::Handle handle = h.allocate(std::uint32_t(n), std::uint32_t(ni));
+    if (handle == GpuBufferHeap::kInvalid)
+        return;
+    h.writeVertices(handle, v, std::uint32_t(n));
+    if (ni)
+        h.writeIndices(handle, idx, std::uint32_t(ni));
+    // 原地写入时实体不变，拾取键只在新分配时写一次
+    h.writePickId(handle, pickKey_(id));
+    ranges_[id] = HeapRange{heap, handle};
+}
+
+void Renderer::releaseRange_(EntityId id)
+{
+    releasePages_(id);
+    auto it = ranges_.find(id);
+    if (it == ranges_.end())
+        return;
+    heaps_[it->second.heap].release(it->second.handle);
+    ranges_.erase(it);
+}
+
+void Renderer::putPages_(EntityId id, const Polyline &P, std::uint32_t rgba)
+{
+    GpuBufferHeap &h = heaps_[1];
+    auto single = ranges_.find(id);
+    if (single != ranges_.end())
+    {
+        heaps_[single->second.heap].release(single->second.handle);
+        ranges_.erase(single);
+    }
+
+    // 旧页按戳记排序后查找：中间插入 / 删除会让后面的页整体错位，但戳记不变
+    std::vector<PageRange> &pages = pageRanges_[id];
+    std::vector<PageRange> old = std::move(pages);
+    std::sort(old.begin(), old.end(),
+              [](const PageRange &a, const PageRange &b) { return a.stamp < b.stamp; });
+
+    const std::size_t n = P.pts.pageCount();
+    const std::uint32_t key = pickKey_(id);
+    pages.assign(n, PageRange{});
+    for (std::size_t k = 0; k < n; ++k)
+    {
+        PointPages::PageView pg = P.pts.page(k);
+        PageRange &pr = pages[k];
+        pr.stamp = pg.stamp;
+        pr.hasConnector = k + 1 < n || P.closed;
+        if (pr.hasConnector)
+            pr.connector = k + 1 < n ? P.pts.page(k + 1).front() : P.pts.front();
+
+        auto it = std::lower_bound(old.begin(), old.end(), pg.stamp,
+                                   [](const PageRange &a, std::uint64_t s) { return a.stamp < s; });
+        if (it != old.end() && it->stamp == pg.stamp && it->handle != GpuBufferHeap::kInvalid &&
+            it->hasConnector == pr.hasConnector &&
+            (!pr.hasConnector || it->connector == pr.connector))
+        {
+            pr.handle = it->handle;
+            pr.bounds = it->bounds;
+            it->handle = GpuBufferHeap::kInvalid;
+            continue;
+        }
+
+        pageScratch_.clear();
+        for (const glm::vec3 &p : pg)
+            pageScratch_.push_back({p, rgba});
+        pr.bounds = pg.bounds;
+        if (pr.hasConnector)
+        {
+            pageScratch_.push_back({pr.connector, rgba});
+            pr.bounds.expand(pr.connector);
+        }
+        // 末尾的终止顶点（键 0）断开与下一个分配的连线；颜色取全透明，
+        // 宽线整段绘制时它与后面填零的空闲顶点之间也不会连出线段
+        pageScratch_.push_back({pageScratch_.back().pos, 0u});
+
+        std::uint32_t count = std::uint32_t(pageScratch_.size());
+        pr.handle = h.allocate(count);
+        if (pr.handle == GpuBufferHeap::kInvalid)
+            continue;
+        h.writeVertices(pr.handle, pageScratch_.data(), count);
+        h.writePickId(pr.handle, key, 0, count - 1);
+        h.writePickId(pr.handle, 0, count - 1, 1);
+        ++stats_.pagesUploaded;
+    }
+
+    for (const PageRange &pr : old)
+    {
+        if (pr.handle != GpuBufferHeap::kInvalid)
+            h.release(pr.handle);
+    }
+}
+
+void Renderer::releasePages_(EntityId id)
+{
+    if (pageRanges_.empty())
+        return;
+    auto it = pageRanges_.find(id);
+    if (it == pageRanges_.end())
+        return;
+    for (const PageRange &pr : it->second)
+    {
+        if (pr.handle != GpuBufferHeap::kInvalid)
+            heaps_[1].release(pr.handle);
+    }
+    pageRanges_.erase(it);
+}
+
+void Renderer::patchEntities_(const Document &doc)
+{
+    if (patched_.empty())
+        return;
+    std::sort(patched_.begin(), patched_.end(),
+              [](const Change &a, const Change &b) { return a.id < b.id; });
+
+    // touched_ 已排序去重；整体改动过的实体不再单独改写
+    const std::size_t wholeCount = touched_.size();
+    for (auto &heap : heaps_)
+        heap.beginWrites();
+    for (std::size_t i = 0; i < patched_.size();)
+    {
+        // 同一实体的多段区间取并集（count == 0 为几何未变）
+        EntityId id = patched_[i].id;
+        std::uint32_t lo = std::numeric_limits<std::uint32_t>::max(), hi = 0;
+        for (; i < patched_.size() && patched_[i].id == id; ++i)
+        {
+            const Change &c = patched_[i];
+            if (c.count == 0)
+                continue;
+            lo = std::min(lo, c.first);
+            hi = std::max(hi, c.first + c.count);
+        }
+        if (lo > hi)
+            lo = hi = 0;
+
+        if (std::binary_search(touched_.begin(), touched_.begin() + wholeCount, id))
+            continue;
+        if (!patchVertices_(doc, id, lo, hi))
+            touched_.push_back(id);
+    }
+    for (auto &heap : heaps_)
+        heap.endWrites();
+}
+
+bool Renderer::patchVertices_(const Document &doc, EntityId id, std::uint32_t first, std::uint32_t end)
+{
+    auto it = ranges_.find(id);
+    if (it == ranges_.end())
+        return false;
+    const HeapRange range = it->second;
+    GpuBufferHeap &heap = heaps_[range.heap];
+
+    bool patched = false;
+    doc.visit(id, [&](const auto &g, const Style &s, bool visible)
+              {
+        using G = std::decay_t<decltype(g)>;
+        glm::vec3 ends[2];
+        const glm::vec3 *pts = nullptr;
+        std::size_t n = 0;
+        bool closed = false;
+        std::uint8_t expectHeap = 0;
+        if constexpr (std::is_same_v<G, Line>)
+        {
+            ends[0] = g.p0;
+            ends[1] = g.p1;
+            pts = ends;
+            n = 2;
+        }
+        else if constexpr (std::is_same_v<G, Polyline>)
+        {
+            // 多页折线不在 ranges_ 中，走整体重新打包（只上传戳记变化的页）
+            if (g.pts.pageCount() != 1)
+                return;
+            pts = g.pts.page(0).pts;
+            n = g.pts.size();
+            closed = g.closed;
+            expectHeap = 1;
+        }
+        else
+        {
+            return;
+        }
+
+        // 分配须与打包时的布局一致：直线是线段堆里的 2 个顶点，折线是线带堆里的点列，闭合时末尾补一个起点
+        if (range.heap != expectHeap || heap.vertexCount(range.handle) != n + (closed ? 1 : 0) || end > n)
+            return;
+        writeAttr_(id, s, visible);
+        patched = true;
+        if (first >= end)
+            return;
+
+        patchScratch_.clear();
+        for (std::uint32_t i = first; i < end; ++i)
+            patchScratch_.push_back({pts[i], s.rgba});
+        heap.writeVertices(range.handle, patchScratch_.data(), end - first, first);
+        if (closed && first == 0)
+        {
+            BatchVertex closing{pts[0], s.rgba};
+            heap.writeVertices(range.handle, &closing, 1, std::uint32_t(n));
+        }
+        ++stats_.entitiesPatched; });
+    return patched;
+}
+
+// ============================================
+// 实例批次（圆 / 圆弧、立方体）
+// ============================================
+
+// 单位立方体：每个面 4 个顶点各带面法线，光照不会在棱上插值成圆角
+struct BoxMeshVertex {
+    glm::vec3 pos;
+    glm::vec3 normal;
+};
+
+static void buildUnitCube(BoxMeshVertex (&v)[24], GLuint (&idx)[36])
+{
+    static const glm::vec3 normals[6] = {
+        {0, 0, -1}, {0, 0, 1}, {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}};
+    for (int f = 0; f < 6; ++f)
+    {
+        // 面内两轴 u × w = n，保证逆时针为正面
+        glm::vec3 n = normals[f];
+        glm::vec3 u = std::abs(n.y) > 0.5f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+        glm::vec3 w = glm::cross(n, u);
+        u = glm::cross(w, n);
+        glm::vec3 c = n * 0.5f;
+        v[f * 4 + 0] = {c - u * 0.5f - w * 0.5f, n};
+        v[f * 4 + 1] = {c + u * 0.5f - w * 0.5f, n};
+        v[f * 4 + 2] = {c + u * 0.5f + w * 0.5f, n};
+        v[f * 4 + 3] = {c - u * 0.5f + w * 0.5f, n};
+
+        const GLuint b = GLuint(f * 4);
+        const GLuint quad[6] = {b, b + 1, b + 2, b, b + 2, b + 3};
+        std::copy(quad, quad + 6, idx + f * 6);
+    }
+}
+
+void Renderer::initInstanceBatches_()
+{
+    BoxMeshVertex cube[24];
+    GLuint cubeIdx[36];
+    buildUnitCube(cube, cubeIdx);
+    glGenBuffers(1, &boxMeshVbo_);
+    glBindBuffer(GL_ARRAY_BUFFER, boxMeshVbo_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(cube), cube, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glGenBuffers(1, &boxMeshIbo_);
+
+    // 后台上传期间上一代的曲线 / 盒子留在 retired 批次里继续显示，两组各有一套缓冲
+    for (CurveBatch *b : {&curves_, &retiredCurves_})
+    {
+        *b = CurveBatch{};
+        glGenBuffers(1, &b->vbo);
+        glGenVertexArrays(1, &b->vao);
+        setupCurveVao_(b->vao, b->vbo);
+        glGenBuffers(1, &b->cullVbo);
+        glGenVertexArrays(1, &b->cullVao);
+        setupCurveVao_(b->cullVao, b->cullVbo);
+    }
+
+    for (BoxBatch *b : {&boxes_, &retiredBoxes_})
+    {
+        *b = BoxBatch{};
+        glGenBuffers(1, &b->vbo);
+        glGenVertexArrays(1, &b->vao);
+        setupBoxVao_(b->vao, b->vbo);
+        glGenBuffers(1, &b->cullVbo);
+        glGenVertexArrays(1, &b->cullVao);
+        setupBoxVao_(b->cullVao, b->cullVbo);
+    }
+    // 索引缓冲的绑定属于 VAO 状态：第一个 VAO 绑定后再上传
+    glBindVertexArray(boxes_.vao);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIdx), cubeIdx, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+}
+
+void Renderer::setupCurveVao_(GLuint vao, GLuint vbo)
 {
-    GLuint vao = 0;
-    glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PosVertex), (void *)0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(CurveInstance), (void *)offsetof(CurveInstance, centerRadius));
     glEnableVertexAttribArray(0);
-    if (ibo)
-    {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    }
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(CurveInstance), (void *)offsetof(CurveInstance, angles));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CurveInstance), (void *)offsetof(CurveInstance, rgba));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(CurveInstance), (void *)offsetof(CurveInstance, pickId));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer::setupBoxVao_(GLuint vao, GLuint vbo)
+{
+    glBindVertexArray(vao);
+
+    // 逐顶点：共用的单位立方体
+    glBindBuffer(GL_ARRAY_BUFFER, boxMeshVbo_);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BoxMeshVertex), (void *)offsetof(BoxMeshVertex, pos));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(BoxMeshVertex), (void *)offsetof(BoxMeshVertex, normal));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxMeshIbo_);
+
+    // 逐实例
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(BoxInstance), (void *)offsetof(BoxInstance, centerSize));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(BoxInstance), (void *)offsetof(BoxInstance, rotation));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BoxInstance), (void *)offsetof(BoxInstance, rgba));
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+    glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(BoxInstance), (void *)offsetof(BoxInstance, pickId));
+    glEnableVertexAttribArray(5);
+    glVertexAttribDivisor(5, 1);
+
     glBindVertexArray(0);
-    return vao;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void Renderer::freeBatch_(GpuBatch &b)
+template <class T>
+void Renderer::freeInstanceBatch_(InstanceBatch<T> &b)
 {
-    if (b.ibo)
-        glDeleteBuffers(1, &b.ibo), b.ibo = 0;
     if (b.vbo)
-        glDeleteBuffers(1, &b.vbo), b.vbo = 0;
+        glDeleteBuffers(1, &b.vbo);
     if (b.vao)
-        glDeleteVertexArrays(1, &b.vao), b.vao = 0;
-    b.indexCount = 0;
+        glDeleteVertexArrays(1, &b.vao);
+    if (b.cullVbo)
+        glDeleteBuffers(1, &b.cullVbo);
+    if (b.cullVao)
+        glDeleteVertexArrays(1, &b.cullVao);
+    b = InstanceBatch<T>{};
 }
 
-// 修正：RGBA 格式 0xRRGGBBAA
-static glm::vec4 rgbaToVec4(std::uint32_t rgba)
+template <class T>
+static void markInstancesDirty(InstanceBatch<T> &b, std::size_t begin, std::size_t end)
 {
-    float r = ((rgba >> 24) & 0xFF) / 255.0f;
-    float g = ((rgba >> 16) & 0xFF) / 255.0f;
-    float b = ((rgba >> 8) & 0xFF) / 255.0f;
-    float a = ((rgba >> 0) & 0xFF) / 255.0f;
-    return {r, g, b, a};
+    if (b.dirtyBegin == b.dirtyEnd)
+    {
+        b.dirtyBegin = begin;
+        b.dirtyEnd = end;
+    }
+    else
+    {
+        b.dirtyBegin = std::min(b.dirtyBegin, begin);
+        b.dirtyEnd = std::max(b.dirtyEnd, end);
+    }
+}
+
+template <class T>
+void Renderer::putInstance_(InstanceBatch<T> &b, EntityId id, const T &inst)
+{
+    auto it = b.index.find(id);
+    std::size_t i;
+    if (it != b.index.end())
+    {
+        i = it->second;
+        b.instances[i] = inst;
+    }
+    else
+    {
+        i = b.instances.size();
+        b.instances.push_back(inst);
+        b.owners.push_back(id);
+        b.index.emplace(id, std::uint32_t(i));
+    }
+    b.instances[i].pickId = pickKey_(id);
+    markInstancesDirty(b, i, i + 1);
+}
+
+template <class T>
+void Renderer::releaseInstance_(InstanceBatch<T> &b, EntityId id)
+{
+    auto it = b.index.find(id);
+    if (it == b.index.end())
+        return;
+
+    // swap-and-pop：末尾实例搬入空位
+    std::size_t i = it->second;
+    std::size_t last = b.instances.size() - 1;
+    b.index.erase(it);
+    if (i != last)
+    {
+        b.instances[i] = b.instances[last];
+        b.owners[i] = b.owners[last];
+        b.index[b.owners[i]] = std::uint32_t(i);
+        markInstancesDirty(b, i, i + 1);
+    }
+    b.instances.pop_back();
+    b.owners.pop_back();
+
+    // 脏区间不能越过新的末尾
+    b.dirtyEnd = std::min(b.dirtyEnd, b.instances.size());
+    if (b.dirtyBegin >= b.dirtyEnd)
+        b.dirtyBegin = b.dirtyEnd = 0;
+}
+
+template <class T>
+void Renderer::flushInstances_(InstanceBatch<T> &b)
+{
+    if (b.dirtyBegin == b.dirtyEnd)
+        return;
+
+    GLsizeiptr bytes = GLsizeiptr(b.instances.size() * sizeof(T));
+    glBindBuffer(GL_ARRAY_BUFFER, b.vbo);
+    if (bytes > b.capacityBytes)
+    {
+        // 扩容：按 1.5 倍增长，避免频繁重新分配
+        b.capacityBytes = std::max<GLsizeiptr>({bytes, b.capacityBytes * 3 / 2, 64 * 1024});
+        glBufferData(GL_ARRAY_BUFFER, b.capacityBytes, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        staging_.upload(b.vbo, 0, b.instances.data(), bytes);
+        stats_.bytesUploaded += std::uint64_t(bytes);
+    }
+    else
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        GLsizeiptr dirtyBytes = GLsizeiptr((b.dirtyEnd - b.dirtyBegin) * sizeof(T));
+        staging_.upload(b.vbo, GLintptr(b.dirtyBegin * sizeof(T)), b.instances.data() + b.dirtyBegin, dirtyBytes);
+        stats_.bytesUploaded += std::uint64_t(dirtyBytes);
+    }
+    b.dirtyBegin = b.dirtyEnd = 0;
+}
+
+template <class T>
+void Renderer::uploadVisibleInstances_(InstanceBatch<T> &b)
+{
+    if (b.visible.empty())
+        return;
+
+    GLsizeiptr bytes = GLsizeiptr(b.visible.size() * sizeof(T));
+    if (bytes > b.cullCapacityBytes)
+    {
+        b.cullCapacityBytes = std::max<GLsizeiptr>({bytes, b.cullCapacityBytes * 3 / 2, 64 * 1024});
+        glBindBuffer(GL_ARRAY_BUFFER, b.cullVbo);
+        glBufferData(GL_ARRAY_BUFFER, b.cullCapacityBytes, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    // 每帧整体重写：经暂存环在 GPU 上拷贝，排在上一帧的绘制之后，CPU 不等待
+    staging_.upload(b.cullVbo, 0, b.visible.data(), bytes);
+    stats_.bytesUploaded += std::uint64_t(bytes);
+}
+
+void Renderer::setAnalyticCurves(bool on)
+{
+    if (on == analyticCurves_)
+        return;
+    analyticCurves_ = on;
+    rebuildRequested_ = true;
 }
 
 void ViewportState::updateWorldPerPixel()
@@ -267,380 +943,1752 @@ void ViewportState::getFrustumCorners(glm::vec3 corners[8]) const
     }
 }
 
-void Renderer::syncFromDocument(const Document &doc, const ViewportState &vp, bool forceRebuild)
+// ============================================
+// 视锥
+// ============================================
+
+// Gribb-Hartmann：从 proj * view 的行向量组合出 6 个平面（法线指向内侧）
+Frustum Frustum::fromMatrix(const glm::mat4 &m)
 {
-    // 检查是否需要因缩放级别变化而重新细分圆弧
-    bool needRetessellate = forceRebuild ||
-                            (std::abs(vp.worldPerPixel - lastWorldPerPixel_) / vp.worldPerPixel > 0.5f);
+    auto row = [&](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    Frustum f;
+    f.planes[0] = row(3) + row(0); // 左
+    f.planes[1] = row(3) - row(0); // 右
+    f.planes[2] = row(3) + row(1); // 下
+    f.planes[3] = row(3) - row(1); // 上
+    f.planes[4] = row(3) + row(2); // 近
+    f.planes[5] = row(3) - row(2); // 远
+    return f;
+}
 
-    if (needRetessellate)
+int Frustum::classify(const Aabb &b) const
+{
+    int result = 2;
+    for (const glm::vec4 &p : planes)
     {
-        lastWorldPerPixel_ = vp.worldPerPixel;
+        glm::vec3 n(p);
+        // 沿法线方向最远 / 最近的角点
+        glm::vec3 pos(n.x >= 0 ? b.max.x : b.min.x, n.y >= 0 ? b.max.y : b.min.y, n.z >= 0 ? b.max.z : b.min.z);
+        glm::vec3 neg(n.x >= 0 ? b.min.x : b.max.x, n.y >= 0 ? b.min.y : b.max.y, n.z >= 0 ? b.min.z : b.max.z);
+        if (glm::dot(n, pos) + p.w < 0.0f)
+            return 0;
+        if (glm::dot(n, neg) + p.w < 0.0f)
+            result = 1;
     }
+    return result;
+}
+
+Frustum ViewportState::frustum() const
+{
+    return Frustum::fromMatrix(proj * view);
+}
 
-    if (forceRebuild)
+void Renderer::syncFromDocument(const Document &doc, const ViewportState &vp, bool forceRebuild)
+{
+    // 曲线绘制方式切换后，已上传的圆/圆弧需要换到另一条路径
+    if (rebuildRequested_)
     {
-        // 全量重建
-        for (auto &kv : batches_)
-            freeBatch_(kv.second);
-        batches_.clear();
+        forceRebuild = true;
+        rebuildRequested_ = false;
     }
 
-    for (auto *e : doc.all())
+    doc_ = &doc;
+
+    // 拉取自上次同步以来的变更（空闲帧在这里直接返回，代价 O(1)）
+    touched_.clear();
+    restyled_.clear();
+    patched_.clear();
+    bool cleared = false;
+    auto classify = [&](const Change &c)
     {
-        if (!e->visible)
+        if (c.kind == ChangeKind::Cleared)
         {
-            // 隐藏的实体：移除批次
-            if (batches_.count(e->id))
-            {
-                freeBatch_(batches_[e->id]);
-                batches_.erase(e->id);
-            }
-            continue;
+            cleared = true;
+            touched_.clear();
+            restyled_.clear();
+            patched_.clear();
         }
-
-        // 只处理脏实体或需要重新细分的圆弧
-        bool needUpdate = e->dirty;
-        if (!needUpdate && needRetessellate)
+        else if (c.kind == ChangeKind::Restyled)
         {
-            needUpdate = (e->type == EntityType::Circle || e->type == EntityType::Arc);
+            restyled_.push_back(c.id);
         }
-
-        if (!needUpdate && batches_.count(e->id))
+        else if (c.kind == ChangeKind::Modified && !c.wholeGeometry())
         {
-            continue; // 已有批次且无需更新
+            patched_.push_back(c);
         }
-
-        // 删除旧批次
-        if (batches_.count(e->id))
+        else
         {
-            freeBatch_(batches_[e->id]);
-            batches_.erase(e->id);
+            touched_.push_back(c.id);
         }
+    };
 
-        // 上传新批次
-        switch (e->type)
-        {
-        case EntityType::Line:
-        {
-            uploadLine_(e->id, std::get<Line>(e->geom), e->style.rgba);
-        }
-        break;
-        case EntityType::Polyline:
-        {
-            uploadPolyline_(e->id, std::get<Polyline>(e->geom), e->style.rgba);
-        }
-        break;
-        case EntityType::Circle:
-        {
-            uploadCircle_(e->id, std::get<Circle>(e->geom), e->style.rgba, vp);
-        }
-        break;
-        case EntityType::Arc:
-        {
-            uploadArc_(e->id, std::get<Arc>(e->geom), e->style.rgba, vp);
-        }
-        break;
-        case EntityType::Box:
+    bool inSync = !forceRebuild;
+    if (streaming_ && inSync)
+    {
+        // 后台上传未完成：继续显示上一代。变更照常拉取，样式、可见性与删除立即同步到上一代的属性表，
+        // 全部变更暂存到新一代接回之后应用；游标已落后于日志时丢弃这次上传重新开始
+        adoptUploads_();
+        if (streaming_)
         {
-            uploadBox_(e->id, std::get<Box>(e->geom), e->style.rgba);
-        }
-        break;
+            inSync = doc.pullChanges(cursor_, [&](const Change &c)
+                                     {
+                restyleRetired_(doc, c);
+                pendingChanges_.push_back(c); });
+            if (inSync)
+                return;
         }
     }
-}
-
-void Renderer::removeBatch(EntityId id)
-{
-    auto it = batches_.find(id);
-    if (it != batches_.end())
+    if (inSync)
     {
-        freeBatch_(it->second);
-        batches_.erase(it);
+        for (const Change &c : pendingChanges_)
+            classify(c);
+        inSync = doc.pullChanges(cursor_, classify);
     }
-}
+    pendingChanges_.clear();
 
-void Renderer::draw(const ViewportState &vp)
-{
-    if (!shaderLines_)
+    // 大部分实体都变了（大批导入）：按全量重建处理，顶点数据多时可以后台上传
+    if (inSync && uploader_ && touched_.size() >= kAsyncRebuildMinEntities && touched_.size() * 2 >= doc.size())
+        inSync = false;
+
+    if (!inSync)
     {
-        qWarning() << "Shader not initialized";
+        // 全量重建（强制重建或游标已落后于日志保留范围）
+        ++stats_.fullRebuilds;
+        cursor_.version = doc.version();
+        // 隐藏的实体也上传：可见性只是属性表里的一位，切换时不动几何
+        packIds_.clear();
+        packIds_.reserve(doc.size());
+        doc.forEach([this](EntityId id, const auto &, const Style &, bool)
+                    { packIds_.push_back(id); });
+        packEntities_(doc, packIds_, vp);
+
+        std::size_t stagedBytes = 0;
+        for (const PackShard &shard : shards_)
+            stagedBytes += shard.vertices.size() * sizeof(BatchVertex);
+        bool async = uploader_ && stagedBytes >= kAsyncUploadMinBytes;
+        if (async)
+            beginStreaming_();
+        else if (streaming_)
+            cancelStreaming_();
+
+        clearBatches_();
+        commitShards_(shards_.size(), true);
+        if (async)
+            submitStaged_();
         return;
     }
 
-    // 激活着色器
-    shaderLines_->use();
-
-    // 检查当前程序
-    GLint currentProgram;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+    if (cleared)
+    {
+        clearBatches_();
+    }
 
-    // 设置 MVP
-    glm::mat4 model(1.0f);
-    glm::mat4 mvp = vp.proj * vp.view * model;
-    shaderLines_->setMat4("mvp", mvp);
+    // 同一实体的多条变更只处理一次；已删除的实体释放批次
+    std::sort(touched_.begin(), touched_.end());
+    touched_.erase(std::unique(touched_.begin(), touched_.end()), touched_.end());
+    // 局部修改先原地改写，改写不了的追加到 touched_ 整体重新打包
+    patchEntities_(doc);
+    if (!touched_.empty())
+    {
+        packEntities_(doc, touched_, vp);
+        commitShards_(shards_.size(), true);
+    }
 
-    // 绘制所有批次
-    int batchIndex = 0;
-    for (const auto &kv : batches_)
+    // 只改了样式 / 可见性：更新属性表的一项，几何不动。
+    // CPU 细分模式下隐藏的曲线出队时被跳过，重新显示时细分尺度可能已过时，补进重新细分队列
+    for (EntityId id : restyled_)
     {
-        const GpuBatch &batch = kv.second;
+        doc.visit(id, [&](const auto &g, const Style &s, bool visible)
+                  {
+            std::uint32_t key = entityIndex(id) + 1;
+            bool wasVisible = key < attr_.pickIds.size() && attr_.pickIds[key] == id &&
+                              (attr_.attrs[key].flags & kEntityVisible) != 0;
+            writeAttr_(id, s, visible);
+
+            using G = std::decay_t<decltype(g)>;
+            if constexpr (std::is_same_v<G, Circle> || std::is_same_v<G, Arc>)
+            {
+                float err = !analyticCurves_ && visible && !wasVisible ? retessError_(id, vp.worldPerPixel) : 0.0f;
+                if (err > 0.0f)
+                    retessQueue_.emplace_back(err, id);
+            } });
+    }
 
-        if (batch.indexCount == 0)
+    // CPU 细分模式：相机变化后只检查视野内的圆与圆弧（解析曲线由 GPU 展开，缩放无需任何 CPU 工作），
+    // 重新细分在预算内分摊到之后的若干帧
+    glm::mat4 viewProj = vp.proj * vp.view;
+    if (!analyticCurves_)
+    {
+        if (viewProj != lastViewProj_)
         {
-            continue;
+            lastViewProj_ = viewProj;
+            queueRetessellation_(doc, vp);
         }
+        if (retessellatePending())
+            retessellateQueued_(doc, vp);
+    }
 
-        if (batch.vao == 0)
-        {
-            continue;
-        }
+    // 每帧搬动有限字节，逐步消除删除留下的碎片
+    for (auto &heap : heaps_)
+        heap.compact(kCompactBytesPerFrame);
+}
 
-        // 设置颜色
-        float r = ((batch.rgba >> 24) & 0xFF) / 255.0f;
-        float g = ((batch.rgba >> 16) & 0xFF) / 255.0f;
-        float b = ((batch.rgba >> 8) & 0xFF) / 255.0f;
-        float a = ((batch.rgba) & 0xFF) / 255.0f;
+// ============================================
+// 同步：CPU 打包阶段与 GL 提交阶段
+// ============================================
 
-        shaderLines_->setVec4("color", glm::vec4(r, g, b, a));
-        glBindVertexArray(batch.vao);
+void Renderer::setWorkerThreads(unsigned n)
+{
+    if (n == workerThreads_)
+        return;
+    workerThreads_ = n;
+    pool_.reset();
+}
 
-        // 验证绑定
-        GLint vaoBinding;
-        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vaoBinding);
+void Renderer::packEntities_(const Document &doc, const std::vector<EntityId> &ids, const ViewportState &vp)
+{
+    // 分片按实体区间连续切分，提交时按分片顺序即保持 ids 的顺序；
+    // 分片数取线程数的几倍，细分量不均（大圆、长折线）时由先做完的线程多领
+    std::size_t n = ids.size();
+    std::size_t shardCount = 1;
+    if (workerThreads_ != 1 && n >= 2 * kPackShardMin)
+    {
+        if (!pool_)
+            pool_ = std::make_unique<WorkerPool>(workerThreads_ == 0 ? 0 : workerThreads_ - 1);
+        shardCount = std::min<std::size_t>((n + kPackShardMin - 1) / kPackShardMin,
+                                           std::size_t(pool_->concurrency()) * 4);
+    }
+    // 多余的分片保留容量，下次并行时复用
+    if (shards_.size() < shardCount)
+        shards_.resize(shardCount);
+    for (std::size_t s = shardCount; s < shards_.size(); ++s)
+        shards_[s].clear();
 
-        // 检查 IBO
-        GLint iboBinding;
-        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &iboBinding);
-        if (batch.ibo != 0)
-        {
-            glDrawElements(batch.drawMode, batch.indexCount, GL_UNSIGNED_INT, nullptr);
-        }
-        else
+    std::function<void(std::size_t)> job = [&](std::size_t s)
+    {
+        PackShard &out = shards_[s];
+        out.clear();
+        std::size_t begin = n * s / shardCount, end = n * (s + 1) / shardCount;
+        out.entities.reserve(end - begin);
+        for (std::size_t i = begin; i < end; ++i)
         {
-            glDrawArrays(batch.drawMode, 0, batch.indexCount);
+            EntityId id = ids[i];
+            bool alive = doc.visit(id, [&](const auto &g, const Style &st, bool visible)
+                                   { packEntity_(out, id, g, st, visible, vp); });
+            if (!alive)
+            {
+                PackedEntity e;
+                e.id = id;
+                e.kind = PackKind::Removed;
+                out.entities.push_back(e);
+            }
         }
-        glBindVertexArray(0);
-    }
+    };
+    if (shardCount == 1)
+        job(0);
+    else
+        pool_->parallelFor(shardCount, job);
 }
 
-void Renderer::drawLineStrip(const std::vector<glm::vec3> &pts,
-                             std::uint32_t rgba,
-                             const ViewportState &vp)
+void Renderer::commitShards_(std::size_t count, bool writeAttrs)
 {
-    if (pts.empty() || !shaderLines_)
+    for (auto &heap : heaps_)
+        heap.beginWrites();
+    for (std::size_t s = 0; s < count; ++s)
     {
-        return;
+        const PackShard &shard = shards_[s];
+        for (const PackedEntity &e : shard.entities)
+            commitEntity_(shard, e, writeAttrs);
     }
+    for (auto &heap : heaps_)
+        heap.endWrites();
+}
 
-    // 转换顶点
-    std::vector<PosVertex> vertices;
-    vertices.reserve(pts.size());
-    for (const auto &p : pts)
+void Renderer::commitEntity_(const PackShard &shard, const PackedEntity &e, bool writeAttrs)
+{
+    if (e.kind == PackKind::Removed)
     {
-        vertices.push_back({p});
+        removeBatch(e.id);
+        return;
     }
+    if (writeAttrs)
+        writeAttr_(e.id, e.style, e.visible);
+    ++stats_.entitiesUploaded;
 
-    // 创建临时 VAO/VBO
-    GLuint vao, vbo;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-                 vertices.size() * sizeof(PosVertex),
-                 vertices.data(), GL_STREAM_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PosVertex), (void *)0);
-    glEnableVertexAttribArray(0);
-
-    // ✅ 使用着色器绘制
-    shaderLines_->use();
+    switch (e.kind)
+    {
+    case PackKind::Segments:
+        putRange_(0, e.id, shard.vertices.data() + e.first, e.count);
+        break;
+    case PackKind::Strip:
+        if (e.tessScale > 0.0f)
+        {
+            // 曲线从实例切换到 CPU 细分
+            releaseInstance_(curves_, e.id);
+            tessScale_[e.id] = e.tessScale;
+        }
+        putRange_(1, e.id, shard.vertices.data() + e.first, e.count);
+        break;
+    case PackKind::Pages:
+        putPages_(e.id, *e.polyline, e.style.rgba);
+        break;
+    case PackKind::Curve:
+        releaseRange_(e.id);
+        tessScale_.erase(e.id);
+        putInstance_(curves_, e.id, shard.curves[e.first]);
+        break;
+    case PackKind::Box:
+        putInstance_(boxes_, e.id, shard.boxes[e.first]);
+        break;
+    case PackKind::Empty:
+        releaseRange_(e.id);
+        break;
+    case PackKind::Removed:
+        break;
+    }
+}
 
-    glm::mat4 model(1.0f);
-    glm::mat4 mvp = vp.proj * vp.view * model;
-    shaderLines_->setMat4("mvp", mvp);
+// ============================================
+// 后台上传
+// ============================================
 
-    float r = ((rgba >> 24) & 0xFF) / 255.0f;
-    float g = ((rgba >> 16) & 0xFF) / 255.0f;
-    float b = ((rgba >> 8) & 0xFF) / 255.0f;
-    float a = ((rgba) & 0xFF) / 255.0f;
-    shaderLines_->setVec4("color", glm::vec4(r, g, b, a));
+bool Renderer::setBackgroundUpload(bool on)
+{
+    if (on == (uploader_ != nullptr))
+        return true;
 
-    glDrawArrays(GL_LINE_STRIP, 0, static_cast<GLsizei>(vertices.size()));
+    if (!on)
+    {
+        // 未上传完的一代作废，下一次同步重新全量上传
+        if (streaming_)
+        {
+            cancelStreaming_();
+            clearBatches_();
+            rebuildRequested_ = true;
+        }
+        uploader_->stop();
+        uploader_->takeResults(uploadResults_);
+        dropUploadResults_();
+        uploader_.reset();
+        return true;
+    }
 
-    // 清理
-    glBindVertexArray(0);
-    glDeleteBuffers(1, &vbo);
-    glDeleteVertexArrays(1, &vao);
+    auto worker = std::make_unique<UploadWorker>();
+    if (!worker->start(QOpenGLContext::currentContext()))
+        return false;
+    uploader_ = std::move(worker);
+    return true;
 }
 
-void Renderer::drawLineSegments(const std::vector<glm::vec3> &ptsPairs,
-                                std::uint32_t rgba,
-                                const ViewportState &vp)
+void Renderer::beginStreaming_()
+{
+    // 新批次号：上传线程跳过旧批次还没开始的任务，旧批次已完成的结果在接回时删除
+    ++uploadTicket_;
+    uploader_->cancelBefore(uploadTicket_);
+    for (int i = 0; i < 2; ++i)
+    {
+        if (streaming_)
+        {
+            // 上一次后台上传还没完成：丢弃那一代，继续显示更早的一代
+            heaps_[i].shutdown();
+        }
+        else
+        {
+            retiredHeaps_[i].shutdown();
+            retiredHeaps_[i].swapContents(heaps_[i]);
+        }
+        heaps_[i].setDeferred(true);
+    }
+    if (!streaming_)
+    {
+        // 属性表与曲线 / 盒子批次跟着顶点堆一起换下：上一代的顶点里存的拾取键只对它自己的属性表有效。
+        // 紧接着的 clearBatches_ 清空的是换上来的这一份，由新一代重新写入
+        std::swap(attr_, retiredAttr_);
+        std::swap(curves_, retiredCurves_);
+        std::swap(boxes_, retiredBoxes_);
+        attr_.generation = retiredAttr_.generation + 1;
+        // 重建会清掉选择，上一代也一并去掉，保持两代显示一致
+        for (EntityId id : overlaySet_)
+        {
+            std::uint32_t key = entityIndex(id) + 1;
+            if (key < retiredAttr_.attrs.size() && retiredAttr_.pickIds[key] == id)
+            {
+                retiredAttr_.attrs[key].flags &= ~(kEntitySelected | kEntityHighlighted);
+                markAttrDirty_(retiredAttr_, key);
+            }
+        }
+    }
+    streaming_ = true;
+    uploadsInFlight_ = 0;
+    pendingChanges_.clear();
+}
+
+void Renderer::submitStaged_()
+{
+    for (std::uint8_t h = 0; h < 2; ++h)
+    {
+        for (StagedArena &staged : heaps_[h].takeStaged())
+        {
+            UploadWorker::Job job;
+            job.ticket = uploadTicket_;
+            job.heap = h;
+            job.data = std::move(staged);
+            uploader_->submit(std::move(job));
+            ++uploadsInFlight_;
+        }
+    }
+    // 没有需要上传的 arena 时立即结束
+    adoptUploads_();
+}
+
+void Renderer::cancelStreaming_()
 {
-    if (ptsPairs.empty() || !shaderLines_)
+    ++uploadTicket_;
+    if (uploader_)
+        uploader_->cancelBefore(uploadTicket_);
+    for (int i = 0; i < 2; ++i)
     {
+        heaps_[i].shutdown();
+        heaps_[i].setDeferred(false);
+        retiredHeaps_[i].shutdown();
+    }
+    dropRetired_();
+    pendingChanges_.clear();
+    streaming_ = false;
+    uploadsInFlight_ = 0;
+    layerValid_ = false;
+}
+
+template <class T>
+static void releaseInstanceMemory(InstanceBatch<T> &b)
+{
+    b.instances = {};
+    b.owners = {};
+    b.index = {};
+    b.visible = {};
+    b.dirtyBegin = b.dirtyEnd = 0;
+}
+
+void Renderer::dropRetired_()
+{
+    // 只释放 CPU 侧内容（GL 缓冲留给下一次换代）；属性表保留，已发出的拾取读回仍按它解析
+    releaseInstanceMemory(retiredCurves_);
+    releaseInstanceMemory(retiredBoxes_);
+}
+
+void Renderer::adoptUploads_()
+{
+    if (!uploader_)
         return;
+    uploader_->takeResults(uploadResults_);
+
+    std::size_t kept = 0;
+    for (const UploadWorker::Result &r : uploadResults_)
+    {
+        if (!streaming_ || r.ticket != uploadTicket_)
+        {
+            // 被取代的批次：缓冲与 fence 属于共享组，在这里删除
+            glDeleteSync(r.fence);
+            glDeleteBuffers(1, &r.vbo);
+            glDeleteBuffers(1, &r.idVbo);
+            continue;
+        }
+        if (glClientWaitSync(r.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            uploadResults_[kept++] = r;
+            continue;
+        }
+        glDeleteSync(r.fence);
+        heaps_[r.heap].adoptArena(r.arena, r.vbo, r.idVbo);
+        --uploadsInFlight_;
     }
+    uploadResults_.resize(kept);
 
-    std::vector<PosVertex> vertices;
-    vertices.reserve(ptsPairs.size());
-    for (const auto &p : ptsPairs)
+    if (streaming_ && uploadsInFlight_ == 0)
     {
-        vertices.push_back({p});
+        // 新一代全部就绪：换下上一代，缓存的文档层要重画
+        for (int i = 0; i < 2; ++i)
+        {
+            heaps_[i].setDeferred(false);
+            retiredHeaps_[i].shutdown();
+        }
+        dropRetired_();
+        streaming_ = false;
+        layerValid_ = false;
     }
+}
 
-    GLuint vao, vbo;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
+void Renderer::dropUploadResults_()
+{
+    for (const UploadWorker::Result &r : uploadResults_)
+    {
+        glDeleteSync(r.fence);
+        glDeleteBuffers(1, &r.vbo);
+        glDeleteBuffers(1, &r.idVbo);
+    }
+    uploadResults_.clear();
+}
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-                 vertices.size() * sizeof(PosVertex),
-                 vertices.data(), GL_STREAM_DRAW);
+// 细分尺度：worldPerPixel 向下取到 2 的幂，细分误差不超过 0.5 像素
+static float tessScaleFor(float worldPerPixel)
+{
+    if (!(worldPerPixel > 0.0f))
+        return worldPerPixel;
+    return std::exp2(std::floor(std::log2(worldPerPixel)));
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PosVertex), (void *)0);
-    glEnableVertexAttribArray(0);
+float Renderer::retessError_(EntityId id, float worldPerPixel) const
+{
+    // 返回当前的屏幕误差（像素，细分误差为尺度的一半）；精度仍在滞回区间内时返回 0
+    auto it = tessScale_.find(id);
+    if (it == tessScale_.end() || !(worldPerPixel > 0.0f))
+        return 0.0f;
+    float ratio = worldPerPixel / it->second;
+    if (ratio >= kRetessRefine && ratio <= kRetessCoarsen)
+        return 0.0f;
+    return 0.5f / ratio;
+}
 
-    // ✅ 使用着色器绘制
-    shaderLines_->use();
+void Renderer::queueRetessellation_(const Document &doc, const ViewportState &vp)
+{
+    // 新相机下重新排队：上一相机下未处理完的曲线如仍不匹配会再次入队。
+    // 视野外的保持旧结果，进入视野时再处理
+    retessQueue_.clear();
+    retessHead_ = 0;
+    auto consider = [&](EntityId id)
+    {
+        float err = retessError_(id, vp.worldPerPixel);
+        if (err > 0.0f)
+            retessQueue_.emplace_back(err, id);
+    };
+
+    if (culling_)
+    {
+        Frustum frustum = vp.frustum();
+        doc.spatialIndex().queryClassified([&](const Aabb &b) { return frustum.classify(b); },
+                                           [&](EntityId id, const Aabb &) { consider(id); });
+    }
+    else
+    {
+        for (const auto &kv : tessScale_)
+            consider(kv.first);
+    }
 
-    glm::mat4 model(1.0f);
-    glm::mat4 mvp = vp.proj * vp.view * model;
-    shaderLines_->setMat4("mvp", mvp);
+    // 误差大（放大后明显折角）的先处理；放疏的误差小于 0.5 像素，排在最后
+    std::sort(retessQueue_.begin(), retessQueue_.end(),
+              [](const auto &a, const auto &b) { return a.first > b.first; });
+}
 
-    float r = ((rgba >> 24) & 0xFF) / 255.0f;
-    float g = ((rgba >> 16) & 0xFF) / 255.0f;
-    float b = ((rgba >> 8) & 0xFF) / 255.0f;
-    float a = ((rgba) & 0xFF) / 255.0f;
-    shaderLines_->setVec4("color", glm::vec4(r, g, b, a));
+void Renderer::retessellateQueued_(const Document &doc, const ViewportState &vp)
+{
+    using Clock = std::chrono::steady_clock;
+    const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                             std::chrono::duration<double, std::milli>(retessBudgetMs_));
+
+    // 预算内逐条细分到第一个分片，最后一并提交
+    if (shards_.empty())
+        shards_.resize(1);
+    PackShard &out = shards_[0];
+    out.clear();
+    while (retessHead_ < retessQueue_.size())
+    {
+        if (out.entities.size() >= kRetessMinPerFrame && Clock::now() >= deadline)
+            break;
+        EntityId id = retessQueue_[retessHead_++].second;
+        // 入队后可能已被编辑（按当前相机重新上传）或删除
+        if (retessError_(id, vp.worldPerPixel) <= 0.0f)
+            continue;
+        doc.visit(id, [&](const auto &g, const Style &s, bool visible)
+                  {
+            using G = std::decay_t<decltype(g)>;
+            if constexpr (std::is_same_v<G, Circle> || std::is_same_v<G, Arc>)
+            {
+                if (visible)
+                    packEntity_(out, id, g, s, visible, vp);
+            } });
+    }
+    std::uint32_t done = std::uint32_t(out.entities.size());
+    commitShards_(1, false);
 
-    glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(vertices.size()));
+    if (retessHead_ >= retessQueue_.size())
+    {
+        retessQueue_.clear();
+        retessHead_ = 0;
+    }
+    if (done > 0)
+    {
+        // 几何变了但文档版本没变，缓存的文档层要重画
+        stats_.curvesRetessellated += done;
+        layerValid_ = false;
+    }
+}
 
-    glBindVertexArray(0);
-    glDeleteBuffers(1, &vbo);
-    glDeleteVertexArrays(1, &vao);
+void Renderer::clearBatches_()
+{
+    // 只清空分配状态，保留 GL 缓冲与容量
+    for (auto &heap : heaps_)
+        heap.clear();
+    ranges_.clear();
+    pageRanges_.clear();
+
+    curves_.instances.clear();
+    curves_.owners.clear();
+    curves_.index.clear();
+    curves_.dirtyBegin = curves_.dirtyEnd = 0;
+    boxes_.instances.clear();
+    boxes_.owners.clear();
+    boxes_.index.clear();
+    boxes_.dirtyBegin = boxes_.dirtyEnd = 0;
+    tessScale_.clear();
+    retessQueue_.clear();
+    retessHead_ = 0;
+
+    maxLineWidth_ = 0.0f;
+
+    // 属性表保留容量，内容清零后由重建重新写入
+    std::fill(attr_.pickIds.begin(), attr_.pickIds.end(), EntityId(0));
+    std::fill(attr_.attrs.begin(), attr_.attrs.end(), EntityAttr{});
+    overlaySet_.clear();
+    attr_.dirtyBegin = 0;
+    attr_.dirtyEnd = attr_.attrs.size();
 }
 
-// ========== 上传实体 ==========
-void Renderer::uploadLine_(EntityId id, const Line &L, std::uint32_t rgba)
+void Renderer::removeBatch(EntityId id)
 {
-    GpuBatch b{};
-    std::vector<PosVertex> vb = {{L.p0}, {L.p1}};
-    glGenBuffers(1, &b.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, b.vbo);
-    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vb.size() * sizeof(PosVertex)), vb.data(), GL_STATIC_DRAW);
-    b.vao = makeVao(b.vbo, 0);
-    b.indexCount = GLsizei(vb.size());
-    b.rgba = rgba;
-    b.drawMode = GL_LINES;
-    batches_[id] = b;
+    releaseRange_(id);
+    releaseInstance_(curves_, id);
+    releaseInstance_(boxes_, id);
+    tessScale_.erase(id);
+    clearAttr_(id);
 }
 
-void Renderer::uploadPolyline_(EntityId id, const Polyline &P, std::uint32_t rgba)
+void Renderer::setCulling(bool on)
 {
-    if (P.pts.size() < 2)
+    culling_ = on;
+    // 关闭裁剪后细分检查要覆盖全部曲线
+    lastViewProj_ = glm::mat4(0.0f);
+}
+
+bool Renderer::cullVisible_(const ViewportState &vp)
+{
+    if (!culling_ || !doc_)
+        return false;
+
+    const SpatialIndex &index = doc_->spatialIndex();
+    if (index.size() == 0)
+        return false;
+
+    // 整个场景都在视野内：直接整批绘制，省掉逐实体的查表
+    Frustum frustum = vp.frustum();
+    const float pad = cullPad_(vp);
+    if (frustum.classify(index.rootBounds(), pad) == 2)
+        return false;
+
+    visibleIds_.clear();
+    index.queryClassified([&](const Aabb &b) { return frustum.classify(b, pad); },
+                          [&](EntityId id, const Aabb &) { visibleIds_.push_back(id); });
+
+    // 大部分可见时逐实体的多重绘制参数反而更贵
+    return visibleIds_.size() * 2 <= index.size();
+}
+
+float Renderer::cullPad_(const ViewportState &vp) const
+{
+    // 宽线在屏幕上向两侧各展开半线宽 + 1 像素的抗锯齿带：包围盒刚出视野的线仍有一部分可见
+    if (!wideLines_)
+        return 0.0f;
+    return (0.5f * std::max(maxLineWidth_, 1.0f) + 1.0f) * vp.worldPerPixel;
+}
+
+void Renderer::draw(const ViewportState &vp)
+{
+    if (!shaderBatch_)
+    {
+        qWarning() << "Shader not initialized";
         return;
-    GpuBatch b{};
-    std::vector<PosVertex> vb(P.pts.size() + (P.closed ? 1 : 0));
-    for (size_t i = 0; i < P.pts.size(); ++i)
-        vb[i].pos = P.pts[i];
-    if (P.closed)
-        vb.back().pos = P.pts.front();
+    }
 
-    glGenBuffers(1, &b.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, b.vbo);
-    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vb.size() * sizeof(PosVertex)), vb.data(), GL_STATIC_DRAW);
-    b.vao = makeVao(b.vbo, 0);
-    b.indexCount = GLsizei(vb.size());
-    b.rgba = rgba;
-    b.drawMode = GL_LINE_STRIP;
-    batches_[id] = b;
+    bool culled = drawPass_(vp, colorPass_);
+    stats_.visibleEntities = culled ? std::uint32_t(visibleIds_.size())
+                                    : std::uint32_t(ranges_.size() + pageRanges_.size() + curves_.instances.size() +
+                                                  boxes_.instances.size());
+
+    if (previewCount_ > 0)
+        drawPreview_(vp);
+}
+
+// ============================================
+// 文档层缓存与叠加层
+// ============================================
+
+void Renderer::setBaseLayer_(bool on)
+{
+    for (Shader *s : {colorPass_.batch, colorPass_.curve, colorPass_.box, colorPass_.wideLine, colorPass_.wideCurve})
+    {
+        s->use();
+        s->setInt(s->uniform("baseLayer"), on ? 1 : 0);
+    }
+}
+
+void Renderer::drawStatic(const ViewportState &vp)
+{
+    if (!shaderBatch_)
+    {
+        qWarning() << "Shader not initialized";
+        return;
+    }
+
+    // 后台上传期间上一代的缓冲堆只能整段绘制，叠加层无法单独重画其中选中的直线 / 折线：
+    // 这段时间文档层直接带上选中 / 高亮，标志变化时缓存失效（见 setAttrFlag_）
+    adoptUploads_();
+    const bool base = !streaming_;
+    if (base)
+        setBaseLayer_(true);
+    bool culled = drawPass_(vp, colorPass_);
+    stats_.visibleEntities = culled ? std::uint32_t(visibleIds_.size())
+                                    : std::uint32_t(ranges_.size() + pageRanges_.size() + curves_.instances.size() +
+                                                  boxes_.instances.size());
+    if (base)
+        setBaseLayer_(false);
+    layerFlagged_ = !base;
+}
+
+void Renderer::drawOverlay(const ViewportState &vp)
+{
+    if (!shaderBatch_)
+        return;
+
+    // 文档层已带选中 / 高亮画出（后台上传期间）时不再重画
+    if (!overlaySet_.empty() && !layerFlagged_)
+    {
+        overlayIds_.assign(overlaySet_.begin(), overlaySet_.end());
+
+        // 与合成进来的文档层深度相同：LEQUAL 让重画的实体盖住缓存里的原色，被遮挡的部分仍被挡住
+        GLint depthFunc = GL_LESS;
+        glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+        glDepthFunc(GL_LEQUAL);
+        drawPass_(vp, colorPass_, &overlayIds_);
+        glDepthFunc(GLenum(depthFunc));
+    }
+
+    if (previewCount_ > 0)
+        drawPreview_(vp);
+}
+
+bool Renderer::ensureLayerTarget_(int width, int height, int samples)
+{
+    if (layerFbo_ && layerWidth_ == width && layerHeight_ == height && layerSamples_ == samples)
+        return true;
+    freeLayerTarget_();
+    if (width <= 0 || height <= 0)
+        return false;
+
+    // 深度格式与 QOpenGLWidget / 离屏 FBO 的组合深度模板一致，blit 要求两边格式相同
+    glGenRenderbuffers(1, &layerColor_);
+    glBindRenderbuffer(GL_RENDERBUFFER, layerColor_);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &layerDepth_);
+    glBindRenderbuffer(GL_RENDERBUFFER, layerDepth_);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLint prevFbo = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFbo);
+    glGenFramebuffers(1, &layerFbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, layerFbo_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, layerColor_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, layerDepth_);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(prevFbo));
+
+    if (!complete)
+    {
+        qWarning() << "Renderer: static layer framebuffer incomplete";
+        freeLayerTarget_();
+        return false;
+    }
+    layerWidth_ = width;
+    layerHeight_ = height;
+    layerSamples_ = samples;
+    return true;
+}
+
+void Renderer::freeLayerTarget_()
+{
+    if (layerFbo_)
+        glDeleteFramebuffers(1, &layerFbo_);
+    if (layerColor_)
+        glDeleteRenderbuffers(1, &layerColor_);
+    if (layerDepth_)
+        glDeleteRenderbuffers(1, &layerDepth_);
+    layerFbo_ = layerColor_ = layerDepth_ = 0;
+    layerWidth_ = layerHeight_ = layerSamples_ = 0;
+    layerValid_ = false;
+}
+
+bool Renderer::beginStaticLayer(const ViewportState &vp, std::uint64_t layerKey)
+{
+    glGetIntegerv(GL_VIEWPORT, layerViewport_);
+    GLint samples = 0;
+    glGetIntegerv(GL_SAMPLES, &samples);
+    if (!ensureLayerTarget_(layerViewport_[2], layerViewport_[3], samples))
+        return true;  // 没有层缓冲：调用方直接画在当前帧缓冲上
+
+    // 选中 / 高亮不在这里：它们由叠加层重画，不使缓存失效
+    bool same = layerValid_ &&
+                layerView_ == vp.view && layerProj_ == vp.proj &&
+                layerVersion_ == cursor_.version && layerKey_ == layerKey &&
+                layerAnalytic_ == analyticCurves_ && layerWide_ == wideLines_;
+    if (same)
+        return false;
+
+    layerView_ = vp.view;
+    layerProj_ = vp.proj;
+    layerVersion_ = cursor_.version;
+    layerKey_ = layerKey;
+    layerAnalytic_ = analyticCurves_;
+    layerWide_ = wideLines_;
+
+    // 层缓冲沿用当前的清屏颜色
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &layerPrevFbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, layerFbo_);
+    glViewport(0, 0, layerWidth_, layerHeight_);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    return true;
+}
+
+void Renderer::endStaticLayer()
+{
+    if (!layerFbo_)
+        return;
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(layerPrevFbo_));
+    glViewport(layerViewport_[0], layerViewport_[1], layerViewport_[2], layerViewport_[3]);
+    layerValid_ = true;
+}
+
+void Renderer::compositeStaticLayer()
+{
+    if (!layerFbo_ || !layerValid_)
+        return;
+
+    // 颜色与深度一起拷贝：叠加层照常做深度测试
+    GLint target = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, layerFbo_);
+    glBlitFramebuffer(0, 0, layerWidth_, layerHeight_,
+                      layerViewport_[0], layerViewport_[1],
+                      layerViewport_[0] + layerWidth_, layerViewport_[1] + layerHeight_,
+                      GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(target));
+    ++stats_.drawCalls;
+}
+
+void Renderer::setCamera(const ViewportState &vp)
+{
+    CameraBlock block;
+    block.view = vp.view;
+    block.proj = vp.proj;
+    block.viewProj = vp.proj * vp.view;
+    block.viewport = glm::vec2(float(vp.width), float(vp.height));
+    block.worldPerPixel = vp.worldPerPixel;
+
+    if (cameraValid_ && std::memcmp(&block, &camera_, sizeof(CameraBlock)) == 0)
+        return;
+    camera_ = block;
+    cameraValid_ = true;
+
+    staging_.upload(cameraUbo_, 0, &camera_, sizeof(CameraBlock));
+    glBindBufferBase(GL_UNIFORM_BUFFER, Shader::kCameraBinding, cameraUbo_);
+    stats_.bytesUploaded += sizeof(CameraBlock);
+}
+
+bool Renderer::drawPass_(const ViewportState &vp, const PassPrograms &programs,
+                         const std::vector<EntityId> *subset)
+{
+    // 接回后台上传完成的 arena；未全部就绪前画上一代：缓冲堆整段绘制（ranges_ 的句柄不属于它），
+    // 属性表与曲线 / 盒子批次用换下来的那一份
+    adoptUploads_();
+    const bool retired = streaming_;
+    GpuBufferHeap *heaps = retired ? retiredHeaps_ : heaps_;
+    AttrTable &attrs = retired ? retiredAttr_ : attr_;
+    CurveBatch &curves = retired ? retiredCurves_ : curves_;
+    BoxBatch &boxes = retired ? retiredBoxes_ : boxes_;
+
+    // 相机 uniform block（矩阵不变时不重复上传）与实体属性表
+    setCamera(vp);
+    flushAttrs_(attrs);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, attrs.tex);
+
+    // 视锥裁剪：借助文档的包围盒树分层剔除视野外的实体，只为可见实体生成绘制参数。
+    // 显式子集（叠加层）直接使用
+    bool culled = subset != nullptr || cullVisible_(vp);
+    std::size_t subsetRanges = 0;
+    if (culled)
+    {
+        // 多页折线逐页裁剪：视野只截到长折线的一小段时只画这几页
+        Frustum frustum = vp.frustum();
+        const float pad = cullPad_(vp);
+        for (auto &heap : heaps_)
+            heap.beginSubset();
+        curves.visible.clear();
+        boxes.visible.clear();
+
+        for (EntityId id : subset ? *subset : visibleIds_)
+        {
+            if (!retired)
+            {
+                auto r = ranges_.find(id);
+                if (r != ranges_.end())
+                {
+                    heaps_[r->second.heap].addToSubset(r->second.handle);
+                    ++subsetRanges;
+                    continue;
+                }
+                if (!pageRanges_.empty())
+                {
+                    auto p = pageRanges_.find(id);
+                    if (p != pageRanges_.end())
+                    {
+                        for (const PageRange &pr : p->second)
+                        {
+                            if (pr.handle == GpuBufferHeap::kInvalid)
+                                continue;
+                            if (subset || frustum.classify(pr.bounds, pad) != 0)
+                            {
+                                heaps_[1].addToSubset(pr.handle);
+                                ++subsetRanges;
+                            }
+                        }
+                        continue;
+                    }
+                }
+            }
+            auto c = curves.index.find(id);
+            if (c != curves.index.end())
+            {
+                curves.visible.push_back(curves.instances[c->second]);
+                continue;
+            }
+            auto b = boxes.index.find(id);
+            if (b != boxes.index.end())
+                boxes.visible.push_back(boxes.instances[b->second]);
+        }
+    }
+
+    // 立方体：共用单位立方体网格，一次实例化绘制（可见实例在 GL 3.3 下同样拷到独立缓冲）
+    GLuint boxVao = boxes.vao;
+    std::size_t boxCount = boxes.instances.size();
+    if (culled)
+    {
+        boxVao = boxes.cullVao;
+        boxCount = boxes.visible.size();
+        uploadVisibleInstances_(boxes);
+    }
+    else
+    {
+        flushInstances_(boxes);
+    }
+
+    if (boxCount > 0)
+    {
+        programs.box->use();
+        glBindVertexArray(boxVao);
+        glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr, GLsizei(boxCount));
+        glBindVertexArray(0);
+        ++stats_.drawCalls;
+    }
+
+    if (wideLines_ && programs.blend)
+        beginLineBlend_();
+
+    // 上一代的缓冲堆只能整段绘制：显式子集时不画，否则整个上一代会再混合一遍
+    // （叠加层在这段时间不重画，选中 / 高亮由 drawStatic 直接画进文档层）
+    const bool drawHeaps = !(retired && subset);
+    if (wideLines_ && drawHeaps)
+    {
+        // GL 3.3 没有 baseInstance：子集只能逐个分配实例化，显式子集或裁剪后剩下的分配很少时这样画；
+        // 分配多时把可见分配拼接到收集缓冲一次绘制；未裁剪时每个 arena 整段提交
+        programs.wideLine->use();
+        bool perRange = !retired && (subset != nullptr || (culled && subsetRanges <= kWideSubsetRanges));
+        bool gathered = !retired && culled && !perRange;
+        for (int i = 0; i < 2; ++i)
+        {
+            GpuBufferHeap &heap = heaps[i];
+            if (perRange)
+                heap.drawSegmentSubset();
+            else if (gathered)
+                heap.drawSegmentGathered();
+            else
+                heap.drawSegments();
+        }
+    }
+    else if (drawHeaps)
+    {
+        // 每个 arena 一次绘制调用，颜色来自顶点属性
+        programs.batch->use();
+        for (int i = 0; i < 2; ++i)
+        {
+            GpuBufferHeap &heap = heaps[i];
+            if (culled && !retired)
+                heap.drawSubset();
+            else
+                heap.draw();
+        }
+    }
+
+    // 圆 / 圆弧：每个实例一条线带，分段数在 vertex shader 中按投影半径决定
+    GLuint curveVao = curves.vao;
+    std::size_t curveCount = curves.instances.size();
+    if (culled)
+    {
+        // 可见实例每帧拷到独立的小缓冲（GL 3.3 没有 baseInstance）
+        curveVao = curves.cullVao;
+        curveCount = curves.visible.size();
+        uploadVisibleInstances_(curves);
+    }
+    else
+    {
+        flushInstances_(curves);
+    }
+
+    if (curveCount > 0)
+    {
+        glBindVertexArray(curveVao);
+        if (wideLines_)
+        {
+            // 宽线模式每个采样点两个顶点（线两侧）
+            programs.wideCurve->use();
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * (kCurveMaxSegments + 1), GLsizei(curveCount));
+        }
+        else
+        {
+            programs.curve->use();
+            glDrawArraysInstanced(GL_LINE_STRIP, 0, kCurveMaxSegments + 1, GLsizei(curveCount));
+        }
+        glBindVertexArray(0);
+        ++stats_.drawCalls;
+    }
+
+    if (wideLines_ && programs.blend)
+        endLineBlend_();
+    return culled;
+}
+
+void Renderer::beginLineBlend_()
+{
+    blendWas_ = glIsEnabled(GL_BLEND);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMaskWas_);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // 抗锯齿边缘不写深度，否则相邻线段在连接处互相遮挡出缺口
+    glDepthMask(GL_FALSE);
+}
+
+void Renderer::endLineBlend_()
+{
+    glDepthMask(depthMaskWas_);
+    if (!blendWas_)
+        glDisable(GL_BLEND);
+}
+
+// ============================================
+// 实体属性表
+// ============================================
+
+std::uint32_t Renderer::pickKey_(EntityId id)
+{
+    // 0 留给背景与非实体几何；同一下标同一时刻只属于一个存活实体，代数不必进键。
+    // 同一个键也是属性表的下标
+    std::uint32_t key = entityIndex(id) + 1;
+    if (attr_.pickIds.size() <= key)
+    {
+        attr_.pickIds.resize(std::size_t(key) + 1, 0);
+        attr_.attrs.resize(attr_.pickIds.size());
+    }
+    attr_.pickIds[key] = id;
+    return key;
+}
+
+void Renderer::markAttrDirty_(AttrTable &t, std::uint32_t key)
+{
+    if (t.dirtyBegin == t.dirtyEnd)
+    {
+        t.dirtyBegin = key;
+        t.dirtyEnd = key + 1;
+        return;
+    }
+    t.dirtyBegin = std::min<std::size_t>(t.dirtyBegin, key);
+    t.dirtyEnd = std::max<std::size_t>(t.dirtyEnd, key + 1);
+}
+
+// 线宽（像素）打包为 12.4 定点，放在 flags 的高 16 位；0 由着色器按 1 像素处理
+static std::uint32_t packLineWidth(float widthPx)
+{
+    float w = std::min(std::max(widthPx, 0.0f), 4095.0f);
+    return std::uint32_t(w * 16.0f + 0.5f) << 16;
+}
+
+void Renderer::writeAttr_(EntityId id, const Style &s, bool visible)
+{
+    std::uint32_t key = entityIndex(id) + 1;
+    // 槽位被新实体复用时丢掉旧实体的选择 / 高亮
+    bool fresh = key >= attr_.pickIds.size() || attr_.pickIds[key] != id;
+    if (fresh && key < attr_.pickIds.size() && attr_.pickIds[key] != 0)
+        overlaySet_.erase(attr_.pickIds[key]);
+    pickKey_(id);
+
+    EntityAttr &a = attr_.attrs[key];
+    std::uint32_t keep = fresh ? 0u : (a.flags & kEntityFlagMask & ~kEntityVisible);
+    a.rgba = s.rgba;
+    a.flags = keep | (visible ? kEntityVisible : 0u) | packLineWidth(s.lineWidth);
+    markAttrDirty_(attr_, key);
+    maxLineWidth_ = std::max(maxLineWidth_, s.lineWidth);
+}
+
+void Renderer::clearAttr_(EntityId id)
+{
+    std::uint32_t key = entityIndex(id) + 1;
+    if (key >= attr_.pickIds.size() || attr_.pickIds[key] != id)
+        return;
+    attr_.pickIds[key] = 0;
+    attr_.attrs[key] = EntityAttr{};
+    overlaySet_.erase(id);
+    markAttrDirty_(attr_, key);
+}
+
+void Renderer::setAttrFlag_(EntityId id, std::uint32_t flag, bool on)
+{
+    // 后台上传期间选择 / 高亮同时写进仍在显示的上一代；此时文档层带着这些标志，需要重画
+    if (EntityAttr *r = retiredEntry_(id))
+    {
+        std::uint32_t flags = on ? (r->flags | flag) : (r->flags & ~flag);
+        if (flags != r->flags)
+        {
+            r->flags = flags;
+            if (layerFlagged_)
+                layerValid_ = false;
+        }
+    }
+
+    std::uint32_t key = entityIndex(id) + 1;
+    if (key >= attr_.pickIds.size() || attr_.pickIds[key] != id)
+        return;
+    EntityAttr &a = attr_.attrs[key];
+    std::uint32_t flags = on ? (a.flags | flag) : (a.flags & ~flag);
+    if (flags == a.flags)
+        return;
+    a.flags = flags;
+    markAttrDirty_(attr_, key);
+
+    if (flags & (kEntitySelected | kEntityHighlighted))
+        overlaySet_.insert(id);
+    else
+        overlaySet_.erase(id);
+}
+
+void Renderer::setSelected(EntityId id, bool on)
+{
+    setAttrFlag_(id, kEntitySelected, on);
+}
+
+void Renderer::setHighlighted(EntityId id, bool on)
+{
+    setAttrFlag_(id, kEntityHighlighted, on);
+}
+
+void Renderer::flushAttrs_(AttrTable &t)
+{
+    if (!t.buffer)
+        return;
+
+    if (t.attrs.size() > t.capacity)
+    {
+        // 扩容：整表重新上传
+        std::size_t capacity = std::max<std::size_t>(t.capacity, 1024);
+        while (capacity < t.attrs.size())
+            capacity *= 2;
+        t.capacity = capacity;
+        glBindBuffer(GL_TEXTURE_BUFFER, t.buffer);
+        glBufferData(GL_TEXTURE_BUFFER, GLsizeiptr(capacity * sizeof(EntityAttr)), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        staging_.upload(t.buffer, 0, t.attrs.data(), GLsizeiptr(t.attrs.size() * sizeof(EntityAttr)));
+        stats_.bytesUploaded += t.attrs.size() * sizeof(EntityAttr);
+        t.dirtyBegin = t.dirtyEnd = 0;
+        return;
+    }
+
+    if (t.dirtyBegin == t.dirtyEnd)
+        return;
+    GLsizeiptr offset = GLsizeiptr(t.dirtyBegin * sizeof(EntityAttr));
+    GLsizeiptr bytes = GLsizeiptr((t.dirtyEnd - t.dirtyBegin) * sizeof(EntityAttr));
+    staging_.upload(t.buffer, offset, t.attrs.data() + t.dirtyBegin, bytes);
+    stats_.bytesUploaded += std::uint64_t(bytes);
+    t.dirtyBegin = t.dirtyEnd = 0;
+}
+
+void Renderer::initAttrTable_(AttrTable &t)
+{
+    glGenBuffers(1, &t.buffer);
+    glGenTextures(1, &t.tex);
+    t.capacity = 0;
+    t.attrs.resize(std::max<std::size_t>(t.attrs.size(), 1));
+    flushAttrs_(t);
+    glBindTexture(GL_TEXTURE_BUFFER, t.tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, t.buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
 }
 
-void Renderer::uploadCircle_(EntityId id, const Circle &C, std::uint32_t rgba, const ViewportState &vp)
+void Renderer::freeAttrTable_(AttrTable &t)
 {
-    float worldEps = vp.worldPerPixel * 0.5f;
-    auto pts = tessellateCircle(C, worldEps);
-    Polyline P{pts, true};
-    uploadPolyline_(id, P, rgba);
+    if (t.tex)
+        glDeleteTextures(1, &t.tex);
+    if (t.buffer)
+        glDeleteBuffers(1, &t.buffer);
+    t = AttrTable{};
 }
 
-void Renderer::uploadArc_(EntityId id, const Arc &A, std::uint32_t rgba, const ViewportState &vp)
+EntityAttr *Renderer::retiredEntry_(EntityId id)
 {
-    float worldEps = vp.worldPerPixel * 0.5f;
-    auto pts = tessellateArc(A, worldEps);
-    Polyline P{pts, false};
-    uploadPolyline_(id, P, rgba);
+    std::uint32_t key = entityIndex(id) + 1;
+    if (!streaming_ || key >= retiredAttr_.pickIds.size() || retiredAttr_.pickIds[key] != id)
+        return nullptr;
+    markAttrDirty_(retiredAttr_, key);
+    return &retiredAttr_.attrs[key];
 }
 
-void Renderer::uploadBox_(EntityId id, const Box &B, std::uint32_t rgba)
+void Renderer::restyleRetired_(const Document &doc, const Change &c)
 {
-    // ✅ 修改为实心立方体（可选）
-    float half = B.size * 0.5f;
-    glm::vec3 c = B.center;
+    if (c.kind == ChangeKind::Cleared)
+    {
+        std::fill(retiredAttr_.pickIds.begin(), retiredAttr_.pickIds.end(), EntityId(0));
+        std::fill(retiredAttr_.attrs.begin(), retiredAttr_.attrs.end(), EntityAttr{});
+        retiredAttr_.dirtyBegin = 0;
+        retiredAttr_.dirtyEnd = retiredAttr_.attrs.size();
+        return;
+    }
+    EntityAttr *a = retiredEntry_(c.id);
+    if (!a)
+        return;
+    bool alive = doc.visit(c.id, [&](const auto &, const Style &s, bool visible)
+                           {
+        a->rgba = s.rgba;
+        a->flags = (a->flags & kEntityFlagMask & ~kEntityVisible) | (visible ? kEntityVisible : 0u) |
+                   packLineWidth(s.lineWidth); });
+    if (!alive)
+    {
+        // 已删除：从上一代中隐去，拾取也不再返回它
+        *a = EntityAttr{};
+        retiredAttr_.pickIds[entityIndex(c.id) + 1] = 0;
+    }
+}
+
+// ============================================
+// 交互预览层
+// ============================================
+
+void Renderer::appendPreviewStrip_(const glm::vec3 *pts, std::size_t n, bool closed, std::uint32_t rgba)
+{
+    for (std::size_t i = 0; i + 1 < n; ++i)
+    {
+        previewScratch_.push_back({pts[i], rgba});
+        previewScratch_.push_back({pts[i + 1], rgba});
+    }
+    if (closed && n > 2)
+    {
+        previewScratch_.push_back({pts[n - 1], rgba});
+        previewScratch_.push_back({pts[0], rgba});
+    }
+}
 
-    // 8 个顶点
+void Renderer::uploadPreview_()
+{
+    if (!previewVbo_)
+        return;
+    GLsizei n = GLsizei(previewScratch_.size());
+    previewCount_ = n;
+    if (n == 0)
+        return;
+    if (n > previewCapacity_)
+    {
+        // 扩容：缓冲名不变，previewVao_ / previewSegVao_ 的属性绑定继续有效
+        GLsizei capacity = std::max(previewCapacity_, kPreviewVertices);
+        while (capacity < n)
+            capacity *= 2;
+        previewCapacity_ = capacity;
+        glBindBuffer(GL_ARRAY_BUFFER, previewVbo_);
+        glBufferData(GL_ARRAY_BUFFER, capacity * GLsizeiptr(sizeof(BatchVertex)), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    staging_.upload(previewVbo_, 0, previewScratch_.data(), n * GLsizeiptr(sizeof(BatchVertex)));
+    stats_.bytesUploaded += n * sizeof(BatchVertex);
+}
+
+void Renderer::setPreviewLine(const glm::vec3 &a, const glm::vec3 &b, std::uint32_t rgba)
+{
+    previewScratch_.clear();
+    previewScratch_.push_back({a, rgba});
+    previewScratch_.push_back({b, rgba});
+    uploadPreview_();
+}
+
+void Renderer::setPreviewPolyline(const glm::vec3 *pts, std::size_t n, bool closed, std::uint32_t rgba)
+{
+    previewScratch_.clear();
+    appendPreviewStrip_(pts, n, closed, rgba);
+    uploadPreview_();
+}
+
+void Renderer::setPreviewCircle(const Circle &c, std::uint32_t rgba, const ViewportState &vp)
+{
+    tessellateCircle(c, vp.worldPerPixel * 0.5f, curvePts_);
+    previewScratch_.clear();
+    appendPreviewStrip_(curvePts_.data(), curvePts_.size(), true, rgba);
+    uploadPreview_();
+}
+
+void Renderer::setPreviewBox(const Box &b, std::uint32_t rgba)
+{
+    float h = b.size * 0.5f;
+    glm::vec3 c = b.center;
     glm::vec3 v[8] = {
-        c + glm::vec3(-half, -half, -half), // 0
-        c + glm::vec3(half, -half, -half),  // 1
-        c + glm::vec3(half, half, -half),   // 2
-        c + glm::vec3(-half, half, -half),  // 3
-        c + glm::vec3(-half, -half, half),  // 4
-        c + glm::vec3(half, -half, half),   // 5
-        c + glm::vec3(half, half, half),    // 6
-        c + glm::vec3(-half, half, half),   // 7
+        c + glm::vec3(-h, -h, -h), c + glm::vec3(h, -h, -h),
+        c + glm::vec3(h, h, -h), c + glm::vec3(-h, h, -h),
+        c + glm::vec3(-h, -h, h), c + glm::vec3(h, -h, h),
+        c + glm::vec3(h, h, h), c + glm::vec3(-h, h, h),
     };
+    // 12 条棱
+    static const int edges[24] = {0, 1, 1, 2, 2, 3, 3, 0,
+                                  4, 5, 5, 6, 6, 7, 7, 4,
+                                  0, 4, 1, 5, 2, 6, 3, 7};
+    previewScratch_.clear();
+    for (int e : edges)
+        previewScratch_.push_back({v[e], rgba});
+    uploadPreview_();
+}
 
-    std::vector<PosVertex> vertices;
-    std::vector<GLuint> indices;
+void Renderer::drawPreview_(const ViewportState &vp)
+{
+    // 预览始终叠加在实体之上
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
 
-    // ✅ 实心模式：6 个面，12 个三角形
-    for (int i = 0; i < 8; ++i)
+    setCamera(vp);
+    if (wideLines_)
+    {
+        beginLineBlend_();
+        shaderWideLine_->use();
+        shaderWideLine_->setFloat(wideLineWidthLoc_, 1.0f);
+        glVertexAttribI4ui(2, 0, 0, 0, 0);
+        glVertexAttribI4ui(4, 0, 0, 0, 0);
+        glBindVertexArray(previewSegVao_);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, previewCount_ / 2);
+        glBindVertexArray(0);
+        endLineBlend_();
+    }
+    else
     {
-        vertices.push_back({v[i]});
+        shaderBatch_->use();
+        glBindVertexArray(previewVao_);
+        glDrawArrays(GL_LINES, 0, previewCount_);
+        glBindVertexArray(0);
     }
+    ++stats_.drawCalls;
 
-    indices = {
-        // 后面 (-Z)
-        0, 1, 2, 2, 3, 0,
-        // 前面 (+Z)
-        4, 6, 5, 4, 7, 6,
-        // 左面 (-X)
-        0, 3, 7, 0, 7, 4,
-        // 右面 (+X)
-        1, 5, 6, 1, 6, 2,
-        // 底面 (-Y)
-        0, 4, 5, 0, 5, 1,
-        // 顶面 (+Y)
-        3, 2, 6, 3, 6, 7};
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+}
 
-    // 上传到 GPU
-    removeBatch(id);
+// ============================================
+// ID 缓冲拾取
+// ============================================
 
-    GpuBatch batch;
-    glGenBuffers(1, &batch.vbo);
-    glGenBuffers(1, &batch.ibo);
+bool Renderer::ensurePickTarget_(int size)
+{
+    if (pickFbo_ && pickSize_ == size)
+        return true;
+    freePickTarget_();
+
+    glGenTextures(1, &pickColor_);
+    glBindTexture(GL_TEXTURE_2D, pickColor_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, size, size, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &pickDepth_);
+    glBindRenderbuffer(GL_RENDERBUFFER, pickDepth_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLint prevFbo = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFbo);
+    glGenFramebuffers(1, &pickFbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, pickFbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pickColor_, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, pickDepth_);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(prevFbo));
+    if (!complete)
+    {
+        qWarning() << "Renderer: pick framebuffer incomplete";
+        freePickTarget_();
+        return false;
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-                 vertices.size() * sizeof(PosVertex),
-                 vertices.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &pickPbo_);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pickPbo_);
+    glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(size) * size * sizeof(std::uint32_t), nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 indices.size() * sizeof(GLuint),
-                 indices.data(), GL_STATIC_DRAW);
+    pickSize_ = size;
+    return true;
+}
+
+void Renderer::freePickTarget_()
+{
+    if (pickFence_)
+        glDeleteSync(pickFence_);
+    pickFence_ = nullptr;
+    if (pickFbo_)
+        glDeleteFramebuffers(1, &pickFbo_);
+    if (pickColor_)
+        glDeleteTextures(1, &pickColor_);
+    if (pickDepth_)
+        glDeleteRenderbuffers(1, &pickDepth_);
+    if (pickPbo_)
+        glDeleteBuffers(1, &pickPbo_);
+    pickFbo_ = pickColor_ = pickDepth_ = pickPbo_ = 0;
+    pickSize_ = 0;
+}
 
-    batch.vao = makeVao(batch.vbo, batch.ibo);
-    batch.indexCount = static_cast<GLsizei>(indices.size());
-    batch.rgba = rgba;
-    batch.drawMode = GL_TRIANGLES; // ✅ 实心模式
+void Renderer::requestPick(const ViewportState &vp, int x, int y, int radius)
+{
+    if (!shaderBatchPick_ || vp.width <= 0 || vp.height <= 0)
+        return;
+
+    int n = 2 * std::max(radius, 0) + 1;
+    if (!ensurePickTarget_(n))
+        return;
+
+    // 新请求取代未读回的旧请求
+    if (pickFence_)
+    {
+        glDeleteSync(pickFence_);
+        pickFence_ = nullptr;
+    }
 
-    batches_[id] = batch;
+    // 把以拾取点为中心的 n×n 像素映射到整个 NDC：先平移到中心再放大。
+    // 视锥随之收缩到光标附近，裁剪后只绘制落在小窗口里的实体
+    float W = float(vp.width), H = float(vp.height);
+    float cx = float(x) + 0.5f;
+    float cy = H - float(y) - 0.5f;
+    glm::mat4 pick(1.0f);
+    pick[0][0] = W / float(n);
+    pick[1][1] = H / float(n);
+    pick[3][0] = (W - 2.0f * cx) / float(n);
+    pick[3][1] = (H - 2.0f * cy) / float(n);
+
+    ViewportState pvp = vp;
+    pvp.proj = pick * vp.proj;
+    pvp.width = n;
+    pvp.height = n;
+
+    // QOpenGLWidget 有自己的 FBO，画完恢复绑定与视口
+    GLint prevFbo = 0;
+    GLint prevViewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFbo);
+    glGetIntegerv(GL_VIEWPORT, prevViewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, pickFbo_);
+    glViewport(0, 0, n, n);
+    const GLuint zero[4] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, zero);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    drawPass_(pvp, pickPass_);
+    // 像素里的拾取键属于画它的那一代，读回时用同一代的表解析
+    pickGeneration_ = (streaming_ ? retiredAttr_ : attr_).generation;
+
+    // 读进 PBO 立即返回；fence 之后再映射，不会让绘制线程等 GPU
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pickPbo_);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, n, n, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    pickFence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(prevFbo));
+    glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+}
+
+bool Renderer::pollPick(PickResult &out)
+{
+    if (!pickFence_)
+        return false;
+
+    GLenum status = glClientWaitSync(pickFence_, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+        return false;
+    glDeleteSync(pickFence_);
+    pickFence_ = nullptr;
+
+    out = PickResult{};
+    if (status == GL_WAIT_FAILED)
+        return true;
+
+    int n = pickSize_;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pickPbo_);
+    const auto *px = static_cast<const std::uint32_t *>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(n) * n * sizeof(std::uint32_t), GL_MAP_READ_BIT));
+    // 读回之前那一代已被换下并又被下一次上传复用时，键已不可解析，按未命中处理
+    const AttrTable *table = attr_.generation == pickGeneration_          ? &attr_
+                             : retiredAttr_.generation == pickGeneration_ ? &retiredAttr_
+                                                                          : nullptr;
+    if (px)
+    {
+        // 取离中心最近的命中像素
+        int c = n / 2;
+        int best = -1;
+        for (int row = 0; row < n; ++row)
+        {
+            for (int col = 0; col < n; ++col)
+            {
+                std::uint32_t key = px[row * n + col];
+                if (!table || key == 0 || key >= table->pickIds.size() || table->pickIds[key] == 0)
+                    continue;
+                int d2 = (row - c) * (row - c) + (col - c) * (col - c);
+                if (best < 0 || d2 < best)
+                {
+                    best = d2;
+                    out.hit = true;
+                    out.id = table->pickIds[key];
+                }
+            }
+        }
+        if (out.hit)
+            out.distance = int(std::lround(std::sqrt(double(best))));
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+RenderStats Renderer::stats() const
+{
+    RenderStats s = stats_;
+    for (int i = 0; i < 2; ++i)
+    {
+        // 后台上传期间上一代仍在绘制
+        for (const GpuBufferHeap *heap : {&heaps_[i], &retiredHeaps_[i]})
+        {
+            const GpuBufferHeap::Counters &c = heap->counters();
+            s.drawCalls += c.drawCalls;
+            s.bytesUploaded += c.bytesUploaded;
+            s.bytesCopied += c.bytesCopied;
+        }
+    }
+    s.bytesStaged = staging_.bytesWritten();
+    s.stagingStalls = staging_.stalls() + stream_.stalls();
+    return s;
+}
+
+void Renderer::resetStats()
+{
+    std::uint32_t visible = stats_.visibleEntities;
+    stats_ = RenderStats{};
+    stats_.visibleEntities = visible;
+    for (auto &heap : heaps_)
+        heap.resetCounters();
+    for (auto &heap : retiredHeaps_)
+        heap.resetCounters();
+    staging_.resetCounters();
+    stream_.resetCounters();
+}
+
+void Renderer::drawLineStrip(const std::vector<glm::vec3> &pts,
+                             std::uint32_t rgba,
+                             const ViewportState &vp,
+                             float widthPx)
+{
+    drawImmediate_(pts.data(), pts.size(), GL_LINE_STRIP, rgba, vp, widthPx);
+}
+
+void Renderer::drawLineSegments(const std::vector<glm::vec3> &ptsPairs,
+                                std::uint32_t rgba,
+                                const ViewportState &vp,
+                                float widthPx)
+{
+    drawImmediate_(ptsPairs.data(), ptsPairs.size(), GL_LINES, rgba, vp, widthPx);
+}
+
+void Renderer::drawImmediate_(const glm::vec3 *pts, std::size_t n, GLenum mode,
+                              std::uint32_t rgba, const ViewportState &vp, float widthPx)
+{
+    if (n < 2 || !shaderLines_)
+    {
+        return;
+    }
+
+    // 直接写进流式环形缓冲：不创建 GL 对象，也不分配堆内存
+    GLint first = 0;
+    void *dst = stream_.map(GLsizeiptr(n), sizeof(PosVertex), first);
+    if (!dst)
+    {
+        return;
+    }
+    static_assert(sizeof(PosVertex) == sizeof(glm::vec3), "PosVertex must be a bare vec3");
+    std::memcpy(dst, pts, n * sizeof(PosVertex));
+    stream_.unmap();
+
+    // ✅ 使用着色器绘制
+    setCamera(vp);
+
+    float r = ((rgba >> 24) & 0xFF) / 255.0f;
+    float g = ((rgba >> 16) & 0xFF) / 255.0f;
+    float b = ((rgba >> 8) & 0xFF) / 255.0f;
+    float a = ((rgba) & 0xFF) / 255.0f;
+
+    if (wideLines_)
+    {
+        // 线段两端指向本次写入的位置；GL_LINES 步长两个顶点，线带步长一个顶点
+        GLsizei stride = GLsizei((mode == GL_LINES ? 2 : 1) * sizeof(PosVertex));
+        GLsizei segments = GLsizei(mode == GL_LINES ? n / 2 : n - 1);
+        std::uintptr_t base = std::uintptr_t(first) * sizeof(PosVertex);
+
+        glBindVertexArray(streamSegVao_);
+        glBindBuffer(GL_ARRAY_BUFFER, stream_.buffer());
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)base);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void *)(base + sizeof(PosVertex)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // 颜色按着色器的字节序 (A, B, G, R) 给出；键 0 表示非实体几何
+        glVertexAttrib4f(1, a, b, g, r);
+        glVertexAttribI4ui(2, 0, 0, 0, 0);
+        glVertexAttribI4ui(4, 0, 0, 0, 0);
+
+        beginLineBlend_();
+        shaderWideLine_->use();
+        shaderWideLine_->setFloat(wideLineWidthLoc_, widthPx);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, segments);
+        glBindVertexArray(0);
+        endLineBlend_();
+    }
+    else
+    {
+        shaderLines_->use();
+        shaderLines_->setVec4(lineColorLoc_, glm::vec4(r, g, b, a));
+        glBindVertexArray(streamVao_);
+        // 持久映射的环扩容时会换缓冲，属性指针每次重新指向当前缓冲
+        glBindBuffer(GL_ARRAY_BUFFER, stream_.buffer());
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PosVertex), (void *)0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDrawArrays(mode, first, static_cast<GLsizei>(n));
+        glBindVertexArray(0);
+    }
+    ++stats_.drawCalls;
+    stats_.bytesUploaded += n * sizeof(PosVertex);
+}
+
+// ========== 打包实体（CPU 阶段，可在工作线程上执行） ==========
+
+// 折线打包进分片的顶点数组；闭合时补回起点
+static void packStrip(PackShard &out, PackedEntity &e, const glm::vec3 *pts, std::size_t n, bool closed,
+                      std::uint32_t rgba)
+{
+    if (n < 2)
+    {
+        e.kind = PackKind::Empty;
+        return;
+    }
+    e.kind = PackKind::Strip;
+    e.first = std::uint32_t(out.vertices.size());
+    e.count = std::uint32_t(n + (closed ? 1 : 0));
+    for (std::size_t i = 0; i < n; ++i)
+        out.vertices.push_back({pts[i], rgba});
+    if (closed)
+        out.vertices.push_back({pts[0], rgba});
+}
+
+static constexpr float kTwoPi = 2.0f * float(M_PI);
+
+// 张角归一化到 [0, 2pi]
+static float arcSpan(const Arc &A)
+{
+    float span = A.a1 - A.a0;
+    while (span < 0)
+        span += kTwoPi;
+    while (span > kTwoPi)
+        span -= kTwoPi;
+    return span;
+}
+
+template <class G>
+void Renderer::packEntity_(PackShard &out, EntityId id, const G &g, const Style &s, bool visible,
+                           const ViewportState &vp) const
+{
+    PackedEntity e;
+    e.id = id;
+    e.style = s;
+    e.visible = visible;
+    std::uint32_t rgba = s.rgba;
+
+    if constexpr (std::is_same_v<G, Line>)
+    {
+        e.kind = PackKind::Segments;
+        e.first = std::uint32_t(out.vertices.size());
+        e.count = 2;
+        out.vertices.push_back({g.p0, rgba});
+        out.vertices.push_back({g.p1, rgba});
+    }
+    else if constexpr (std::is_same_v<G, Polyline>)
+    {
+        if (g.pts.pageCount() > 1)
+        {
+            // 多页折线由提交阶段逐页读取，只上传变化的页
+            e.kind = PackKind::Pages;
+            e.polyline = &g;
+        }
+        else
+        {
+            const glm::vec3 *pts = g.pts.pageCount() ? g.pts.page(0).pts : nullptr;
+            packStrip(out, e, pts, g.pts.size(), g.closed, rgba);
+        }
+    }
+    else if constexpr (std::is_same_v<G, Circle> || std::is_same_v<G, Arc>)
+    {
+        constexpr bool isCircle = std::is_same_v<G, Circle>;
+        if (analyticCurves_)
+        {
+            glm::vec2 angles(0.0f, kTwoPi);
+            if constexpr (!isCircle)
+                angles = glm::vec2(g.a0, arcSpan(g));
+            e.kind = PackKind::Curve;
+            e.first = std::uint32_t(out.curves.size());
+            out.curves.push_back(CurveInstance{glm::vec4(g.c, g.r), angles, rgba});
+        }
+        else
+        {
+            e.tessScale = tessScaleFor(vp.worldPerPixel);
+            float worldEps = e.tessScale * 0.5f;
+            if constexpr (isCircle)
+                tessellateCircle(g, worldEps, out.curvePts);
+            else
+                tessellateArc(g, worldEps, out.curvePts);
+            packStrip(out, e, out.curvePts.data(), out.curvePts.size(), isCircle, rgba);
+        }
+    }
+    else if constexpr (std::is_same_v<G, Box>)
+    {
+        // 只写一条实例记录；几何由共用的单位立方体在 vertex shader 中变换得到
+        BoxInstance inst;
+        inst.centerSize = glm::vec4(g.center, g.size);
+        inst.rotation = g.rotation;
+        inst.rgba = rgba;
+        e.kind = PackKind::Box;
+        e.first = std::uint32_t(out.boxes.size());
+        out.boxes.push_back(inst);
+    }
+    out.entities.push_back(e);
 }
 
 // ========== 细分：保证弧边弦高误差约 <= worldEps ==========
@@ -657,36 +2705,28 @@ static int segsForRadius(float r, float worldEps, float spanRadians)
     return std::max(8, std::min(n, 360)); // 限制在 [8, 360]
 }
 
-std::vector<glm::vec3> Renderer::tessellateCircle(const Circle &C, float worldEps)
+void Renderer::tessellateCircle(const Circle &C, float worldEps, std::vector<glm::vec3> &out)
 {
-    int n = segsForRadius(C.r, worldEps, 2.0f * float(M_PI));
-    std::vector<glm::vec3> pts;
-    pts.reserve(n);
+    int n = segsForRadius(C.r, worldEps, kTwoPi);
+    out.clear();
+    out.reserve(n);
     for (int i = 0; i < n; i++)
     {
-        float t = (float(i) / float(n)) * 2.0f * float(M_PI);
-        pts.push_back({C.c.x + C.r * std::cos(t), C.c.y + C.r * std::sin(t), C.c.z});
+        float t = (float(i) / float(n)) * kTwoPi;
+        out.push_back({C.c.x + C.r * std::cos(t), C.c.y + C.r * std::sin(t), C.c.z});
     }
-    return pts;
 }
 
-std::vector<glm::vec3> Renderer::tessellateArc(const Arc &A, float worldEps)
+void Renderer::tessellateArc(const Arc &A, float worldEps, std::vector<glm::vec3> &out)
 {
-    float span = A.a1 - A.a0;
-    // 归一化到 [0, 2pi]
-    while (span < 0)
-        span += 2.0f * float(M_PI);
-    while (span > 2.0f * float(M_PI))
-        span -= 2.0f * float(M_PI);
-
+    float span = arcSpan(A);
     int n = segsForRadius(A.r, worldEps, span);
     n = std::max(2, n);
-    std::vector<glm::vec3> pts;
-    pts.reserve(n + 1);
+    out.clear();
+    out.reserve(n + 1);
     for (int i = 0; i <= n; i++)
     {
         float t = A.a0 + span * (float(i) / float(n));
-        pts.push_back({A.c.x + A.r * std::cos(t), A.c.y + A.r * std::sin(t), A.c.z});
+        out.push_back({A.c.x + A.r * std::cos(t), A.c.y + A.r * std::sin(t), A.c.z});
     }
-    return pts;
-}
\ No newline at end of file
+}
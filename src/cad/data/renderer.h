@@ -1,5 +1,6 @@
 #pragma once
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <memory>
 #include <QOpenGLFunctions_3_3_Core>
@@ -8,6 +9,25 @@
 
 #include <glm/glm.hpp>
 #include "document.h"
+#include "gpuheap.h"
+#include "workerpool.h"
+#include "uploadworker.h"
+
+// 视锥：6 个平面 (a, b, c, d)，a*x + b*y + c*z + d >= 0 为内侧
+struct Frustum {
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4& viewProj);
+
+    // 0 = 完全在外，1 = 相交，2 = 完全在内
+    int classify(const Aabb& b) const;
+    // 盒子各向外扩 pad（世界单位）后再分类
+    int classify(const Aabb& b, float pad) const
+    {
+        return classify(pad > 0.0f ? Aabb(b.min - glm::vec3(pad), b.max + glm::vec3(pad)) : b);
+    }
+    bool intersects(const Aabb& b) const { return classify(b) != 0; }
+};
 
 struct ViewportState {
     int width = 0, height = 0;
@@ -48,17 +68,163 @@ struct ViewportState {
     
     // ✅ 获取视锥体的 8 个角点（世界坐标）
     void getFrustumCorners(glm::vec3 corners[8]) const;
+
+    // 视锥平面（世界坐标），用于包围盒裁剪
+    Frustum frustum() const;
 };
 
 // 最小顶点结构（仅位置）
 struct PosVertex { glm::vec3 pos; };
 
-// GPU 批次（v0.1 每实体一个批次）
-struct GpuBatch {
-    GLuint vao = 0, vbo = 0, ibo = 0;
-    GLsizei indexCount = 0;
+// 实体在 GPU 缓冲堆中的位置
+struct HeapRange {
+    std::uint8_t heap = 0;                          // 见 Renderer::heaps_
+    GpuBufferHeap::Handle handle = GpuBufferHeap::kInvalid;
+};
+
+// 多页折线的一页在线带堆中的分配：页内点 + 连接点（下一页首点，闭合折线末页为起点）+ 一个拾取键为 0 的终止顶点。
+// 终止顶点让宽线整段绘制时与相邻分配之间的伪线段两端键不同而被丢弃（同一实体的页键相同，不能靠键区分）。
+// 页戳记与连接点都没变的页不重新上传
+struct PageRange {
+    std::uint64_t stamp = 0;
+    glm::vec3 connector{0.0f};
+    bool hasConnector = false;
+    GpuBufferHeap::Handle handle = GpuBufferHeap::kInvalid;
+    Aabb bounds;  // 含连接点，用于逐页视锥裁剪
+};
+
+// 圆 / 圆弧实例记录：由 vertex shader 按投影半径展开，缩放时无需 CPU 重新细分
+struct CurveInstance {
+    glm::vec4 centerRadius;       // xyz = 圆心, w = 半径
+    glm::vec2 angles;             // 起始角, 张角（弧度，(0, 2π]）
+    std::uint32_t rgba = 0xFFFFFFFF;
+    std::uint32_t pickId = 0;     // 拾取键（同时把记录对齐到 32 字节）
+};
+
+// 实体属性表的一项（纹理缓冲 RG32UI）：着色器按顶点上的实体键取颜色、标志与线宽，
+// 改色、显隐、选择只改这一项，不重新上传几何
+struct EntityAttr {
+    std::uint32_t rgba = 0;   // 0xRRGGBBAA
+    std::uint32_t flags = 0;  // 低 16 位 EntityFlags，高 16 位线宽（像素，12.4 定点）
+};
+
+enum EntityFlags : std::uint32_t {
+    kEntityVisible     = 1u << 0,
+    kEntitySelected    = 1u << 1,
+    kEntityHighlighted = 1u << 2,
+    kEntityFlagMask    = 0xFFFFu,
+};
+
+// 实体属性表：纹理缓冲与 CPU 镜像，[dirtyBegin, dirtyEnd) 为待上传区间，下标同拾取键（实体下标 + 1）。
+// generation 标识它属于哪一代缓冲：后台上传期间上一代带着自己的一份继续显示与拾取
+struct AttrTable {
+    GLuint buffer = 0, tex = 0;
+    std::size_t capacity = 0;
+    std::vector<EntityAttr> attrs;
+    std::vector<EntityId> pickIds;  // 拾取键 → EntityId
+    std::size_t dirtyBegin = 0, dirtyEnd = 0;
+    std::uint64_t generation = 0;
+};
+
+// 立方体实例记录：所有立方体共用一个单位立方体网格，变换在 vertex shader 中展开
+struct BoxInstance {
+    glm::vec4 centerSize;         // xyz = 中心, w = 边长
+    glm::vec3 rotation{0.0f};     // 欧拉角（弧度，按 X、Y、Z 顺序，同 glm::eulerAngleXYZ）
     std::uint32_t rgba = 0xFFFFFFFF;
-    GLenum drawMode = GL_LINES;  // GL_LINES, GL_LINE_STRIP, GL_TRIANGLES
+    std::uint32_t pickId = 0;
+};
+
+// 实例批次：稠密数组（删除 swap-and-pop），CPU 镜像 + 脏区间上传
+template <class T>
+struct InstanceBatch {
+    GLuint vao = 0, vbo = 0;
+    GLsizeiptr capacityBytes = 0;
+
+    std::vector<T>        instances;
+    std::vector<EntityId> owners;
+    std::unordered_map<EntityId, std::uint32_t> index;  // 实体 → 实例下标
+
+    // 待上传的实例区间 [dirtyBegin, dirtyEnd)
+    std::size_t dirtyBegin = 0, dirtyEnd = 0;
+
+    // 视锥裁剪后的可见实例，每帧重写到独立缓冲
+    GLuint cullVao = 0, cullVbo = 0;
+    GLsizeiptr cullCapacityBytes = 0;
+    std::vector<T> visible;
+};
+
+using CurveBatch = InstanceBatch<CurveInstance>;
+using BoxBatch = InstanceBatch<BoxInstance>;
+
+// 同步的 CPU 阶段对一个实体的打包结果，GL 阶段据此分配缓冲并提交
+enum class PackKind : std::uint8_t {
+    Removed,   // 实体已删除
+    Empty,     // 没有可画的几何（不足两个点的折线）
+    Segments,  // 直线：vertices 中的顶点对，进 heaps_[0]
+    Strip,     // 折线 / CPU 细分的曲线：vertices 中的折线，进 heaps_[1]
+    Pages,     // 多页折线：不拷贝顶点，提交时直接按页读取 polyline，每页一个 heaps_[1] 分配
+    Curve,     // curves 中的一条实例
+    Box,       // boxes 中的一条实例
+};
+
+struct PackedEntity {
+    EntityId id = 0;
+    Style style;
+    bool visible = true;
+    PackKind kind = PackKind::Removed;
+    std::uint32_t first = 0, count = 0;  // vertices 中的区间；实例为下标
+    float tessScale = 0.0f;              // CPU 细分曲线的细分尺度，其它为 0
+    const Polyline* polyline = nullptr;  // Pages：指向文档中的几何，打包到提交之间文档不会变化
+};
+
+// 一个分片的暂存数据：每个分片只由一个线程写入，按实体顺序排列
+struct PackShard {
+    std::vector<PackedEntity> entities;
+    std::vector<BatchVertex> vertices;
+    std::vector<CurveInstance> curves;
+    std::vector<BoxInstance> boxes;
+    std::vector<glm::vec3> curvePts;  // 细分临时缓冲
+
+    void clear()
+    {
+        entities.clear();
+        vertices.clear();
+        curves.clear();
+        boxes.clear();
+    }
+};
+
+// 相机 uniform block（std140），与着色器中的 Camera 块逐字段对应
+struct CameraBlock {
+    glm::mat4 view{1.0f};
+    glm::mat4 proj{1.0f};
+    glm::mat4 viewProj{1.0f};
+    glm::vec2 viewport{0.0f};  // 像素尺寸
+    float worldPerPixel = 1.0f;
+    float pad = 0.0f;
+};
+static_assert(sizeof(CameraBlock) == 208, "CameraBlock must match the std140 layout");
+
+// 拾取结果
+struct PickResult {
+    bool hit = false;
+    EntityId id = 0;
+    int distance = 0;  // 命中像素到拾取点的距离（像素）
+};
+
+// 渲染统计：计数在两次 resetStats() 之间累计（visibleEntities 为最近一次 draw 的值）
+struct RenderStats {
+    std::uint32_t drawCalls = 0;         // glDraw* 调用数
+    std::uint64_t bytesUploaded = 0;     // CPU → GPU 写入字节
+    std::uint64_t bytesCopied = 0;       // 缓冲整理的 GPU 内部拷贝字节
+    std::uint32_t entitiesUploaded = 0;  // 重新打包上传的实体数
+    std::uint32_t fullRebuilds = 0;      // 全量重建次数
+    std::uint32_t visibleEntities = 0;   // 提交绘制的实体数
+    std::uint32_t curvesRetessellated = 0; // CPU 细分模式下因缩放重新细分的曲线数
+    std::uint32_t entitiesPatched = 0;   // 只改写了部分顶点的实体数（点数不变的局部修改）
+    std::uint64_t bytesStaged = 0;       // 经上传暂存环拷贝到 GPU 缓冲的字节（bytesUploaded 的一部分）
+    std::uint32_t stagingStalls = 0;     // 环形缓冲回绕时 fence 未触发、CPU 真正等待的次数
+    std::uint32_t pagesUploaded = 0;     // 多页折线重新上传的页数（未变化的页不计）
 };
 
 class Renderer : protected QOpenGLFunctions_3_3_Core {
@@ -68,7 +234,7 @@ public:
     bool initialize(); // 编译最小线条 shader
     void shutdown();
 
-    // 增量同步：仅上传脏实体
+    // 增量同步：按 Document 变更日志只处理自上次同步以来的增删改
     void syncFromDocument(const Document& doc, const ViewportState& vp, bool forceRebuild = false);
     
     // 移除单个实体的批次
@@ -77,34 +243,323 @@ public:
     // 绘制所有批次
     void draw(const ViewportState& vp);
 
-    // 低阶画线（供网格/坐标轴等临时使用）
-    void drawLineStrip(const std::vector<glm::vec3>& pts, std::uint32_t rgba, const ViewportState& vp);
-    void drawLineSegments(const std::vector<glm::vec3>& ptsPairs, std::uint32_t rgba, const ViewportState& vp);
+    // 文档层缓存：网格与实体画进离屏颜色 + 深度缓冲，视图、已同步的文档版本与 layerKey
+    // （调用方的其它静态状态，如网格开关）都不变时，之后每帧只需 compositeStaticLayer 一次全屏 blit，
+    // 其上再叠加 drawOverlay、坐标轴等。beginStaticLayer 返回 true 表示缓存需要重画：
+    // 此时已绑定并清空层缓冲，调用方画完静态内容（drawStatic）后调用 endStaticLayer。
+    // 层缓冲的尺寸与采样数跟随当前视口与帧缓冲；创建失败时直接画在当前帧缓冲上
+    bool beginStaticLayer(const ViewportState& vp, std::uint64_t layerKey = 0);
+    void endStaticLayer();
+    void compositeStaticLayer();
+    void invalidateStaticLayer() { layerValid_ = false; }
+
+    // 缓存层的实体内容：选中 / 高亮按原色画，不含预览。
+    // 后台上传未完成时例外：选中 / 高亮直接画进文档层，标志变化使缓存失效，叠加层不重画
+    void drawStatic(const ViewportState& vp);
+    // 叠加层：重画选中 / 高亮的实体（与文档层同深度），再画预览
+    void drawOverlay(const ViewportState& vp);
+
+    // 选择 / 高亮：只改属性表中的标志位（实体须已同步）
+    void setSelected(EntityId id, bool on);
+    void setHighlighted(EntityId id, bool on);
+
+    // 更新相机 uniform block（绑定点 Shader::kCameraBinding）；与上次相同时不上传。
+    // 渲染器自己的绘制会调用；网格/坐标轴等共用该块的绘制前也应调用
+    void setCamera(const ViewportState& vp);
+
+    // 即时模式的流式环形缓冲，供网格等辅助绘制直接写入映射内存（写完 unmapStream）。
+    // VAO 以偏移 0 绑定 streamBuffer()、用 first 定位；缓冲可能因扩容而更换，每次绘制前重新绑定
+    void* mapStream(GLsizeiptr count, GLsizeiptr stride, GLint& outFirst) { return stream_.map(count, stride, outFirst); }
+    void unmapStream() { stream_.unmap(); }
+    GLuint streamBuffer() const { return stream_.buffer(); }
+
+    // 圆与圆弧的绘制方式：true = GPU 解析展开（默认），false = CPU 细分为折线
+    // 切换后下一次同步会全量重建
+    void setAnalyticCurves(bool on);
+    bool analyticCurves() const { return analyticCurves_; }
+
+    // CPU 细分模式下缩放引起的重新细分按帧分摊：相机变化后把视野内精度不匹配的曲线
+    // 按屏幕误差从大到小排队，每次同步最多花 ms 毫秒处理，未处理的曲线继续画旧的细分结果。
+    // 队列未清空时调用方应继续请求下一帧
+    void setRetessellateBudget(double ms) { retessBudgetMs_ = ms; }
+    double retessellateBudget() const { return retessBudgetMs_; }
+    bool retessellatePending() const { return retessHead_ < retessQueue_.size(); }
+
+    // 屏幕空间宽线（默认开启）：直线、折线与圆 / 圆弧在 vertex shader 中展开为屏幕对齐的四边形，
+    // 按 Style::lineWidth（像素）绘制，圆头与圆角连接，边缘解析抗锯齿，不依赖 MSAA。
+    // 关闭后退回 GL_LINES / GL_LINE_STRIP（1 像素，无抗锯齿）
+    void setWideLines(bool on) { wideLines_ = on; }
+    bool wideLines() const { return wideLines_; }
+
+    // 同步的 CPU 阶段（细分与顶点打包）的线程数：0 = 按硬件线程数（默认），1 = 只用调用线程。
+    // 实体较多时按实体区间分片并行打包，GL 调用始终只在调用线程上
+    void setWorkerThreads(unsigned n);
+    unsigned workerThreads() const { return workerThreads_; }
+
+    // 后台上传：全量重建（包括一次同步中大部分实体都变了的大批导入）且顶点数据较多时，
+    // 打包好的 arena 交给共享上下文的上传线程建缓冲，期间继续显示上一代几何并暂缓拉取文档变更，
+    // 各 arena 的 fence 触发后由绘制接回，全部就绪时换下上一代。
+    // 须在渲染上下文为当前时调用；共享上下文创建失败时返回 false，保持同步上传
+    bool setBackgroundUpload(bool on);
+    bool backgroundUpload() const { return uploader_ != nullptr; }
+    bool uploadPending() const { return streaming_; }
+
+    // 视锥裁剪（默认开启）：借助 Document 的空间索引跳过视野外的实体
+    void setCulling(bool on);
+    bool culling() const { return culling_; }
+
+    // ID 缓冲拾取：以窗口像素 (x, y)（左上为原点）为中心、边长 2 * radius + 1 的小窗口
+    // 把实体拾取键画进整型 FBO，经 PBO + fence 异步读回，绘制管线不会等待 GPU。
+    // 投影被缩放到这个小窗口，再借空间索引裁剪，代价只取决于光标附近的实体数量。
+    // 应在 draw 之后调用；结果在之后的帧由 pollPick 取得，新请求会取代未完成的请求
+    void requestPick(const ViewportState& vp, int x, int y, int radius = 4);
+    bool pickPending() const { return pickFence_ != nullptr; }
+    // 非阻塞：结果就绪时返回 true 并写入 out（取离拾取点最近的命中像素）
+    bool pollPick(PickResult& out);
+
+    // 交互预览层：绘图工具进行中的几何不进 Document，放在常驻的小动态缓冲里，
+    // 每次更新只有一次 glBufferSubData（放不下时先扩容），draw 时叠加在实体之上。鼠标松开后由调用方提交到文档
+    void setPreviewLine(const glm::vec3& a, const glm::vec3& b, std::uint32_t rgba);
+    void setPreviewPolyline(const glm::vec3* pts, std::size_t n, bool closed, std::uint32_t rgba);
+    void setPreviewCircle(const Circle& c, std::uint32_t rgba, const ViewportState& vp);
+    void setPreviewBox(const Box& b, std::uint32_t rgba);  // 线框
+    void clearPreview() { previewCount_ = 0; }
+    bool hasPreview() const { return previewCount_ > 0; }
+
+    // 统计（基准测试与调试面板使用）
+    RenderStats stats() const;
+    void resetStats();
+
+    // 低阶画线（供网格/坐标轴等临时使用）；widthPx 只在宽线模式下生效
+    void drawLineStrip(const std::vector<glm::vec3>& pts, std::uint32_t rgba, const ViewportState& vp,
+                       float widthPx = 1.0f);
+    void drawLineSegments(const std::vector<glm::vec3>& ptsPairs, std::uint32_t rgba, const ViewportState& vp,
+                          float widthPx = 1.0f);
 
 private:
-    // 上传 helpers
-    void uploadLine_(EntityId id, const Line& L, std::uint32_t rgba);
-    void uploadPolyline_(EntityId id, const Polyline& P, std::uint32_t rgba);
-    void uploadCircle_(EntityId id, const Circle& C, std::uint32_t rgba, const ViewportState& vp);
-    void uploadArc_(EntityId id, const Arc& A, std::uint32_t rgba, const ViewportState& vp);
-    void uploadBox_(EntityId id, const Box& B, std::uint32_t rgba);
+    // 同步分两个阶段：packEntities_ 把 ids 按区间分片，在线程池上细分并打包到 shards_
+    // （只读 Document 与渲染器配置，不调用 GL）；commitShards_ 在调用线程上按顺序分配缓冲堆区间、
+    // 写入实例与属性表，相邻区间的顶点合并成少数几次传输
+    void packEntities_(const Document& doc, const std::vector<EntityId>& ids, const ViewportState& vp);
+    template <class G>
+    void packEntity_(PackShard& out, EntityId id, const G& g, const Style& s, bool visible,
+                     const ViewportState& vp) const;
+    void commitShards_(std::size_t count, bool writeAttrs);
+    void commitEntity_(const PackShard& shard, const PackedEntity& e, bool writeAttrs);
+
+    // 后台上传：beginStreaming_ 把正在显示的堆换到 retiredHeaps_ 并让 heaps_ 延迟上传，
+    // 提交后 submitStaged_ 把各 arena 交给上传线程；adoptUploads_ 接回 fence 已触发的 arena
+    void beginStreaming_();
+    void submitStaged_();
+    void cancelStreaming_();
+    void adoptUploads_();
+    void dropUploadResults_();
+    void dropRetired_();
+
+    // 折线细分：保证屏幕误差 ~ 0.5 像素（写入 out，复用其容量）
+    static void tessellateCircle(const Circle& C, float worldEps, std::vector<glm::vec3>& out);
+    static void tessellateArc(const Arc& A, float worldEps, std::vector<glm::vec3>& out);
+
+    // 缓冲堆管理：顶点/索引数不变时原地写入，否则重新分配
+    void putRange_(std::uint8_t heap, EntityId id, const BatchVertex* v, std::size_t n,
+                   const GLuint* idx = nullptr, std::size_t ni = 0);
+    void releaseRange_(EntityId id);
+    // 多页折线：逐页分配，戳记与连接点未变的页保留原分配
+    void putPages_(EntityId id, const Polyline& P, std::uint32_t rgba);
+    void releasePages_(EntityId id);
+    // 局部修改：按变更日志的点区间原地改写已有分配的顶点；布局对不上时返回 false，由调用方整体重新打包
+    void patchEntities_(const Document& doc);
+    bool patchVertices_(const Document& doc, EntityId id, std::uint32_t first, std::uint32_t end);
+
+    // 实例批次管理（圆 / 圆弧与立方体共用）
+    template <class T> void putInstance_(InstanceBatch<T>& b, EntityId id, const T& inst);
+    template <class T> void releaseInstance_(InstanceBatch<T>& b, EntityId id);
+    template <class T> void flushInstances_(InstanceBatch<T>& b);
+    template <class T> void uploadVisibleInstances_(InstanceBatch<T>& b);
+    template <class T> void freeInstanceBatch_(InstanceBatch<T>& b);
+    void initInstanceBatches_();
+    void setupCurveVao_(GLuint vao, GLuint vbo);
+    void setupBoxVao_(GLuint vao, GLuint vbo);
+
+    // CPU 细分模式：相机变化后收集视野内精度不再匹配的圆 / 圆弧，按屏幕误差排序；
+    // 之后每帧在预算内处理队列
+    float retessError_(EntityId id, float worldPerPixel) const;
+    void queueRetessellation_(const Document& doc, const ViewportState& vp);
+    void retessellateQueued_(const Document& doc, const ViewportState& vp);
+    // 收集视野内的实体到 visibleIds_；返回 false 表示应整批绘制
+    bool cullVisible_(const ViewportState& vp);
+    float cullPad_(const ViewportState& vp) const;  // 宽线裁剪时包围盒的外扩（世界单位）
+    void clearBatches_();
+
+    // 一次实体绘制所用的程序（普通颜色 / 拾取键各一组）
+    struct PassPrograms {
+        Shader* batch;
+        Shader* curve;
+        Shader* box;
+        Shader* wideLine;
+        Shader* wideCurve;
+        bool blend;  // 宽线的抗锯齿覆盖率需要混合；拾取 pass 写整型键，不混合
+    };
+
+    // 一次完整的实体绘制（普通颜色 / 拾取键共用）；subset 非空时只画其中的实体。
+    // 返回是否走了子集
+    bool drawPass_(const ViewportState& vp, const PassPrograms& programs,
+                   const std::vector<EntityId>* subset = nullptr);
+    void setBaseLayer_(bool on);
+    bool ensureLayerTarget_(int width, int height, int samples);
+    void freeLayerTarget_();
+
+    // 宽线的抗锯齿边缘：开启混合，半透明边缘不写深度；end 时恢复
+    void beginLineBlend_();
+    void endLineBlend_();
 
-    // 折线细分：保证屏幕误差 ~ 0.5 像素
-    static std::vector<glm::vec3> tessellateCircle(const Circle& C, float worldEps);
-    static std::vector<glm::vec3> tessellateArc(const Arc& A, float worldEps);
+    // 即时模式画线：写入流式环形缓冲后一次绘制
+    void drawImmediate_(const glm::vec3* pts, std::size_t n, GLenum mode, std::uint32_t rgba,
+                        const ViewportState& vp, float widthPx);
 
-    // GL utils
-    GLuint makeVao(GLuint vbo, GLuint ibo);
-    void freeBatch_(GpuBatch& b);
+    // 预览层：折线按线段展开追加到 previewScratch_，再整体上传
+    void appendPreviewStrip_(const glm::vec3* pts, std::size_t n, bool closed, std::uint32_t rgba);
+    void uploadPreview_();
+    void drawPreview_(const ViewportState& vp);
+
+    // 实体属性表
+    void writeAttr_(EntityId id, const Style& s, bool visible);
+    void clearAttr_(EntityId id);
+    void setAttrFlag_(EntityId id, std::uint32_t flag, bool on);
+    void markAttrDirty_(AttrTable& t, std::uint32_t key);
+    void flushAttrs_(AttrTable& t);
+    void initAttrTable_(AttrTable& t);
+    void freeAttrTable_(AttrTable& t);
+    // 后台上传期间对上一代属性表的同步：id 仍在上一代中时返回它的一项（已标脏）
+    EntityAttr* retiredEntry_(EntityId id);
+    void restyleRetired_(const Document& doc, const Change& c);
+
+    // 拾取
+    std::uint32_t pickKey_(EntityId id);
+    bool ensurePickTarget_(int size);
+    void freePickTarget_();
 
 private:
     
     // ✅ 使用自定义 Shader
     std::unique_ptr<Shader> shaderLines_;
 
-    // 每实体一个批（v0.1 简单实现；后续可合批）
-    std::unordered_map<EntityId, GpuBatch> batches_;
-    
-    // 缓存上次细分时的 worldPerPixel，用于判断是否需要重新细分
-    float lastWorldPerPixel_ = -1.0f;
+    std::unique_ptr<Shader> shaderBatch_;  // 合批 shader：颜色来自顶点属性
+    std::unique_ptr<Shader> shaderCurve_;  // 曲线实例 shader
+    std::unique_ptr<Shader> shaderBatchPick_;  // 同一顶点 shader，输出拾取键
+    std::unique_ptr<Shader> shaderCurvePick_;
+    std::unique_ptr<Shader> shaderCube_;       // 立方体实例 shader（逐面法线光照）
+    std::unique_ptr<Shader> shaderCubePick_;
+    std::unique_ptr<Shader> shaderWideLine_;      // 宽线：实例化线段展开为四边形
+    std::unique_ptr<Shader> shaderWideCurve_;     // 宽线模式的曲线实例
+    std::unique_ptr<Shader> shaderWideLinePick_;
+    std::unique_ptr<Shader> shaderWideCurvePick_;
+    PassPrograms colorPass_{}, pickPass_{};
+    GLint wideLineWidthLoc_ = -1;
+    bool wideLines_ = true;
+    float maxLineWidth_ = 0.0f;  // 已写入属性表的最大实体线宽（像素，只增不减，清空时归零），宽线裁剪按它外扩
+    GLboolean blendWas_ = GL_FALSE, depthMaskWas_ = GL_TRUE;
+
+    // GPU 缓冲堆：[0] 直线（GL_LINES），[1] 折线/圆/圆弧（GL_LINE_STRIP）
+    GpuBufferHeap heaps_[2];
+    std::unordered_map<EntityId, HeapRange> ranges_;
+    std::unordered_map<EntityId, std::vector<PageRange>> pageRanges_;  // 多页折线，与 ranges_ 互斥
+    std::vector<BatchVertex> pageScratch_;
+    std::vector<glm::vec3> curvePts_;   // 复用的细分点缓冲（预览）
+
+    // 同步的 CPU 阶段：分片暂存（保留容量）、全量重建的实体列表与线程池（首次并行打包时创建）
+    std::vector<PackShard> shards_;
+    std::vector<EntityId> packIds_;
+    std::unique_ptr<WorkerPool> pool_;
+    unsigned workerThreads_ = 0;
+
+    // 后台上传：上传期间 heaps_ 是新一代（arena 陆续接回），retiredHeaps_ 是仍在显示的上一代。
+    // uploadTicket_ 区分重建批次，uploadResults_ 为已完成但 fence 未触发的 arena
+    std::unique_ptr<UploadWorker> uploader_;
+    GpuBufferHeap retiredHeaps_[2];
+    bool streaming_ = false;
+    std::uint64_t uploadTicket_ = 0;
+    std::size_t uploadsInFlight_ = 0;
+    std::vector<UploadWorker::Result> uploadResults_;
+    // 上一代的属性表与曲线 / 盒子批次（上传期间显示它们，开始上传时与当前的交换）
+    AttrTable retiredAttr_;
+    CurveBatch retiredCurves_;
+    BoxBatch retiredBoxes_;
+    // 上传期间拉取的文档变更：样式、删除即时同步到上一代，全部在新一代接回后再应用
+    std::vector<Change> pendingChanges_;
+
+    // 圆 / 圆弧实例
+    CurveBatch curves_;
+    bool analyticCurves_ = true;
+    // 曲线绘制方式切换、后台上传中途关闭后，下一次同步全量重建
+    bool rebuildRequested_ = false;
+
+    // 立方体实例：共用的单位立方体网格（24 顶点带面法线 + 36 索引）
+    BoxBatch boxes_;
+    GLuint boxMeshVbo_ = 0, boxMeshIbo_ = 0;
+
+    // Document 变更日志游标
+    ChangeCursor cursor_;
+    std::vector<EntityId> touched_;   // 复用的临时缓冲：几何变化
+    std::vector<EntityId> restyled_;  // 只有样式 / 可见性变化
+    std::vector<Change> patched_;     // 点数不变的局部几何修改（带点区间）
+    std::vector<BatchVertex> patchScratch_;
+
+    // 最近一次同步的文档（供绘制时裁剪查询）
+    const Document* doc_ = nullptr;
+    bool culling_ = true;
+    std::vector<EntityId> visibleIds_;
+
+    // CPU 细分模式下每条曲线细分所用的尺度（worldPerPixel 向下取到 2 的幂），以及上次检查时的相机
+    std::unordered_map<EntityId, float> tessScale_;
+    glm::mat4 lastViewProj_{0.0f};
+    // 待重新细分的曲线（屏幕误差, id），误差大的在前；retessHead_ 之前的已处理
+    std::vector<std::pair<float, EntityId>> retessQueue_;
+    std::size_t retessHead_ = 0;
+    double retessBudgetMs_ = 2.0;
+
+    // 预览层（GL_LINES），initialize 时按 kPreviewVertices 分配，放不下时倍增；previewSegVao_ 供宽线按顶点对读取
+    GLuint previewVao_ = 0, previewVbo_ = 0, previewSegVao_ = 0;
+    GLsizei previewCount_ = 0;
+    GLsizei previewCapacity_ = 0;  // 顶点数
+    std::vector<BatchVertex> previewScratch_;
+
+    // 相机 uniform block 及其 CPU 副本（去重上传）
+    GLuint cameraUbo_ = 0;
+    CameraBlock camera_;
+    bool cameraValid_ = false;
+    GLint lineColorLoc_ = -1;
+
+    // drawLineStrip / drawLineSegments 的流式缓冲与常驻 VAO（streamSegVao_ 为宽线，每次绘制重设偏移）
+    StreamRing stream_;
+    GLuint streamVao_ = 0, streamSegVao_ = 0;
+    // 上传暂存环：缓冲写入先落到映射内存，再以 glCopyBufferSubData 拷到目标缓冲
+    StreamRing staging_;
+
+    // 拾取：R32UI 颜色 + 深度的小 FBO，读回用 PBO
+    GLuint pickFbo_ = 0, pickColor_ = 0, pickDepth_ = 0, pickPbo_ = 0;
+    int pickSize_ = 0;
+    GLsync pickFence_ = nullptr;
+    std::uint64_t pickGeneration_ = 0;  // 未读回的拾取画的是哪一代
+
+    // 实体属性表（当前一代）
+    AttrTable attr_;
+
+    // 选中或高亮的实体：文档层缓存不画这两种状态，由叠加层重画
+    std::unordered_set<EntityId> overlaySet_;
+    std::vector<EntityId> overlayIds_;
+
+    // 文档层缓存（渲染缓冲，采样数与目标帧缓冲一致才能 blit）与它对应的状态
+    GLuint layerFbo_ = 0, layerColor_ = 0, layerDepth_ = 0;
+    int layerWidth_ = 0, layerHeight_ = 0, layerSamples_ = 0;
+    GLint layerPrevFbo_ = 0;
+    GLint layerViewport_[4] = {0, 0, 0, 0};
+    bool layerValid_ = false;
+    bool layerFlagged_ = false;  // 缓存的文档层带着选中 / 高亮画出（后台上传期间），叠加层不再重画
+    glm::mat4 layerView_{0.0f}, layerProj_{0.0f};
+    std::uint64_t layerVersion_ = 0, layerKey_ = 0;
+    bool layerAnalytic_ = false, layerWide_ = false;
+
+    // 不属于缓冲堆的统计部分（堆自己计数，stats() 时合并）
+    RenderStats stats_;
 };
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include "spatialindex.h"
+
+// ============================================
+// 节点池
+// ============================================
+
+std::int32_t SpatialIndex::allocNode_()
+{
+    if (freeList_ == kNull)
+    {
+        nodes_.emplace_back();
+        return std::int32_t(nodes_.size() - 1);
+    }
+    std::int32_t node = freeList_;
+    freeList_ = nodes_[node].parent;
+    nodes_[node] = Node{};
+    return node;
+}
+
+void SpatialIndex::freeNode_(std::int32_t node)
+{
+    nodes_[node].parent = freeList_;
+    nodes_[node].height = -1;
+    freeList_ = node;
+}
+
+void SpatialIndex::clear()
+{
+    nodes_.clear();
+    root_ = kNull;
+    freeList_ = kNull;
+    leafCount_ = 0;
+}
+
+// 胖盒：各向放大最大边长的 10%，退化（点、轴向线段）时至少放大一个很小的量
+Aabb SpatialIndex::fatten_(const Aabb &box)
+{
+    glm::vec3 e = box.extent();
+    float margin = std::max(std::max(e.x, e.y), e.z) * 0.1f;
+    margin = std::max(margin, 1e-4f);
+    return Aabb(box.min - glm::vec3(margin), box.max + glm::vec3(margin));
+}
+
+// ============================================
+// 代理（叶子）增删改
+// ============================================
+
+std::int32_t SpatialIndex::insert(std::uint64_t id, const Aabb &box)
+{
+    std::int32_t leaf = allocNode_();
+    Node &n = nodes_[leaf];
+    n.id = id;
+    n.tight = box;
+    n.fat = fatten_(box);
+    n.height = 0;
+    insertLeaf_(leaf);
+    ++leafCount_;
+    return leaf;
+}
+
+void SpatialIndex::remove(std::int32_t proxy)
+{
+    removeLeaf_(proxy);
+    freeNode_(proxy);
+    --leafCount_;
+}
+
+bool SpatialIndex::move(std::int32_t proxy, const Aabb &box)
+{
+    Node &n = nodes_[proxy];
+    n.tight = box;
+    if (n.fat.contains(box))
+        return false;  // 仍在胖盒内：树结构不变
+
+    removeLeaf_(proxy);
+    nodes_[proxy].fat = fatten_(box);
+    insertLeaf_(proxy);
+    return true;
+}
+
+// ============================================
+// 树结构维护
+// ============================================
+
+void SpatialIndex::insertLeaf_(std::int32_t leaf)
+{
+    if (root_ == kNull)
+    {
+        root_ = leaf;
+        nodes_[root_].parent = kNull;
+        return;
+    }
+
+    // 自顶向下选兄弟节点：比较"在此处成为兄弟"与"继续下探"的代价
+    Aabb leafBox = nodes_[leaf].fat;
+    std::int32_t index = root_;
+    while (!nodes_[index].isLeaf())
+    {
+        const Node &node = nodes_[index];
+        float cost = node.fat.cost();
+        float combined = Aabb::merge(node.fat, leafBox).cost();
+
+        // 在此处新建父节点的代价，以及下探时祖先增大带来的继承代价
+        float here = 2.0f * combined;
+        float inheritance = 2.0f * (combined - cost);
+
+        auto descendCost = [&](std::int32_t child) {
+            const Aabb &b = nodes_[child].fat;
+            float merged = Aabb::merge(b, leafBox).cost();
+            return (nodes_[child].isLeaf() ? merged : merged - b.cost()) + inheritance;
+        };
+        float cost1 = descendCost(node.child1);
+        float cost2 = descendCost(node.child2);
+
+        if (here < cost1 && here < cost2)
+            break;
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+    std::int32_t sibling = index;
+
+    // 新建父节点替换兄弟的位置
+    std::int32_t oldParent = nodes_[sibling].parent;
+    std::int32_t newParent = allocNode_();
+    nodes_[newParent].parent = oldParent;
+    nodes_[newParent].fat = Aabb::merge(leafBox, nodes_[sibling].fat);
+    nodes_[newParent].height = nodes_[sibling].height + 1;
+    nodes_[newParent].child1 = sibling;
+    nodes_[newParent].child2 = leaf;
+    nodes_[sibling].parent = newParent;
+    nodes_[leaf].parent = newParent;
+
+    if (oldParent == kNull)
+    {
+        root_ = newParent;
+    }
+    else if (nodes_[oldParent].child1 == sibling)
+    {
+        nodes_[oldParent].child1 = newParent;
+    }
+    else
+    {
+        nodes_[oldParent].child2 = newParent;
+    }
+
+    refit_(nodes_[leaf].parent);
+}
+
+void SpatialIndex::removeLeaf_(std::int32_t leaf)
+{
+    if (leaf == root_)
+    {
+        root_ = kNull;
+        return;
+    }
+
+    // 父节点被兄弟取代
+    std::int32_t parent = nodes_[leaf].parent;
+    std::int32_t grandParent = nodes_[parent].parent;
+    std::int32_t sibling = nodes_[parent].child1 == leaf ? nodes_[parent].child2 : nodes_[parent].child1;
+
+    if (grandParent == kNull)
+    {
+        root_ = sibling;
+        nodes_[sibling].parent = kNull;
+        freeNode_(parent);
+        return;
+    }
+
+    if (nodes_[grandParent].child1 == parent)
+        nodes_[grandParent].child1 = sibling;
+    else
+        nodes_[grandParent].child2 = sibling;
+    nodes_[sibling].parent = grandParent;
+    freeNode_(parent);
+
+    refit_(grandParent);
+}
+
+void SpatialIndex::refit_(std::int32_t index)
+{
+    while (index != kNull)
+    {
+        index = balance_(index);
+
+        Node &n = nodes_[index];
+        const Node &c1 = nodes_[n.child1];
+        const Node &c2 = nodes_[n.child2];
+        n.height = 1 + std::max(c1.height, c2.height);
+        n.fat = Aabb::merge(c1.fat, c2.fat);
+
+        index = n.parent;
+    }
+}
+
+// 若 a 的左右子树高度差超过 1，把较高的子节点旋转上来；返回该位置的新子树根
+std::int32_t SpatialIndex::balance_(std::int32_t iA)
+{
+    Node &A = nodes_[iA];
+    if (A.isLeaf() || A.height < 2)
+        return iA;
+
+    std::int32_t iB = A.child1;
+    std::int32_t iC = A.child2;
+    std::int32_t diff = nodes_[iC].height - nodes_[iB].height;
+    if (diff >= -1 && diff <= 1)
+        return iA;
+
+    // 统一成"把 iUp 提升到 A 的位置，A 保留 iStay"的形式
+    bool rotateC = diff > 1;
+    std::int32_t iUp = rotateC ? iC : iB;
+    std::int32_t iStay = rotateC ? iB : iC;
+    Node &Up = nodes_[iUp];
+    std::int32_t iF = Up.child1;
+    std::int32_t iG = Up.child2;
+
+    // Up 顶替 A
+    Up.child1 = iA;
+    Up.parent = A.parent;
+    A.parent = iUp;
+    if (Up.parent != kNull)
+    {
+        Node &P = nodes_[Up.parent];
+        if (P.child1 == iA)
+            P.child1 = iUp;
+        else
+            P.child2 = iUp;
+    }
+    else
+    {
+        root_ = iUp;
+    }
+
+    // Up 的较高子节点留在 Up 下，较矮的交给 A
+    std::int32_t iKeep = iF, iGive = iG;
+    if (nodes_[iF].height < nodes_[iG].height)
+        std::swap(iKeep, iGive);
+
+    Up.child2 = iKeep;
+    if (rotateC)
+        A.child2 = iGive;
+    else
+        A.child1 = iGive;
+    nodes_[iGive].parent = iA;
+
+    A.fat = Aabb::merge(nodes_[iStay].fat, nodes_[iGive].fat);
+    A.height = 1 + std::max(nodes_[iStay].height, nodes_[iGive].height);
+    Up.fat = Aabb::merge(A.fat, nodes_[iKeep].fat);
+    Up.height = 1 + std::max(A.height, nodes_[iKeep].height);
+    return iUp;
+}
@@ -0,0 +1,239 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+// ============================================
+// Aabb - 轴对齐包围盒
+// 默认构造为空盒（min > max），expand 后才有效
+// ============================================
+struct Aabb {
+    glm::vec3 min{ std::numeric_limits<float>::max()};
+    glm::vec3 max{-std::numeric_limits<float>::max()};
+
+    Aabb() = default;
+    Aabb(const glm::vec3& lo, const glm::vec3& hi) : min(lo), max(hi) {}
+
+    bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return max - min; }
+
+    void expand(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+    void expand(const Aabb& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+
+    bool contains(const Aabb& b) const {
+        return min.x <= b.min.x && min.y <= b.min.y && min.z <= b.min.z &&
+               max.x >= b.max.x && max.y >= b.max.y && max.z >= b.max.z;
+    }
+    bool overlaps(const Aabb& b) const {
+        return min.x <= b.max.x && max.x >= b.min.x &&
+               min.y <= b.max.y && max.y >= b.min.y &&
+               min.z <= b.max.z && max.z >= b.min.z;
+    }
+
+    // 点到盒的距离（盒内为 0）
+    float distanceTo(const glm::vec3& p) const {
+        glm::vec3 d = glm::max(glm::max(min - p, p - max), glm::vec3(0.0f));
+        return glm::length(d);
+    }
+
+    // 射线与盒求交（slab 法）：invDir = 1 / dir；命中时 tEnter 为进入参数（起点在盒内为 0）
+    bool intersectRay(const glm::vec3& origin, const glm::vec3& invDir, float maxT, float& tEnter) const {
+        glm::vec3 t0 = (min - origin) * invDir;
+        glm::vec3 t1 = (max - origin) * invDir;
+        glm::vec3 tMin = glm::min(t0, t1), tMax = glm::max(t0, t1);
+        float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+        float exit  = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxT));
+        if (enter > exit) return false;
+        tEnter = enter;
+        return true;
+    }
+
+    // 树的插入代价度量：三个边长之和。
+    // CAD 图元多为平面甚至与轴平行的线段，表面积会退化为 0，边长和仍能区分大小
+    float cost() const { glm::vec3 e = extent(); return e.x + e.y + e.z; }
+
+    static Aabb merge(const Aabb& a, const Aabb& b) {
+        return Aabb(glm::min(a.min, b.min), glm::max(a.max, b.max));
+    }
+};
+
+// ============================================
+// SpatialIndex - 动态包围盒树（BVH）
+// 每个实体一个叶子（proxy），叶子保存紧包围盒与放大的"胖"包围盒；
+// 小幅移动只要仍在胖盒内就不改动树结构，否则删除后重新插入，
+// 插入时按代价选兄弟节点并做 AVL 式旋转保持平衡
+// ============================================
+class SpatialIndex {
+public:
+    static constexpr std::int32_t kNull = -1;
+
+    std::int32_t insert(std::uint64_t id, const Aabb& box);
+    void remove(std::int32_t proxy);
+    // 更新包围盒；返回 true 表示叶子被重新插入
+    bool move(std::int32_t proxy, const Aabb& box);
+    void clear();
+
+    std::uint64_t entity(std::int32_t proxy) const { return nodes_[proxy].id; }
+    const Aabb&   bounds(std::int32_t proxy) const { return nodes_[proxy].tight; }
+
+    std::size_t size() const { return leafCount_; }
+    int height() const { return root_ == kNull ? 0 : nodes_[root_].height; }
+    // 整个场景的包围盒（胖盒，略大于真实范围）
+    Aabb rootBounds() const { return root_ == kNull ? Aabb() : nodes_[root_].fat; }
+
+    // ============================================
+    // 查询（回调返回 bool 时 false 表示提前结束，也可以返回 void）
+    // ============================================
+
+    // 包围盒与 box 相交的实体：f(std::uint64_t id, const Aabb& bounds)
+    template <class F>
+    void query(const Aabb& box, F&& f) const
+    {
+        traverse_([&](const Aabb& b) { return b.overlaps(box); },
+                  [&](const Node& n) { return visit_(f, n.id, n.tight); });
+    }
+
+    // 通用遍历：accept(const Aabb&) 决定是否进入子树（同时用于叶子的紧包围盒），
+    // 供视锥等其它形状复用：f(std::uint64_t id, const Aabb& bounds)
+    template <class Accept, class F>
+    void queryIf(Accept&& accept, F&& f) const
+    {
+        traverse_(accept, [&](const Node& n) { return visit_(f, n.id, n.tight); });
+    }
+
+    // 分层遍历：classify(const Aabb&) 返回 0 = 外部，1 = 相交，2 = 完全包含；
+    // 完全包含的子树不再做任何测试，直接枚举其中的叶子：f(std::uint64_t id, const Aabb& bounds)
+    template <class Classify, class F>
+    void queryClassified(Classify&& classify, F&& f) const
+    {
+        if (root_ == kNull) return;
+        std::vector<std::pair<std::int32_t, bool>> stack;  // (节点, 是否已知完全包含)
+        stack.reserve(64);
+        stack.emplace_back(root_, false);
+        while (!stack.empty()) {
+            auto [index, inside] = stack.back();
+            stack.pop_back();
+            const Node& n = nodes_[index];
+            if (!inside) {
+                int c = classify(n.fat);
+                if (c == 0) continue;
+                inside = (c == 2);
+            }
+            if (n.isLeaf()) {
+                if ((inside || classify(n.tight) != 0) && !visit_(f, n.id, n.tight)) return;
+            } else {
+                stack.emplace_back(n.child1, inside);
+                stack.emplace_back(n.child2, inside);
+            }
+        }
+    }
+
+    // 射线 origin + t * dir（t ∈ [0, maxT]）穿过包围盒的实体：f(std::uint64_t id, float tEnter)
+    // 回调顺序不保证按 t 排序
+    template <class F>
+    void raycast(const glm::vec3& origin, const glm::vec3& dir, float maxT, F&& f) const
+    {
+        glm::vec3 invDir = 1.0f / dir;  // 分量为 0 时得到 ±inf，slab 法仍然成立
+        float t = 0.0f;
+        traverse_([&](const Aabb& b) { return b.intersectRay(origin, invDir, maxT, t); },
+                  [&](const Node& n) { return visit_(f, n.id, t); });
+    }
+
+    // 距 p 最近的 k 个实体（按距离升序写入 out）
+    // dist(id) 返回精确距离，必须不小于到其包围盒的距离；超过 maxDist 的不返回
+    template <class DistFn>
+    void nearest(const glm::vec3& p, std::size_t k, float maxDist, DistFn&& dist,
+                 std::vector<std::pair<std::uint64_t, float>>& out) const
+    {
+        out.clear();
+        if (root_ == kNull || k == 0) return;
+
+        // 最佳优先：节点按包围盒距离入队，叶子算出精确距离后再次入队，
+        // 精确结果出队时一定不比队中其它候选更远
+        struct Entry { float d; std::int32_t node; bool exact; };
+        auto greater = [](const Entry& a, const Entry& b) { return a.d > b.d; };
+        std::priority_queue<Entry, std::vector<Entry>, decltype(greater)> open(greater);
+
+        open.push({nodes_[root_].fat.distanceTo(p), root_, false});
+        while (!open.empty() && out.size() < k) {
+            Entry e = open.top();
+            open.pop();
+            if (e.d > maxDist) break;
+
+            const Node& n = nodes_[e.node];
+            if (e.exact) {
+                out.emplace_back(n.id, e.d);
+            } else if (n.isLeaf()) {
+                float d = float(dist(n.id));
+                if (d <= maxDist) open.push({d, e.node, true});
+            } else {
+                open.push({nodes_[n.child1].fat.distanceTo(p), n.child1, false});
+                open.push({nodes_[n.child2].fat.distanceTo(p), n.child2, false});
+            }
+        }
+    }
+
+private:
+    struct Node {
+        Aabb fat;     // 内部节点：子树并集；叶子：放大后的包围盒
+        Aabb tight;   // 仅叶子：实体的真实包围盒
+        std::int32_t parent = kNull;  // 空闲节点复用为 free-list 指针
+        std::int32_t child1 = kNull;
+        std::int32_t child2 = kNull;
+        std::int32_t height = 0;      // 叶子为 0，空闲节点为 -1
+        std::uint64_t id = 0;
+
+        bool isLeaf() const { return child1 == kNull; }
+    };
+
+    std::int32_t allocNode_();
+    void freeNode_(std::int32_t node);
+    void insertLeaf_(std::int32_t leaf);
+    void removeLeaf_(std::int32_t leaf);
+    std::int32_t balance_(std::int32_t a);
+    void refit_(std::int32_t node);  // 从 node 向上修正高度与包围盒
+    static Aabb fatten_(const Aabb& box);
+
+    template <class F, class... A>
+    static bool visit_(F& f, A&&... args)
+    {
+        if constexpr (std::is_same_v<std::invoke_result_t<F&, A...>, bool>)
+            return f(std::forward<A>(args)...);
+        else {
+            f(std::forward<A>(args)...);
+            return true;
+        }
+    }
+
+    // 非递归遍历：accept 先判内部节点的胖盒，叶子再判紧盒；leaf 返回 false 时中止
+    template <class Accept, class Leaf>
+    void traverse_(Accept&& accept, Leaf&& leaf) const
+    {
+        if (root_ == kNull) return;
+        std::vector<std::int32_t> stack;
+        stack.reserve(64);
+        stack.push_back(root_);
+        while (!stack.empty()) {
+            const Node& n = nodes_[stack.back()];
+            stack.pop_back();
+            if (!accept(n.fat)) continue;
+            if (n.isLeaf()) {
+                if (accept(n.tight) && !leaf(n)) return;
+            } else {
+                stack.push_back(n.child1);
+                stack.push_back(n.child2);
+            }
+        }
+    }
+
+    std::vector<Node> nodes_;
+    std::int32_t root_ = kNull;
+    std::int32_t freeList_ = kNull;
+    std::size_t leafCount_ = 0;
+};
@@ -0,0 +1,156 @@
+#include "uploadworker.h"
+#include <algorithm>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QThread>
+#include <QDebug>
+
+// 单次 glBufferSubData 的上限：分块提交，驱动可以边拷边传，不会一次锁住一大块内存
+static constexpr GLsizeiptr kUploadChunkBytes = 4 << 20;
+
+UploadWorker::UploadWorker() = default;
+
+UploadWorker::~UploadWorker()
+{
+    stop();
+}
+
+bool UploadWorker::start(QOpenGLContext *share)
+{
+    stop();
+    if (!share)
+        return false;
+
+    // 上下文与离屏表面都要在渲染（GUI）线程创建，上下文再移交给上传线程
+    context_ = std::make_unique<QOpenGLContext>();
+    context_->setFormat(share->format());
+    context_->setShareContext(share);
+    if (!context_->create() || !context_->shareContext())
+    {
+        qWarning() << "UploadWorker: failed to create a shared OpenGL context";
+        context_.reset();
+        return false;
+    }
+    surface_ = std::make_unique<QOffscreenSurface>();
+    surface_->setFormat(context_->format());
+    surface_->create();
+    if (!surface_->isValid())
+    {
+        qWarning() << "UploadWorker: failed to create offscreen surface";
+        surface_.reset();
+        context_.reset();
+        return false;
+    }
+
+    stop_ = false;
+    startState_ = 0;
+    ownerThread_ = QThread::currentThread();
+    thread_ = QThread::create([this] { run_(); });
+    context_->moveToThread(thread_);
+    thread_->start();
+
+    // 等上传线程确认上下文可用
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait(lock, [this] { return startState_ != 0; });
+    bool ok = startState_ > 0;
+    lock.unlock();
+    if (!ok)
+        stop();
+    return ok;
+}
+
+void UploadWorker::stop()
+{
+    if (!thread_)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        jobs_.clear();
+    }
+    wake_.notify_all();
+    thread_->wait();
+    delete thread_;
+    thread_ = nullptr;
+    context_.reset();
+    surface_.reset();
+}
+
+void UploadWorker::submit(Job &&job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+}
+
+void UploadWorker::takeResults(std::vector<Result> &out)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.insert(out.end(), results_.begin(), results_.end());
+    results_.clear();
+}
+
+void UploadWorker::upload_(GLuint buffer, const void *data, GLsizeiptr bytes)
+{
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_DYNAMIC_DRAW);
+    const char *src = static_cast<const char *>(data);
+    for (GLsizeiptr offset = 0; offset < bytes; offset += kUploadChunkBytes)
+    {
+        GLsizeiptr n = std::min(kUploadChunkBytes, bytes - offset);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, n, src + offset);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void UploadWorker::run_()
+{
+    bool ok = context_->makeCurrent(surface_.get());
+    if (ok)
+        initializeOpenGLFunctions();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        startState_ = ok ? 1 : -1;
+    }
+    ready_.notify_all();
+
+    while (ok)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+            if (stop_)
+                break;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        // 已被更新的重建取代
+        if (job.ticket < cancelBefore_.load(std::memory_order_relaxed))
+            continue;
+
+        Result r;
+        r.ticket = job.ticket;
+        r.heap = job.heap;
+        r.arena = job.data.arena;
+        glGenBuffers(1, &r.vbo);
+        glGenBuffers(1, &r.idVbo);
+        upload_(r.vbo, job.data.vertices.data(),
+                GLsizeiptr(job.data.vertices.size() * sizeof(BatchVertex)));
+        upload_(r.idVbo, job.data.keys.data(),
+                GLsizeiptr(job.data.keys.size() * sizeof(std::uint32_t)));
+        // fence 之后必须 flush，其它上下文才能等到它
+        r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        results_.push_back(r);
+    }
+
+    if (ok)
+        context_->doneCurrent();
+    // 上下文属于本线程，移回创建它的线程后才能在那里销毁
+    context_->moveToThread(ownerThread_);
+}
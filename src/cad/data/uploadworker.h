@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <QOpenGLFunctions_3_3_Core>
+#include "gpuheap.h"
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QThread;
+
+// ============================================
+// UploadWorker - 后台 GL 上传线程
+// 自己持有一个与渲染上下文共享资源的 QOpenGLContext（离屏表面），把延迟上传的 arena
+// 建成缓冲对象并写入，插入 glFenceSync 后交回。缓冲与 fence 在共享组内可见，
+// 渲染线程在 fence 触发后才使用这些缓冲（VAO 不共享，由渲染线程接回时创建）。
+// 任务带批次号：cancelBefore 之后，旧批次中还没开始的任务直接跳过
+// ============================================
+class UploadWorker : protected QOpenGLFunctions_3_3_Core {
+public:
+    struct Job {
+        std::uint64_t ticket = 0;
+        std::uint8_t heap = 0;
+        StagedArena data;
+    };
+
+    struct Result {
+        std::uint64_t ticket = 0;
+        std::uint8_t heap = 0;
+        std::uint32_t arena = 0;
+        GLuint vbo = 0, idVbo = 0;
+        GLsync fence = nullptr;
+    };
+
+    UploadWorker();
+    ~UploadWorker();
+
+    // 在渲染线程上调用，share 须为当前上下文；共享上下文或线程创建失败时返回 false
+    bool start(QOpenGLContext* share);
+    // 等待线程退出；未取走的结果留给调用方释放
+    void stop();
+    bool running() const { return thread_ != nullptr; }
+
+    void submit(Job&& job);
+    void cancelBefore(std::uint64_t ticket) { cancelBefore_.store(ticket, std::memory_order_relaxed); }
+    // 取出已完成的结果（追加到 out）
+    void takeResults(std::vector<Result>& out);
+
+private:
+    void run_();
+    void upload_(GLuint buffer, const void* data, GLsizeiptr bytes);
+
+    std::unique_ptr<QOpenGLContext> context_;
+    std::unique_ptr<QOffscreenSurface> surface_;
+    QThread* thread_ = nullptr;
+    QThread* ownerThread_ = nullptr;  // 退出时把上下文移回这里再销毁
+
+    std::mutex mutex_;
+    std::condition_variable wake_, ready_;
+    std::deque<Job> jobs_;
+    std::vector<Result> results_;
+    bool stop_ = false;
+    int startState_ = 0;  // 0 = 启动中, 1 = 上下文就绪, -1 = 失败
+    std::atomic<std::uint64_t> cancelBefore_{0};
+};
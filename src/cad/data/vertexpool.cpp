@@ -0,0 +1,62 @@
+#include "vertexpool.h"
+#include <algorithm>
+
+VertexPool::Span VertexPool::allocate(std::uint32_t count)
+{
+    if (count == 0)
+        return Span{};
+
+    auto it = free_.find(count);
+    if (it != free_.end() && !it->second.empty())
+    {
+        Span s{it->second.back(), count};
+        it->second.pop_back();
+        freeCount_ -= count;
+        return s;
+    }
+
+    Span s{std::uint32_t(data_.size()), count};
+    data_.resize(data_.size() + count);
+    return s;
+}
+
+void VertexPool::release(Span s)
+{
+    if (s.count == 0)
+        return;
+    // 末尾的区间直接截短，不进空闲表
+    if (std::size_t(s.offset) + s.count == data_.size())
+    {
+        data_.resize(s.offset);
+        return;
+    }
+    free_[s.count].push_back(s.offset);
+    freeCount_ += s.count;
+}
+
+void VertexPool::clear()
+{
+    data_.clear();
+    free_.clear();
+    freeCount_ = 0;
+}
+
+void VertexPool::compact(std::vector<Span*>& live)
+{
+    std::sort(live.begin(), live.end(), [](const Span* a, const Span* b) { return a->offset < b->offset; });
+
+    // 按偏移升序前移：目标总在源之前，顺序拷贝不会覆盖未搬的数据
+    std::uint32_t dst = 0;
+    for (Span* s : live)
+    {
+        if (s->offset != dst)
+            std::copy(data_.begin() + s->offset, data_.begin() + (s->offset + s->count), data_.begin() + dst);
+        s->offset = dst;
+        dst += s->count;
+    }
+    data_.resize(dst);
+    if (data_.capacity() > 2 * data_.size())
+        data_.shrink_to_fit();
+    free_.clear();
+    freeCount_ = 0;
+}
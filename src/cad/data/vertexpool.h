@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+// ============================================
+// VertexPool - Document 持有的折线顶点池
+// 所有短折线的点连续存放在一块数组里，实体只记录 (offset, count)：
+// 百万条短折线不再是百万次 malloc / free，清空是一次 clear，拷贝文档是一次整块拷贝。
+// 释放的区间按长度放进空闲表，同长度的分配直接复用；末尾的区间释放时直接截短。
+// 空闲区间不会自动合并，由 compact 按需整理（调用方提供全部存活区间，偏移被原地改写）。
+// 数组增长时地址会变，外部只能保存偏移，不能保存指针
+// ============================================
+class VertexPool {
+public:
+    struct Span {
+        std::uint32_t offset = 0;
+        std::uint32_t count = 0;
+    };
+
+    Span allocate(std::uint32_t count);
+    void release(Span s);
+    void clear();
+    void reserve(std::size_t vertices) { data_.reserve(vertices); }
+
+    glm::vec3* data() { return data_.data(); }
+    const glm::vec3* data() const { return data_.data(); }
+
+    // 已用的数组长度 / 其中空闲（已释放未复用）的顶点数
+    std::size_t usedVertices() const { return data_.size(); }
+    std::size_t freeVertices() const { return freeCount_; }
+
+    // 整理：live 中的区间按偏移顺序前移到数组开头并改写 offset，之后没有空闲区间。
+    // live 必须包含所有存活区间，不在其中的区间视为已释放
+    void compact(std::vector<Span*>& live);
+
+private:
+    std::vector<glm::vec3> data_;
+    std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> free_;  // 长度 → 空闲区间偏移
+    std::size_t freeCount_ = 0;
+};
@@ -0,0 +1,104 @@
+#include "workerpool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned threads)
+{
+    if (threads == 0)
+    {
+        unsigned hw = std::thread::hardware_concurrency();
+        threads = hw > 1 ? hw - 1 : 0;
+    }
+    workers_.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i)
+        workers_.emplace_back([this] { workerLoop_(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &t : workers_)
+        t.join();
+}
+
+void WorkerPool::parallelFor(std::size_t shards, const std::function<void(std::size_t)> &f)
+{
+    if (shards == 0)
+        return;
+    // 只有一片或没有工作线程时直接在调用线程执行
+    if (shards == 1 || workers_.empty())
+    {
+        for (std::size_t s = 0; s < shards; ++s)
+            f(s);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &f;
+        shards_ = shards;
+        remaining_ = shards;
+        next_.store(0, std::memory_order_relaxed);
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    runShards_(f, shards);
+
+    // 还要等已加入的工作线程退出本次任务，它们不会再领取下一次任务的分片
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return remaining_ == 0 && active_ == 0; });
+    job_ = nullptr;
+}
+
+void WorkerPool::runShards_(const std::function<void(std::size_t)> &f, std::size_t shards)
+{
+    // 领取分片直到取完；完成数在锁内累计
+    std::size_t finished = 0;
+    for (;;)
+    {
+        std::size_t s = next_.fetch_add(1, std::memory_order_relaxed);
+        if (s >= shards)
+            break;
+        f(s);
+        ++finished;
+    }
+    if (finished == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    remaining_ -= finished;
+    if (remaining_ == 0)
+        done_.notify_all();
+}
+
+void WorkerPool::workerLoop_()
+{
+    std::uint64_t seen = 0;
+    for (;;)
+    {
+        const std::function<void(std::size_t)> *job;
+        std::size_t shards;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_)
+                return;
+            seen = generation_;
+            // 醒得太晚，任务已经结束
+            if (!job_)
+                continue;
+            job = job_;
+            shards = shards_;
+            ++active_;
+        }
+        runShards_(*job, shards);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0)
+            done_.notify_all();
+    }
+}
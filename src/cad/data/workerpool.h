@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ============================================
+// WorkerPool - 常驻工作线程池，供渲染器的 CPU 阶段（细分、顶点打包）并行使用
+// 一次只执行一个 parallelFor：任务切成若干分片，工作线程与调用线程一起按原子计数领取，
+// 全部完成后 parallelFor 才返回。分片回调里不能调用 GL，也不能修改共享状态
+// ============================================
+class WorkerPool {
+public:
+    // threads 为额外的工作线程数；0 = 硬件线程数 - 1（调用线程本身也参与）
+    explicit WorkerPool(unsigned threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // 参与执行的线程总数（工作线程 + 调用线程）
+    unsigned concurrency() const { return unsigned(workers_.size()) + 1; }
+
+    // 执行 f(shard) for shard in [0, shards)，阻塞到全部完成
+    void parallelFor(std::size_t shards, const std::function<void(std::size_t)>& f);
+
+private:
+    void workerLoop_();
+    void runShards_(const std::function<void(std::size_t)>& f, std::size_t shards);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_, done_;
+    bool stop_ = false;
+
+    // 当前任务：generation_ 每次 parallelFor 递增，工作线程据此发现新任务
+    std::uint64_t generation_ = 0;
+    const std::function<void(std::size_t)>* job_ = nullptr;
+    std::size_t shards_ = 0;
+    std::atomic<std::size_t> next_{0};
+    std::size_t remaining_ = 0;  // 尚未完成的分片数（受 mutex_ 保护）
+    unsigned active_ = 0;        // 正在执行本次任务的工作线程数（受 mutex_ 保护）
+};
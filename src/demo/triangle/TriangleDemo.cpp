@@ -299,6 +299,7 @@ void TriangleDemo::onAutoRotateChanged(bool enabled)
 {
     autoRotate = enabled;
     emit statusMessage(enabled ? "Auto rotation enabled" : "Auto rotation disabled");
+    emit frameRequested();
 }
 
 void TriangleDemo::onResetRotation()
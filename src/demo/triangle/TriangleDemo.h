@@ -58,6 +58,8 @@ public:
     
     QWidget* createControlPanel(QWidget *parent = nullptr) override;
 
+    bool isAnimating() const override { return autoRotate; }
+
 private slots:
     void onRotationSpeedChanged(double value);
     void onAutoRotateChanged(bool enabled);
@@ -2,6 +2,18 @@
 #include <QApplication>
 #include <QSurfaceFormat>
 #include <QDebug>
+#include <QStringList>
+
+// 线条在着色器中解析抗锯齿（Renderer::setWideLines），默认不再请求多重采样，
+// 省掉 4 倍的填充与 resolve；实体面较多的场景可用 --msaa <n> 重新开启
+static int msaaSamples(const QApplication &app)
+{
+    const QStringList args = app.arguments();
+    int i = args.indexOf("--msaa");
+    if (i >= 0 && i + 1 < args.size())
+        return qMax(args[i + 1].toInt(), 0);
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
@@ -16,7 +28,7 @@ int main(int argc, char *argv[])
     QSurfaceFormat format;
     format.setVersion(3, 3);                    // OpenGL 3.3
     format.setProfile(QSurfaceFormat::CoreProfile);
-    format.setSamples(4);                       // 4x MSAA 抗锯齿
+    format.setSamples(msaaSamples(app));        // 默认不开 MSAA：线条由着色器抗锯齿
     format.setDepthBufferSize(24);              // 24 位深度缓冲
     format.setStencilBufferSize(8);             // 8 位模板缓冲
     format.setSwapBehavior(QSurfaceFormat::DoubleBuffer);
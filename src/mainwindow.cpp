@@ -101,6 +101,15 @@ void MainWindow::createMenus()
     });
     renderMenu->addAction(pauseAction);
     
+    QAction *onDemandAction = new QAction("Render On &Demand", this);
+    onDemandAction->setCheckable(true);
+    onDemandAction->setChecked(glWidget->isRenderOnDemand());
+    connect(onDemandAction, &QAction::toggled, [this](bool checked) {
+        glWidget->setRenderOnDemand(checked);
+        statusBar()->showMessage(checked ? "Render on demand enabled" : "Continuous rendering enabled", 2000);
+    });
+    renderMenu->addAction(onDemandAction);
+    
     // 帮助菜单
     QMenu *helpMenu = menuBar()->addMenu("&Help");
     
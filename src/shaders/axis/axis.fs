@@ -1,9 +0,0 @@
-#version 330 core
-
-in vec4 vertexColor;
-out vec4 FragColor;
-
-void main()
-{
-    FragColor = vertexColor;
-}
\ No newline at end of file
@@ -0,0 +1,31 @@
+// 实体属性表的公共部分：各 cadshaders 顶点着色器在 #version 之后 #include 本文件，
+// 由 Shader 按文件加载时展开（GLSL 本身没有 #include）
+uniform usamplerBuffer entityAttr;  // 实体属性表：x = 0xRRGGBBAA，y = 低 16 位标志（1 可见 / 2 选中 / 4 高亮），高 16 位线宽
+uniform bool baseLayer;             // 缓存的文档层：忽略选中 / 高亮（它们在叠加层中重画）
+
+vec4 unpackRGBA(uint c) {
+    return vec4(float(c >> 24), float((c >> 16) & 0xFFu), float((c >> 8) & 0xFFu), float(c & 0xFFu)) / 255.0;
+}
+
+// 按实体键从属性表取颜色与标志；键 0 为非实体几何（预览层等），保留顶点颜色。返回 false 表示隐藏
+bool applyEntityAttr(uint key, inout vec4 color) {
+    if (key == 0u)
+        return true;
+    uvec2 attr = texelFetch(entityAttr, int(key)).xy;
+    if ((attr.y & 1u) == 0u)
+        return false;
+    color = unpackRGBA(attr.x);
+    if (baseLayer)
+        return true;
+    if ((attr.y & 2u) != 0u)
+        color = vec4(1.0, 0.6, 0.0, 1.0);
+    else if ((attr.y & 4u) != 0u)
+        color.rgb = mix(color.rgb, vec3(1.0), 0.5);
+    return true;
+}
+
+// 线宽（像素）：属性表 y 的高 16 位为 12.4 定点，0 按 1 像素
+float entityWidth(uint key) {
+    float w = float(texelFetch(entityAttr, int(key)).y >> 16) / 16.0;
+    return w > 0.0 ? w : 1.0;
+}
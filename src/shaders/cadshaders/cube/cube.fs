@@ -1,32 +1,22 @@
 #version 330 core
+// 立方体面：随相机的头灯（光源方向固定在视图空间），环境光 + 漫反射
+in vec3 vNormal;
+in vec4 vColor;
 
-in vec3 FragPos;
-in vec3 Normal;
-
-uniform vec4 color;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+layout (std140) uniform Camera {   // 每帧上传一次，见 Renderer::setCamera
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec2 viewport;         // 像素尺寸
+    float worldPerPixel;
+};
 
 out vec4 FragColor;
 
 void main() {
-    // 环境光
-    float ambientStrength = 0.3;
-    vec3 ambient = ambientStrength * color.rgb;
-    
-    // 漫反射
-    vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(lightPos - FragPos);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * color.rgb;
-    
-    // 镜面反射
-    float specularStrength = 0.5;
-    vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * vec3(1.0);
-    
-    vec3 result = ambient + diffuse + specular;
-    FragColor = vec4(result, color.a);
-}
\ No newline at end of file
+    // 视图矩阵是刚体变换，转置即为逆：把视图空间的光源方向转到世界空间
+    vec3 lightDir = normalize(transpose(mat3(view)) * vec3(0.3, 0.5, 1.0));
+    vec3 n = normalize(vNormal);
+    float shade = 0.3 + 0.7 * max(dot(n, lightDir), 0.0);
+    FragColor = vec4(vColor.rgb * shade, vColor.a);
+}
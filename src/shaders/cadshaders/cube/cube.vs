@@ -1,19 +1,44 @@
 #version 330 core
+#include "../common/entityattr.glsl"
+// 立方体实例：所有实例共用一个单位立方体（每面 4 个顶点带面法线），变换按实例展开
+layout (location = 0) in vec3 aPos;           // 单位立方体顶点，[-0.5, 0.5]³
+layout (location = 1) in vec3 aNormal;        // 面法线
+layout (location = 2) in vec4 aCenterSize;    // xyz = 中心, w = 边长
+layout (location = 3) in vec3 aRotation;      // 欧拉角（弧度），R = Rx * Ry * Rz
+layout (location = 4) in vec4 aColor;         // 0xRRGGBBAA 按字节（小端）读入为 (A, B, G, R)
+layout (location = 5) in uint aPickId;        // 实体键：属性表下标，拾取 pass 输出
 
-layout (location = 0) in vec3 aPos;
+layout (std140) uniform Camera {   // 每帧上传一次，见 Renderer::setCamera
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec2 viewport;         // 像素尺寸
+    float worldPerPixel;
+};
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+out vec3 vNormal;          // 世界空间面法线
+out vec4 vColor;
+flat out uint vPickId;
 
-out vec3 FragPos;
-out vec3 Normal;
+// 与 glm::eulerAngleXYZ 相同的旋转（列主序）
+mat3 eulerXYZ(vec3 a) {
+    vec3 c = cos(a);
+    vec3 s = sin(a);
+    mat3 rx = mat3(1.0, 0.0, 0.0,  0.0, c.x, s.x,  0.0, -s.x, c.x);
+    mat3 ry = mat3(c.y, 0.0, -s.y,  0.0, 1.0, 0.0,  s.y, 0.0, c.y);
+    mat3 rz = mat3(c.z, s.z, 0.0,  -s.z, c.z, 0.0,  0.0, 0.0, 1.0);
+    return rx * ry * rz;
+}
 
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    
-    // 简单计算法向量（假设立方体轴对齐）
-    Normal = normalize(aPos - vec3(0.5));
-    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    // 等比缩放 + 旋转：法线只需旋转，不需要逆转置
+    mat3 R = eulerXYZ(aRotation);
+    vec3 p = aCenterSize.xyz + R * (aPos * aCenterSize.w);
+
+    vNormal = R * aNormal;
+    vColor = aColor.wzyx;
+    vPickId = aPickId;
+    gl_Position = viewProj * vec4(p, 1.0);
+    if (!applyEntityAttr(aPickId, vColor))
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+#include "../common/entityattr.glsl"
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;  // 0xRRGGBBAA 按字节（小端）读入为 (A, B, G, R)
+layout (location = 2) in uint aPickId; // 实体键（实体下标 + 1）：属性表下标，拾取 pass 输出
+layout (std140) uniform Camera {   // 每帧上传一次，见 Renderer::setCamera
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec2 viewport;         // 像素尺寸
+    float worldPerPixel;
+};
+out vec4 vColor;
+flat out uint vPickId;
+
+void main() {
+    vColor = aColor.wzyx;
+    vPickId = aPickId;
+    gl_Position = viewProj * vec4(aPos, 1.0);
+    // 隐藏的实体：所有顶点移到远平面之外，整个图元被裁掉
+    if (!applyEntityAttr(aPickId, vColor))
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+}
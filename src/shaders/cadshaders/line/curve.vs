@@ -0,0 +1,50 @@
+#version 330 core
+#include "../common/entityattr.glsl"
+// 圆 / 圆弧实例：每个实例一条 GL_LINE_STRIP，顶点由 gl_VertexID 在此展开
+layout (location = 0) in vec4 aCenterRadius;  // xyz = 圆心, w = 半径
+layout (location = 1) in vec2 aAngles;        // x = 起始角, y = 张角（弧度，(0, 2π]）
+layout (location = 2) in vec4 aColor;         // 0xRRGGBBAA 按字节（小端）读入为 (A, B, G, R)
+layout (location = 3) in uint aPickId;        // 实体键：属性表下标，拾取 pass 输出
+
+layout (std140) uniform Camera {   // 每帧上传一次，见 Renderer::setCamera
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec2 viewport;         // 像素尺寸
+    float worldPerPixel;
+};
+
+uniform int maxSegments;   // 每实例的顶点数 = maxSegments + 1
+
+out vec4 vColor;
+flat out uint vPickId;
+
+void main() {
+    vec3 c = aCenterRadius.xyz;
+    float r = aCenterRadius.w;
+
+    // 投影半径（像素）：取圆所在平面两个轴向投影的较大者
+    vec4 clipC = viewProj * vec4(c, 1.0);
+    vec4 clipX = viewProj * vec4(c + vec3(r, 0.0, 0.0), 1.0);
+    vec4 clipY = viewProj * vec4(c + vec3(0.0, r, 0.0), 1.0);
+    vec2 ndcC = clipC.xy / clipC.w;
+    float rx = length((clipX.xy / clipX.w - ndcC) * 0.5 * viewport);
+    float ry = length((clipY.xy / clipY.w - ndcC) * 0.5 * viewport);
+    float rPix = max(max(rx, ry), 1e-3);
+
+    // 弦高误差 <= 0.5 像素：theta_max = 2 * acos(1 - e / r)
+    float thetaMax = 2.0 * acos(max(0.0, 1.0 - 0.5 / rPix));
+    int n = int(ceil(aAngles.y / max(thetaMax, 1e-3)));
+    n = clamp(n, 8, maxSegments);
+
+    // 多余的顶点折叠到终点，形成零长度线段
+    int i = min(gl_VertexID, n);
+    float t = aAngles.x + aAngles.y * (float(i) / float(n));
+    vec3 p = vec3(c.x + r * cos(t), c.y + r * sin(t), c.z);
+
+    vColor = aColor.wzyx;
+    vPickId = aPickId;
+    gl_Position = viewProj * vec4(p, 1.0);
+    if (!applyEntityAttr(aPickId, vColor))
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+}
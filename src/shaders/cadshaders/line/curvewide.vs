@@ -0,0 +1,73 @@
+#version 330 core
+#include "../common/entityattr.glsl"
+// 宽线模式的圆 / 圆弧实例：每个实例一条 GL_TRIANGLE_STRIP，每个弧上采样点展开为线两侧的一对顶点，
+// 片元着色器与 wideline.fs 相同（弧两端为平头）
+layout (location = 0) in vec4 aCenterRadius;  // xyz = 圆心, w = 半径
+layout (location = 1) in vec2 aAngles;        // x = 起始角, y = 张角（弧度，(0, 2π]）
+layout (location = 2) in vec4 aColor;         // 0xRRGGBBAA 按字节（小端）读入为 (A, B, G, R)
+layout (location = 3) in uint aPickId;        // 实体键：属性表下标，拾取 pass 输出
+
+layout (std140) uniform Camera {   // 每帧上传一次，见 Renderer::setCamera
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec2 viewport;         // 像素尺寸
+    float worldPerPixel;
+};
+
+uniform int maxSegments;   // 每实例的顶点数 = 2 * (maxSegments + 1)
+
+out vec4 vColor;
+noperspective out vec2 vLocal;   // x 恒为 0，y 为到弧线中心的有符号像素距离
+flat out float vLength;
+flat out float vHalfWidth;
+flat out uint vPickId;
+
+void main() {
+    vec3 c = aCenterRadius.xyz;
+    float r = aCenterRadius.w;
+
+    // 投影半径（像素）：取圆所在平面两个轴向投影的较大者
+    vec4 clipC = viewProj * vec4(c, 1.0);
+    vec4 clipX = viewProj * vec4(c + vec3(r, 0.0, 0.0), 1.0);
+    vec4 clipY = viewProj * vec4(c + vec3(0.0, r, 0.0), 1.0);
+    vec2 ndcC = clipC.xy / clipC.w;
+    float rx = length((clipX.xy / clipX.w - ndcC) * 0.5 * viewport);
+    float ry = length((clipY.xy / clipY.w - ndcC) * 0.5 * viewport);
+    float rPix = max(max(rx, ry), 1e-3);
+
+    // 弦高误差 <= 0.5 像素：theta_max = 2 * acos(1 - e / r)
+    float thetaMax = 2.0 * acos(max(0.0, 1.0 - 0.5 / rPix));
+    int n = int(ceil(aAngles.y / max(thetaMax, 1e-3)));
+    n = clamp(n, 8, maxSegments);
+
+    // 每个采样点两个顶点；多余的顶点折叠到终点，形成退化三角形
+    int i = min(gl_VertexID >> 1, n);
+    float side = (gl_VertexID & 1) == 0 ? 1.0 : -1.0;
+    float t = aAngles.x + aAngles.y * (float(i) / float(n));
+    vec3 p = vec3(c.x + r * cos(t), c.y + r * sin(t), c.z);
+    vec3 tangent = vec3(-sin(t), cos(t), 0.0);
+
+    vColor = aColor.wzyx;
+    vPickId = aPickId;
+    vec4 clip = viewProj * vec4(p, 1.0);
+    if (!applyEntityAttr(aPickId, vColor) || clip.w < 1e-5) {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+
+    // 切线的屏幕方向：对透视除法求导，d(xy/w) = (dxy * w - xy * dw) / w²
+    vec4 dClip = viewProj * vec4(tangent, 0.0);
+    vec2 dScreen = (dClip.xy * clip.w - clip.xy * dClip.w) * viewport;
+    vec2 dir = length(dScreen) > 1e-6 ? normalize(dScreen) : vec2(1.0, 0.0);
+    vec2 nrm = vec2(-dir.y, dir.x);
+
+    float halfW = 0.5 * entityWidth(aPickId);
+    float ly = side * (halfW + 1.0);  // 1 像素的抗锯齿过渡带
+    vec2 offset = nrm * ly / viewport * 2.0;
+
+    gl_Position = vec4(clip.xy + offset * clip.w, clip.zw);
+    vLocal = vec2(0.0, ly);
+    vLength = 0.0;
+    vHalfWidth = halfW;
+}
@@ -1,6 +1,12 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-uniform mat4 mvp;
+layout (std140) uniform Camera {   // 每帧上传一次，见 Renderer::setCamera
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec2 viewport;         // 像素尺寸
+    float worldPerPixel;
+};
 void main() {
-    gl_Position = mvp * vec4(aPos, 1.0);
+    gl_Position = viewProj * vec4(aPos, 1.0);
 }
\ No newline at end of file
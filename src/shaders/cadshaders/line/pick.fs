@@ -0,0 +1,7 @@
+#version 330 core
+// 拾取 pass：把实体的拾取键写入 R32UI 颜色附件
+flat in uint vPickId;
+out uint FragId;
+void main() {
+    FragId = vPickId;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+// 宽线片元：到线段的像素距离（胶囊体）决定覆盖率，圆头、圆角连接与 1 像素抗锯齿边缘都由此得到；
+// 覆盖率写进 alpha，需要开启混合
+in vec4 vColor;
+noperspective in vec2 vLocal;
+flat in float vLength;
+flat in float vHalfWidth;
+out vec4 FragColor;
+void main() {
+    float dx = max(max(-vLocal.x, vLocal.x - vLength), 0.0);
+    float dist = length(vec2(dx, vLocal.y));
+    float coverage = clamp(vHalfWidth + 0.5 - dist, 0.0, 1.0);
+    if (coverage <= 0.0)
+        discard;
+    FragColor = vec4(vColor.rgb, vColor.a * coverage);
+}
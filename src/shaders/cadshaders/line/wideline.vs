@@ -0,0 +1,71 @@
+#version 330 core
+#include "../common/entityattr.glsl"
+// 宽线：每个实例一条线段，4 个顶点（三角带）在屏幕空间展开为沿线段方向的矩形，
+// 两端与两侧各外扩半线宽 + 1 像素；片元着色器按到线段的距离得到圆头、圆角连接与抗锯齿边缘
+layout (location = 0) in vec3 aPos0;     // 起点
+layout (location = 1) in vec4 aColor;    // 起点颜色：0xRRGGBBAA 按字节（小端）读入为 (A, B, G, R)
+layout (location = 2) in uint aKey0;     // 起点实体键（实体下标 + 1）
+layout (location = 3) in vec3 aPos1;     // 终点
+layout (location = 4) in uint aKey1;     // 终点实体键：与起点不同说明是折线堆里跨实体的伪线段
+
+layout (std140) uniform Camera {   // 每帧上传一次，见 Renderer::setCamera
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec2 viewport;         // 像素尺寸
+    float worldPerPixel;
+};
+
+uniform float lineWidth;            // 非实体几何（键 0：预览层、即时画线）的线宽（像素）
+
+out vec4 vColor;
+noperspective out vec2 vLocal;   // 相对起点的屏幕坐标（像素）：x 沿线段，y 垂直于线段
+flat out float vLength;          // 线段屏幕长度（像素）
+flat out float vHalfWidth;
+flat out uint vPickId;
+
+void main() {
+    vColor = aColor.wzyx;
+    vPickId = aKey0;
+
+    // 跨实体的伪线段与空闲区（键 0 且全透明）不产生像素
+    bool valid = aKey0 == aKey1 && (aKey0 != 0u || vColor.a > 0.0);
+    vec4 c0 = viewProj * vec4(aPos0, 1.0);
+    vec4 c1 = viewProj * vec4(aPos1, 1.0);
+    const float kNear = 1e-5;
+    if (!valid || !applyEntityAttr(aKey0, vColor) || (c0.w < kNear && c1.w < kNear)) {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+
+    // 透视下跨过相机平面的线段先裁到 w > 0 一侧，避免除法后翻转
+    if (c0.w < kNear)
+        c0 = mix(c0, c1, (kNear - c0.w) / (c1.w - c0.w));
+    else if (c1.w < kNear)
+        c1 = mix(c1, c0, (kNear - c1.w) / (c0.w - c1.w));
+
+    vec2 s0 = (c0.xy / c0.w * 0.5 + 0.5) * viewport;
+    vec2 s1 = (c1.xy / c1.w * 0.5 + 0.5) * viewport;
+    vec2 d = s1 - s0;
+    float len = length(d);
+    vec2 dir = len > 1e-4 ? d / len : vec2(1.0, 0.0);
+    vec2 nrm = vec2(-dir.y, dir.x);
+
+    float halfW = 0.5 * (aKey0 == 0u ? lineWidth : entityWidth(aKey0));
+    float ext = halfW + 1.0;  // 1 像素的抗锯齿过渡带
+
+    // 顶点 0/1 在起点端，2/3 在终点端；偶数在左侧
+    float t = float(gl_VertexID >> 1);
+    float side = (gl_VertexID & 1) == 0 ? 1.0 : -1.0;
+    float lx = mix(-ext, len + ext, t);
+    float ly = side * ext;
+    vec2 s = s0 + dir * lx + nrm * ly;
+
+    // 深度与 w 取所在端点的值，屏幕位置反算回裁剪空间
+    vec4 c = t < 0.5 ? c0 : c1;
+    gl_Position = vec4((s / viewport * 2.0 - 1.0) * c.w, c.z, c.w);
+
+    vLocal = vec2(lx, ly);
+    vLength = len;
+    vHalfWidth = halfW;
+}
@@ -7,10 +7,17 @@ uniform float gridMinor;     // 次要网格间距
 uniform float gridMajor;     // 主要网格间距
 uniform vec4 minorColor;     // 次要网格颜色
 uniform vec4 majorColor;     // 主要网格颜色
-uniform float worldPerPixel; // 缩放级别
 uniform float fadeNear;      // 开始淡出的距离（像素）
 uniform float fadeFar;       // 完全消失的距离（像素）
 
+layout (std140) uniform Camera {   // worldPerPixel 用于按缩放级别淡出，见 Renderer::setCamera
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec2 viewport;         // 像素尺寸
+    float worldPerPixel;
+};
+
 void main()
 {
     vec2 coord = worldPos.xy;
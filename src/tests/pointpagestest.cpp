@@ -0,0 +1,263 @@
+// ============================================
+// PointPagesTest - 分页点序列、顶点池与文档拷贝的回归测试
+// 覆盖：页在 kMaxPagePoints / kMinPagePoints 处的拆分与合并、拷贝保留戳记、
+// moveToPool / releasePooled / VertexPool::compact 的偏移改写、池中折线随 Document 拷贝
+// 失败时打印位置并以非零值退出（ctest 判定）
+// ============================================
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "../cad/data/document.h"
+#include "../cad/data/pointpages.h"
+#include "../cad/data/vertexpool.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                    \
+    do                                                                 \
+    {                                                                  \
+        if (!(cond))                                                   \
+        {                                                              \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                                \
+        }                                                              \
+    } while (0)
+
+static std::vector<glm::vec3> ramp(std::size_t n, float base = 0.0f)
+{
+    std::vector<glm::vec3> v(n);
+    for (std::size_t i = 0; i < n; ++i)
+        v[i] = glm::vec3(base + float(i), float(i % 7), 0.0f);
+    return v;
+}
+
+static std::vector<std::uint64_t> stamps(const PointPages &p)
+{
+    std::vector<std::uint64_t> s;
+    for (std::size_t k = 0; k < p.pageCount(); ++k)
+        s.push_back(p.page(k).stamp);
+    return s;
+}
+
+// ============================================
+// 拆分与合并
+// ============================================
+
+static void testSplit()
+{
+    std::vector<glm::vec3> ref = ramp(2 * PointPages::kPagePoints);
+    PointPages p(ref);
+    CHECK(p.pageCount() == 2);
+    const std::uint64_t tail = p.page(1).stamp;
+
+    // 第一页补到正好 kMaxPagePoints：不拆
+    std::vector<glm::vec3> more = ramp(PointPages::kMaxPagePoints - PointPages::kPagePoints, 10000.0f);
+    p.insert(10, more.data(), more.size());
+    ref.insert(ref.begin() + 10, more.begin(), more.end());
+    CHECK(p.pageCount() == 2);
+    CHECK(p.page(0).count == PointPages::kMaxPagePoints);
+
+    // 再多一个点：拆成若干接近 kPagePoints 的页，未改动的页戳记不变
+    glm::vec3 one(-1.0f);
+    p.insert(0, &one, 1);
+    ref.insert(ref.begin(), one);
+    CHECK(p.pageCount() == 4);
+    for (std::size_t k = 0; k < p.pageCount(); ++k)
+        CHECK(p.page(k).count <= PointPages::kMaxPagePoints && p.page(k).count >= PointPages::kMinPagePoints);
+    CHECK(p.page(p.pageCount() - 1).stamp == tail);
+    CHECK(p.toVector() == ref);
+}
+
+static void testMerge()
+{
+    std::vector<glm::vec3> ref = ramp(3 * PointPages::kPagePoints);
+    PointPages p(ref);
+    CHECK(p.pageCount() == 3);
+    const std::uint64_t head = p.page(0).stamp;
+
+    // 中间页删到正好 kMinPagePoints：不合并
+    std::size_t cut = PointPages::kPagePoints - PointPages::kMinPagePoints;
+    p.erase(PointPages::kPagePoints, cut);
+    ref.erase(ref.begin() + PointPages::kPagePoints, ref.begin() + (PointPages::kPagePoints + cut));
+    CHECK(p.pageCount() == 3);
+    CHECK(p.page(1).count == PointPages::kMinPagePoints);
+
+    // 再删一个：与后一页合并，前一页不动
+    p.erase(PointPages::kPagePoints, 1);
+    ref.erase(ref.begin() + PointPages::kPagePoints);
+    CHECK(p.pageCount() == 2);
+    CHECK(p.page(1).count == PointPages::kMinPagePoints - 1 + PointPages::kPagePoints);
+    CHECK(p.page(0).stamp == head);
+    CHECK(p.toVector() == ref);
+
+    // 末页过小时与前一页合并
+    p.erase(p.size() - (p.page(1).count - 1), p.page(1).count - 1);
+    ref.resize(p.size());
+    CHECK(p.pageCount() == 1);
+    CHECK(p.toVector() == ref);
+}
+
+// ============================================
+// 拷贝保留戳记
+// ============================================
+
+static void testCopyStamps()
+{
+    PointPages a(ramp(3 * PointPages::kPagePoints));
+    PointPages b(a);
+    CHECK(stamps(b) == stamps(a));
+
+    // 改动拷贝只换新它自己那一页的戳记
+    glm::vec3 p(5.0f);
+    b.write(PointPages::kPagePoints + 3, &p, 1);
+    CHECK(b.page(0).stamp == a.page(0).stamp);
+    CHECK(b.page(1).stamp != a.page(1).stamp);
+    CHECK(b.page(2).stamp == a.page(2).stamp);
+
+    // 池中序列的拷贝是自持的一页，戳记与内容相同
+    VertexPool pool;
+    PointPages c(ramp(100));
+    c.moveToPool(pool);
+    PointPages d(c);
+    CHECK(c.pooled() && !d.pooled());
+    CHECK(d.pageCount() == 1 && d.page(0).stamp == c.page(0).stamp);
+    CHECK(d.toVector() == c.toVector());
+    c.releasePooled();
+}
+
+// ============================================
+// 顶点池：moveToPool / releasePooled / compact
+// ============================================
+
+static void testPool()
+{
+    VertexPool pool;
+    std::vector<std::vector<glm::vec3>> refs = {ramp(10, 0.0f), ramp(20, 100.0f), ramp(30, 200.0f)};
+    std::vector<PointPages> seqs;
+    for (const auto &r : refs)
+    {
+        seqs.emplace_back(r);
+        seqs.back().moveToPool(pool);
+    }
+    CHECK(pool.usedVertices() == 60);
+    CHECK(seqs[1].poolSpan()->offset == 10 && seqs[2].poolSpan()->offset == 30);
+
+    // 超过 kMaxPagePoints 的序列不进池
+    PointPages big(ramp(PointPages::kMaxPagePoints + 1));
+    big.moveToPool(pool);
+    CHECK(!big.pooled() && pool.usedVertices() == 60);
+
+    // 中间的区间归还后进空闲表；同长度的分配直接复用
+    seqs[0].releasePooled();
+    CHECK(seqs[0].empty() && !seqs[0].pooled());
+    CHECK(pool.freeVertices() == 10);
+    PointPages reuse(ramp(10, 300.0f));
+    reuse.moveToPool(pool);
+    CHECK(reuse.poolSpan()->offset == 0 && pool.freeVertices() == 0);
+    reuse.releasePooled();
+
+    // 整理：存活区间按偏移前移，offset 被改写，内容不变
+    std::vector<VertexPool::Span *> live = {seqs[2].poolSpan(), seqs[1].poolSpan()};
+    pool.compact(live);
+    CHECK(seqs[1].poolSpan()->offset == 0 && seqs[2].poolSpan()->offset == 20);
+    CHECK(pool.usedVertices() == 50 && pool.freeVertices() == 0);
+    CHECK(seqs[1].toVector() == refs[1] && seqs[2].toVector() == refs[2]);
+
+    // 末尾的区间归还时直接截短
+    seqs[2].releasePooled();
+    CHECK(pool.usedVertices() == 20 && pool.freeVertices() == 0);
+    seqs[1].releasePooled();
+}
+
+// ============================================
+// Document 拷贝：池中折线指向新文档的池
+// ============================================
+
+static std::vector<glm::vec3> pointsOf(const Document &doc, EntityId id)
+{
+    std::optional<Entity> e = doc.get(id);
+    return e ? std::get<Polyline>(e->geom).pts.toVector() : std::vector<glm::vec3>{};
+}
+
+static void testDocumentCopy()
+{
+    Document doc;
+    std::vector<EntityId> ids;
+    std::vector<std::vector<glm::vec3>> refs;
+    for (int i = 0; i < 50; ++i)
+    {
+        refs.push_back(ramp(2 + std::size_t(i), float(i) * 1000.0f));
+        ids.push_back(doc.addPolyline(refs.back(), i % 2 == 0));
+    }
+    // 长折线走分页，与池中折线混在同一列里
+    refs.push_back(ramp(3 * PointPages::kPagePoints));
+    ids.push_back(doc.addPolyline(refs.back(), false));
+    doc.remove(ids[7]);
+
+    Document copy(doc);
+    CHECK(copy.vertexPool().usedVertices() == doc.vertexPool().usedVertices());
+
+    // 改动与清空原文档不影响拷贝（各自的池）
+    glm::vec3 p(-7.0f);
+    doc.insertPoints(ids[3], 1, &p, 1);
+    doc.clear();
+    for (std::size_t i = 0; i < ids.size(); ++i)
+    {
+        if (i == 7)
+            CHECK(!copy.contains(ids[i]));
+        else
+            CHECK(pointsOf(copy, ids[i]) == refs[i]);
+    }
+
+    // 拷贝上的编辑与整理
+    copy.insertPoints(ids[4], 0, &p, 1);
+    refs[4].insert(refs[4].begin(), p);
+    copy.remove(ids[5]);
+    copy.compactVertices();
+    CHECK(copy.vertexPool().freeVertices() == 0);
+    CHECK(pointsOf(copy, ids[4]) == refs[4]);
+    CHECK(pointsOf(copy, ids[6]) == refs[6]);
+
+    // 移动：池随文档整体转移
+    Document moved(std::move(copy));
+    CHECK(pointsOf(moved, ids[4]) == refs[4]);
+    Document assigned;
+    assigned = moved;
+    CHECK(pointsOf(assigned, ids.back()) == refs.back());
+
+    // 移动后的源文档是空的，可以清空、重新填充与整理
+    CHECK(copy.size() == 0 && !copy.contains(ids[4]));
+    copy.clear();
+    copy.reserveVertices(64);
+    EntityId refill = copy.addPolyline(refs[4], false);
+    CHECK(pointsOf(copy, refill) == refs[4]);
+    copy.compactVertices();
+    CHECK(copy.vertexPool().usedVertices() == refs[4].size());
+
+    // 移动赋值：目标原有的内容被替换，源文档同样留空可用
+    Document target;
+    target.addPolyline(refs[0], false);
+    target = std::move(copy);
+    CHECK(pointsOf(target, refill) == refs[4]);
+    CHECK(copy.size() == 0 && copy.vertexPool().usedVertices() == 0);
+    copy = assigned;
+    CHECK(pointsOf(copy, ids[6]) == refs[6]);
+}
+
+int main()
+{
+    testSplit();
+    testMerge();
+    testCopyStamps();
+    testPool();
+    testDocumentCopy();
+
+    if (failures > 0)
+    {
+        std::printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}